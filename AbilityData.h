@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "AbilityData.generated.h"
+
+// Tuning of one ability, shared by every character that has it. The defaults are the shift.
+UCLASS(BlueprintType)
+class FPS_CONTROLLER_API UAbilityData : public UPrimaryDataAsset {
+  GENERATED_BODY()
+
+public:
+  UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Ability")
+  float m_manaCost = 25.f;
+
+  // how long the ability runs, the cooldown only starts counting once it is over
+  UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Ability")
+  float m_activeTime = .25f;
+
+  // seconds after m_activeTime before the ability can be used again
+  UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Ability")
+  float m_coolDown = .75f;
+
+  // seconds after m_activeTime before mana starts coming back
+  UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category="Ability")
+  float m_rechargeDelay = 4.f;
+};
@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ActorPoolSubsystem.h"
+
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogActorPool, Log, All);
+
+namespace {
+  FAutoConsoleCommandWithWorld CmdActorPoolStats(
+    TEXT("fps.Pool.Stats"),
+    TEXT("Prints spawns, spawns avoided and the high water mark of every actor pool."),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* world) {
+      if (const UActorPoolSubsystem* pools = world ? world->GetSubsystem<UActorPoolSubsystem>() : nullptr) {
+        pools->LogStats();
+      }
+    }));
+}
+
+AActor* UActorPoolSubsystem::SpawnPooled(UClass* actorClass) {
+  FActorSpawnParameters params;
+  params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+  AActor* actor = GetWorld()->SpawnActor<AActor>(actorClass, FTransform::Identity, params);
+  if (actor != nullptr) {
+    m_pools.FindOrAdd(actorClass).spawned++;
+  }
+  return actor;
+}
+
+void UActorPoolSubsystem::Park(AActor* actor) {
+  actor->SetActorHiddenInGame(true);
+  actor->SetActorEnableCollision(false);
+  actor->SetActorTickEnabled(false);
+  for (UActorComponent* component : actor->GetComponents()) {
+    component->Deactivate();
+  }
+}
+
+void UActorPoolSubsystem::Prewarm(UClass* actorClass, int32 count) {
+  if (actorClass == nullptr) return;
+  FActorPool& pool = m_pools.FindOrAdd(actorClass);
+  while (pool.free.Num() + pool.inUse < count) {
+    AActor* actor = SpawnPooled(actorClass);
+    if (actor == nullptr) return;
+    Park(actor);
+    pool.free.Add(actor);
+  }
+}
+
+AActor* UActorPoolSubsystem::Acquire(UClass* actorClass, const FTransform& transform) {
+  if (actorClass == nullptr) return nullptr;
+  FActorPool& pool = m_pools.FindOrAdd(actorClass);
+
+  AActor* actor = nullptr;
+  while (actor == nullptr && pool.free.Num() > 0) {
+    // something outside the pool may have destroyed it
+    actor = pool.free.Pop(false);
+    if (!IsValid(actor)) actor = nullptr;
+  }
+
+  if (actor != nullptr) {
+    pool.reused++;
+    actor->SetActorTransform(transform, false, nullptr, ETeleportType::ResetPhysics);
+    actor->SetActorHiddenInGame(false);
+    actor->SetActorEnableCollision(true);
+    actor->SetActorTickEnabled(true);
+    for (UActorComponent* component : actor->GetComponents()) {
+      component->Activate(true);
+    }
+  }
+  else {
+    actor = SpawnPooled(actorClass);
+    if (actor == nullptr) return nullptr;
+    actor->SetActorTransform(transform, false, nullptr, ETeleportType::ResetPhysics);
+  }
+
+  // FindOrAdd in SpawnPooled can move the map storage, look it up again
+  FActorPool& owner = m_pools.FindChecked(actorClass);
+  owner.inUse++;
+  owner.highWaterMark = FMath::Max(owner.highWaterMark, owner.inUse);
+  return actor;
+}
+
+void UActorPoolSubsystem::Release(AActor* actor) {
+  if (!IsValid(actor)) return;
+  FActorPool* pool = m_pools.Find(actor->GetClass());
+  if (pool == nullptr) {
+    // never came from here
+    actor->Destroy();
+    return;
+  }
+  Park(actor);
+  pool->free.Add(actor);
+  pool->inUse = FMath::Max(pool->inUse - 1, 0);
+}
+
+void UActorPoolSubsystem::LogStats() const {
+  for (const TPair<TObjectPtr<UClass>, FActorPool>& pair : m_pools) {
+    const FActorPool& pool = pair.Value;
+    UE_LOG(LogActorPool, Display, TEXT("%s: %d spawned, %d spawns avoided, %d in use, %d free, high water mark %d"),
+           *GetNameSafe(pair.Key), pool.spawned, pool.reused, pool.inUse, pool.free.Num(), pool.highWaterMark);
+  }
+}
+
+void UActorPoolSubsystem::Deinitialize() {
+  m_pools.Empty();
+  Super::Deinitialize();
+}
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ActorPoolSubsystem.generated.h"
+
+USTRUCT()
+struct FActorPool {
+  GENERATED_BODY()
+
+  UPROPERTY()
+  TArray<TObjectPtr<AActor>> free;
+
+  int32 inUse = 0;
+  int32 spawned = 0;     // actual SpawnActor calls
+  int32 reused = 0;      // acquires served from the pool, i.e. spawns avoided
+  int32 highWaterMark = 0;
+};
+
+// Keeps spawned actors around instead of destroying them. Released actors are hidden, lose
+// collision and tick and have their components deactivated, Acquire turns all of it back on.
+UCLASS()
+class FPS_CONTROLLER_API UActorPoolSubsystem : public UWorldSubsystem {
+  GENERATED_BODY()
+
+public:
+  // spawns hidden instances up front so the first Acquire calls don't hitch
+  void Prewarm(UClass* actorClass, int32 count);
+  AActor* Acquire(UClass* actorClass, const FTransform& transform);
+  void Release(AActor* actor);
+
+  const FActorPool* GetPool(UClass* actorClass) const { return m_pools.Find(actorClass); }
+  void LogStats() const;
+
+  virtual void Deinitialize() override;
+
+private:
+  AActor* SpawnPooled(UClass* actorClass);
+  static void Park(AActor* actor);
+
+  UPROPERTY()
+  TMap<TObjectPtr<UClass>, FActorPool> m_pools;
+};
@@ -0,0 +1,191 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+// Times FShiftLandingSolver on a synthetic world, per EShiftBranch, outside of the engine. Built by the
+// CMakeLists.txt at the root, which defines SHIFT_LANDING_BENCH: the module build picks up every source
+// under the module and must not get a second main.
+//   ShiftLandingBench [--iterations=<n>] [--max-ns=<ns>] [--max-candidates-ns=<ns>]
+// Every scene is checked to still take the branch it was built for, then solved n times (default 2000).
+// Exits 1 when a branch's mean is over its limit (--max-ns for Solve, --max-candidates-ns for
+// SolveCandidates, which always makes 49 queries), 2 when a scene took another branch, 3 on bad arguments.
+
+#if defined(SHIFT_LANDING_BENCH)
+
+#include "ShiftSyntheticWorld.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+  // the player's capsule, eye height and shift distance as the character has them
+  constexpr float kCapsuleRadius = 34.f;
+  constexpr float kCapsuleHalfHeight = 88.f;
+  constexpr float kEyeHeight = 152.f;
+  constexpr float kShiftDistance = 800.f;
+
+  struct FScene {
+    const char* name;
+    FShiftQueryParams params;
+    EShiftBranch expected;
+  };
+
+  struct FBranchSamples {
+    std::vector<double> nanoseconds;
+    long long queries = 0;
+  };
+
+  float Length(const FShiftVec& v) {
+    return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+  }
+
+  // standing at feet, looking at target, the ray is the shift distance long whatever the target's distance
+  FShiftQueryParams MakeParams(const FShiftVec& feet, const FShiftVec& target) {
+    FShiftQueryParams params;
+    params.start = feet + FShiftVec{0.f, 0.f, kEyeHeight};
+    const FShiftVec aim = target - params.start;
+    params.end = params.start + aim * (kShiftDistance / Length(aim));
+    const FShiftVec flat{aim.x, aim.y, 0.f};
+    params.forward = flat / Length(flat);
+    params.capsuleRadius = kCapsuleRadius;
+    params.capsuleHalfHeight = kCapsuleHalfHeight;
+    return params;
+  }
+
+  // one row along x per scene, far enough apart on y that they don't see each other
+  void BuildWorld(FShiftSyntheticWorld& world, std::vector<FScene>& scenes) {
+    world.AddBox({-5000.f, -5000.f, -100.f}, {5000.f, 5000.f, 0.f});
+    // the aim ray is this long when it ends over flat floor 40 cm up
+    const float flatReach = std::sqrt(kShiftDistance * kShiftDistance - (kEyeHeight - 40.f) * (kEyeHeight - 40.f));
+
+    // a wall lower than the capsule, its top is free
+    world.AddBox({600.f, -200.f, 0.f}, {700.f, 200.f, 120.f});
+    scenes.push_back({"low wall", MakeParams({0.f, 0.f, 0.f}, {600.f, 0.f, 100.f}), EShiftBranch::kLedge});
+
+    // the same wall with a ceiling above, neither its top nor the foot of it fit the capsule
+    world.AddBox({600.f, 1000.f, 0.f}, {700.f, 1400.f, 120.f});
+    world.AddBox({500.f, 1000.f, 200.f}, {800.f, 1400.f, 260.f});
+    scenes.push_back({"low wall under a ceiling", MakeParams({0.f, 1200.f, 0.f}, {600.f, 1200.f, 60.f}),
+                      EShiftBranch::kSurfaceSweep});
+
+    // high up a tall wall, nothing to climb
+    world.AddBox({500.f, -1400.f, 0.f}, {600.f, -1000.f, 600.f});
+    scenes.push_back({"tall wall", MakeParams({0.f, -1200.f, 0.f}, {500.f, -1200.f, 350.f}),
+                      EShiftBranch::kSurface});
+
+    // straight down onto the floor
+    scenes.push_back({"floor", MakeParams({0.f, -2400.f, 0.f}, {400.f, -2400.f, 0.f}), EShiftBranch::kSurface});
+
+    // up a ramp, its top is walked up to like a ledge
+    world.AddRamp({1500.f, -800.f, 0.f}, {2500.f, -400.f, 300.f}, 0.f);
+    scenes.push_back({"ramp", MakeParams({1000.f, -600.f, 0.f}, {1700.f, -600.f, 30.f}), EShiftBranch::kLedge});
+
+    // into the sky
+    scenes.push_back({"sky", MakeParams({0.f, 2400.f, 0.f}, {400.f, 2400.f, 600.f}), EShiftBranch::kOpenAir});
+
+    // the ray ends just over the floor, room above
+    scenes.push_back({"over the floor", MakeParams({0.f, 3600.f, 0.f}, {flatReach, 3600.f, 40.f}),
+                      EShiftBranch::kOpenAirOverlap});
+
+    // the ray ends just over the floor under a table
+    world.AddBox({700.f, -3800.f, 120.f}, {1200.f, -3400.f, 160.f});
+    scenes.push_back({"under a table", MakeParams({0.f, -3600.f, 0.f}, {flatReach, -3600.f, 40.f}),
+                      EShiftBranch::kOpenAirSweep});
+  }
+
+  template <typename TSolve>
+  void Time(FShiftSyntheticWorld& world, const FScene& scene, int iterations, TSolve&& solve,
+            std::vector<FBranchSamples>& samples, float& checksum) {
+    for (int i = 0; i < iterations; i++) {
+      const auto start = std::chrono::steady_clock::now();
+      const FShiftSolution solution = solve(world, scene.params);
+      const auto end = std::chrono::steady_clock::now();
+      FBranchSamples& branch = samples[static_cast<int>(solution.branch)];
+      branch.nanoseconds.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+      branch.queries += solution.queryCount;
+      checksum += solution.location.x;
+    }
+  }
+
+  // false when a branch's mean is over maxNs, 0 doesn't check
+  bool Report(const char* label, std::vector<FBranchSamples>& samples, double maxNs) {
+    bool passed = true;
+    std::printf("%s\n  %-18s %8s %8s %10s %10s %10s %12s\n", label, "branch", "solves", "queries", "mean ns",
+                "p50 ns", "p99 ns", "solves/s");
+    for (int i = 0; i < static_cast<int>(EShiftBranch::kCount); i++) {
+      std::vector<double>& times = samples[i].nanoseconds;
+      if (times.empty()) continue;
+      std::sort(times.begin(), times.end());
+      double total = 0.0;
+      for (const double time : times) {
+        total += time;
+      }
+      const double count = static_cast<double>(times.size());
+      const double mean = total / count;
+      const bool over = maxNs > 0.0 && mean > maxNs;
+      passed &= !over;
+      std::printf("  %-18s %8zu %8.1f %10.0f %10.0f %10.0f %12.0f%s\n",
+                  GetShiftBranchName(static_cast<EShiftBranch>(i)), times.size(), samples[i].queries / count, mean,
+                  times[times.size() / 2], times[std::min(times.size() - 1, static_cast<size_t>(count * .99))],
+                  1e9 / mean, over ? "  over the limit" : "");
+    }
+    return passed;
+  }
+}
+
+int main(int argc, char** argv) {
+  int iterations = 2000;
+  double maxNs = 0.0;
+  double maxCandidatesNs = 0.0;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--iterations=", 13) == 0) {
+      iterations = std::max(std::atoi(argv[i] + 13), 1);
+    }
+    else if (std::strncmp(argv[i], "--max-ns=", 9) == 0) {
+      maxNs = std::atof(argv[i] + 9);
+    }
+    else if (std::strncmp(argv[i], "--max-candidates-ns=", 20) == 0) {
+      maxCandidatesNs = std::atof(argv[i] + 20);
+    }
+    else {
+      std::fprintf(stderr, "usage: %s [--iterations=<n>] [--max-ns=<ns>] [--max-candidates-ns=<ns>]\n", argv[0]);
+      return 3;
+    }
+  }
+
+  FShiftSyntheticWorld world;
+  std::vector<FScene> scenes;
+  BuildWorld(world, scenes);
+
+  bool branchesMatch = true;
+  for (const FScene& scene : scenes) {
+    const FShiftSolution solution = FShiftLandingSolver::Solve(world, scene.params);
+    if (solution.branch != scene.expected) {
+      std::fprintf(stderr, "%s: took %s, built for %s\n", scene.name, GetShiftBranchName(solution.branch),
+                   GetShiftBranchName(scene.expected));
+      branchesMatch = false;
+    }
+  }
+
+  const int branches = static_cast<int>(EShiftBranch::kCount);
+  std::vector<FBranchSamples> cascade(branches);
+  std::vector<FBranchSamples> candidates(branches);
+  float checksum = 0.f;
+  for (const FScene& scene : scenes) {
+    Time(world, scene, iterations, FShiftLandingSolver::Solve, cascade, checksum);
+    Time(world, scene, iterations, FShiftLandingSolver::SolveCandidates, candidates, checksum);
+  }
+
+  std::printf("%d scenes, %d shapes, %d solves each (checksum %.1f)\n", static_cast<int>(scenes.size()),
+              world.GetNumShapes(), iterations, checksum);
+  bool passed = Report("Solve", cascade, maxNs);
+  passed &= Report("SolveCandidates", candidates, maxCandidatesNs);
+  if (!branchesMatch) return 2;
+  return passed ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShiftSyntheticWorld.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+  float Dot(const FShiftVec& a, const FShiftVec& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+  }
+}
+
+void FShiftSyntheticWorld::AddBox(const FShiftVec& min, const FShiftVec& max) {
+  FShape shape;
+  shape.min = min;
+  shape.max = max;
+  shape.firstPlane = static_cast<int>(m_planes.size());
+  shape.numPlanes = 6;
+  m_planes.push_back({{1.f, 0.f, 0.f}, max.x});
+  m_planes.push_back({{-1.f, 0.f, 0.f}, -min.x});
+  m_planes.push_back({{0.f, 1.f, 0.f}, max.y});
+  m_planes.push_back({{0.f, -1.f, 0.f}, -min.y});
+  m_planes.push_back({{0.f, 0.f, 1.f}, max.z});
+  m_planes.push_back({{0.f, 0.f, -1.f}, -min.z});
+  m_shapes.push_back(shape);
+}
+
+void FShiftSyntheticWorld::AddRamp(const FShiftVec& min, const FShiftVec& max, float lowHeight) {
+  FShape shape;
+  shape.min = min;
+  shape.max = max;
+  shape.firstPlane = static_cast<int>(m_planes.size());
+  shape.numPlanes = 6;
+  m_planes.push_back({{1.f, 0.f, 0.f}, max.x});
+  m_planes.push_back({{-1.f, 0.f, 0.f}, -min.x});
+  m_planes.push_back({{0.f, 1.f, 0.f}, max.y});
+  m_planes.push_back({{0.f, -1.f, 0.f}, -min.y});
+  m_planes.push_back({{0.f, 0.f, -1.f}, -min.z});
+  // the top, z - slope * x <= low end height - slope * min.x
+  const float lowZ = min.z + lowHeight;
+  const float slope = (max.z - lowZ) / (max.x - min.x);
+  const float length = std::sqrt(slope * slope + 1.f);
+  m_planes.push_back({FShiftVec{-slope, 0.f, 1.f} / length, (lowZ - slope * min.x) / length});
+  m_shapes.push_back(shape);
+}
+
+bool FShiftSyntheticWorld::LineTrace(const FShiftVec& start, const FShiftVec& end, FShiftHit& outHit) {
+  return Sweep(start, end, 0.f, 0.f, true, outHit);
+}
+
+bool FShiftSyntheticWorld::SphereSweep(const FShiftVec& start, const FShiftVec& end, float radius,
+                                       FShiftHit& outHit) {
+  return Sweep(start, end, radius, 0.f, false, outHit);
+}
+
+bool FShiftSyntheticWorld::CapsuleSweep(const FShiftVec& start, const FShiftVec& end, float radius,
+                                        float halfHeight, FShiftHit& outHit) {
+  // the cylinder part, the caps are the radius
+  return Sweep(start, end, radius, std::max(halfHeight - radius, 0.f), false, outHit);
+}
+
+bool FShiftSyntheticWorld::Sweep(const FShiftVec& start, const FShiftVec& end, float radius, float halfHeight,
+                                 bool lineTrace, FShiftHit& outHit) const {
+  const FShiftVec dir = end - start;
+  const FShiftVec extent{radius, radius, radius + halfHeight};
+  const FShiftVec sweepMin{std::min(start.x, end.x) - extent.x, std::min(start.y, end.y) - extent.y,
+                           std::min(start.z, end.z) - extent.z};
+  const FShiftVec sweepMax{std::max(start.x, end.x) + extent.x, std::max(start.y, end.y) + extent.y,
+                           std::max(start.z, end.z) + extent.z};
+
+  float bestTime = std::numeric_limits<float>::max();
+  FShiftVec bestNormal;
+  for (const FShape& shape : m_shapes) {
+    if (sweepMax.x < shape.min.x || sweepMin.x > shape.max.x || sweepMax.y < shape.min.y ||
+      sweepMin.y > shape.max.y || sweepMax.z < shape.min.z || sweepMin.z > shape.max.z) {
+      continue;
+    }
+
+    // clip the ray against every plane, it is inside the shape between enter and exit
+    float enter = 0.f;
+    float exit = 1.f;
+    FShiftVec enterNormal;
+    bool startsInside = true;
+    float leastPenetration = std::numeric_limits<float>::max();
+    FShiftVec penetrationNormal;
+    bool separated = false;
+    for (int i = shape.firstPlane; i < shape.firstPlane + shape.numPlanes && !separated; i++) {
+      const FPlane& plane = m_planes[i];
+      const float offset = radius + halfHeight * std::fabs(plane.normal.z);
+      const float distance = plane.d + offset - Dot(plane.normal, start);
+      const float denom = Dot(plane.normal, dir);
+      if (distance < 0.f) {
+        startsInside = false;
+      }
+      else if (distance < leastPenetration) {
+        leastPenetration = distance;
+        penetrationNormal = plane.normal;
+      }
+      if (denom == 0.f) {
+        separated = distance < 0.f;
+        continue;
+      }
+      const float time = distance / denom;
+      if (denom > 0.f) {
+        exit = std::min(exit, time);
+      }
+      else if (time > enter) {
+        enter = time;
+        enterNormal = plane.normal;
+      }
+      separated = enter > exit;
+    }
+    if (separated) continue;
+
+    if (startsInside) {
+      if (lineTrace) continue;
+      enter = 0.f;
+      enterNormal = penetrationNormal;
+    }
+    if (enter < bestTime) {
+      bestTime = enter;
+      bestNormal = enterNormal;
+    }
+  }
+
+  outHit = FShiftHit();
+  if (bestTime == std::numeric_limits<float>::max()) return false;
+  outHit.location = start + dir * bestTime;
+  outHit.normal = bestNormal;
+  outHit.impactPoint = outHit.location - bestNormal * (radius + halfHeight * std::fabs(bestNormal.z));
+  outHit.blocking = true;
+  return true;
+}
@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "ShiftLandingSolver.h"
+
+#include <vector>
+
+// An IShiftCollisionQuery over analytic shapes kept in memory, so the landing cascade can be run and timed
+// without the engine. Every shape is convex, stored as the planes bounding it (inside is dot(n, p) <= d).
+// Sweeps test the ray against the planes pushed out by the swept shape's extent along each normal, which is
+// exact on the faces and a little generous around edges and corners, close enough for profiling.
+// Like the engine, line traces don't hit a shape they start inside while sweeps report the initial overlap.
+class FShiftSyntheticWorld : public IShiftCollisionQuery {
+public:
+  // axis aligned, floors, walls, ledges and ceilings are all boxes
+  void AddBox(const FShiftVec& min, const FShiftVec& max);
+  // a box whose top rises along x from min.z + lowHeight at min.x to max.z at max.x
+  void AddRamp(const FShiftVec& min, const FShiftVec& max, float lowHeight);
+
+  virtual bool LineTrace(const FShiftVec& start, const FShiftVec& end, FShiftHit& outHit) override;
+  virtual bool SphereSweep(const FShiftVec& start, const FShiftVec& end, float radius, FShiftHit& outHit) override;
+  virtual bool CapsuleSweep(const FShiftVec& start, const FShiftVec& end, float radius, float halfHeight,
+                            FShiftHit& outHit) override;
+
+  int GetNumShapes() const { return static_cast<int>(m_shapes.size()); }
+
+private:
+  struct FPlane {
+    FShiftVec normal;
+    float d = 0.f;
+  };
+
+  struct FShape {
+    FShiftVec min; // bounds, checked before the planes
+    FShiftVec max;
+    int firstPlane = 0;
+    int numPlanes = 0;
+  };
+
+  // radius pushes every plane out, halfHeight only the part of it facing up or down
+  bool Sweep(const FShiftVec& start, const FShiftVec& end, float radius, float halfHeight, bool lineTrace,
+             FShiftHit& outHit) const;
+
+  std::vector<FShape> m_shapes;
+  std::vector<FPlane> m_planes;
+};
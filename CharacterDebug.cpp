@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CharacterDebug.h"
+
+#if ENABLE_CHARACTER_DEBUG
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+
+static TAutoConsoleVariable<int32> CVarCharacterDebug(
+  TEXT("fps.Debug.Character"),
+  0,
+  TEXT("Character debug output, bitmask.\n")
+  TEXT(" 1: on screen state values\n")
+  TEXT(" 2: shift traces and landing spots"),
+  ECVF_Cheat);
+
+namespace {
+  constexpr int32 kCircleSegments = 12;
+}
+
+bool FCharacterDebugOverlay::IsEnabled(ECharacterDebug channel) {
+  return (CVarCharacterDebug.GetValueOnGameThread() & static_cast<int32>(channel)) != 0;
+}
+
+FCharacterDebugOverlay::FSlot& FCharacterDebugOverlay::GetSlot(int32 slot) {
+  if (!m_slots.IsValidIndex(slot)) {
+    m_slots.SetNum(slot + 1);
+  }
+  return m_slots[slot];
+}
+
+void FCharacterDebugOverlay::SetValue(int32 slot, const TCHAR* label, bool value) {
+  FSlot& entry = GetSlot(slot);
+  if (entry.valid && entry.value == value) return;
+  entry.text = FString::Printf(TEXT("%s: %s"), label, value ? TEXT("true") : TEXT("false"));
+  entry.value = value;
+  entry.valid = true;
+  entry.dirty = true;
+}
+
+void FCharacterDebugOverlay::SetValue(int32 slot, const TCHAR* label, int32 value) {
+  FSlot& entry = GetSlot(slot);
+  if (entry.valid && entry.value == value) return;
+  entry.text = FString::Printf(TEXT("%s: %d"), label, value);
+  entry.value = value;
+  entry.valid = true;
+  entry.dirty = true;
+}
+
+void FCharacterDebugOverlay::SetValue(int32 slot, const TCHAR* label, float value) {
+  FSlot& entry = GetSlot(slot);
+  if (entry.valid && entry.value == value) return;
+  entry.text = FString::Printf(TEXT("%s: %f"), label, value);
+  entry.value = value;
+  entry.valid = true;
+  entry.dirty = true;
+}
+
+void FCharacterDebugOverlay::Line(const FVector& start, const FVector& end, const FColor& color) {
+  m_lines.Emplace(start, end, color, 0.f, 0.f, SDPG_World);
+}
+
+void FCharacterDebugOverlay::Circle(const FVector& center, const FVector& x, const FVector& y, float radius,
+                                    const FColor& color) {
+  const float step = 2 * PI / kCircleSegments;
+  FVector last = center + x * radius;
+  for (int32 i = 1; i <= kCircleSegments; i++) {
+    float sin, cos;
+    FMath::SinCos(&sin, &cos, step * i);
+    const FVector next = center + (x * cos + y * sin) * radius;
+    Line(last, next, color);
+    last = next;
+  }
+}
+
+void FCharacterDebugOverlay::Sphere(const FVector& center, float radius, const FColor& color) {
+  Circle(center, FVector::ForwardVector, FVector::RightVector, radius, color);
+  Circle(center, FVector::ForwardVector, FVector::UpVector, radius, color);
+  Circle(center, FVector::RightVector, FVector::UpVector, radius, color);
+}
+
+void FCharacterDebugOverlay::Capsule(const FVector& center, float radius, float halfHeight, const FColor& color) {
+  const FVector offset = FVector::UpVector * FMath::Max(halfHeight - radius, 0.f);
+  Sphere(center + offset, radius, color);
+  Sphere(center - offset, radius, color);
+  Line(center + offset + FVector::ForwardVector * radius, center - offset + FVector::ForwardVector * radius, color);
+  Line(center + offset - FVector::ForwardVector * radius, center - offset - FVector::ForwardVector * radius, color);
+  Line(center + offset + FVector::RightVector * radius, center - offset + FVector::RightVector * radius, color);
+  Line(center + offset - FVector::RightVector * radius, center - offset - FVector::RightVector * radius, color);
+}
+
+void FCharacterDebugOverlay::Flush(UWorld* world, uint64 keyBase) {
+  if (m_lines.Num() > 0) {
+    if (world != nullptr && world->LineBatcher != nullptr) {
+      world->LineBatcher->DrawLines(m_lines);
+    }
+    // keeps the allocation for next frame
+    m_lines.Reset();
+  }
+
+  if (GEngine == nullptr) return;
+  if (!IsEnabled(ECharacterDebug::kOverlay)) {
+    if (m_overlayShown) Clear(keyBase);
+    return;
+  }
+
+  // keyed messages stay up until replaced, so only changed values get pushed
+  for (int32 i = 0; i < m_slots.Num(); i++) {
+    FSlot& entry = m_slots[i];
+    if (!entry.dirty) continue;
+    GEngine->AddOnScreenDebugMessage(keyBase + i, TNumericLimits<float>::Max(), FColor::Blue, entry.text);
+    entry.dirty = false;
+  }
+  m_overlayShown = true;
+}
+
+void FCharacterDebugOverlay::Clear(uint64 keyBase) {
+  if (GEngine != nullptr) {
+    for (int32 i = 0; i < m_slots.Num(); i++) {
+      GEngine->RemoveOnScreenDebugMessage(keyBase + i);
+    }
+  }
+  // force everything to be pushed again when turned back on
+  for (FSlot& entry : m_slots) {
+    entry.valid = false;
+  }
+  m_overlayShown = false;
+}
+
+#endif
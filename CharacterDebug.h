@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Debug overlay and debug draw for the character. Everything here, including the calls through the
+// CHARACTER_DEBUG_* macros, compiles out of Test and Shipping builds. At runtime it is gated by
+// fps.Debug.Character (bitmask, see ECharacterDebug).
+#define ENABLE_CHARACTER_DEBUG !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+class UWorld;
+
+#if ENABLE_CHARACTER_DEBUG
+
+#include "Components/LineBatchComponent.h"
+
+enum class ECharacterDebug : int32 {
+  kOverlay = 1 << 0, // on screen state values
+  kShift = 1 << 1,   // shift traces and landing spots
+};
+
+class FPS_CONTROLLER_API FCharacterDebugOverlay {
+public:
+  static bool IsEnabled(ECharacterDebug channel);
+
+  // values only get re-formatted when they change
+  void SetValue(int32 slot, const TCHAR* label, bool value);
+  void SetValue(int32 slot, const TCHAR* label, int32 value);
+  void SetValue(int32 slot, const TCHAR* label, float value);
+
+  // primitives are buffered and handed to the line batcher in one go on Flush
+  void Line(const FVector& start, const FVector& end, const FColor& color);
+  void Sphere(const FVector& center, float radius, const FColor& color);
+  void Capsule(const FVector& center, float radius, float halfHeight, const FColor& color);
+
+  // once per frame, keyBase keeps the on screen messages of different characters apart
+  void Flush(UWorld* world, uint64 keyBase);
+  void Clear(uint64 keyBase);
+
+private:
+  struct FSlot {
+    FString text;
+    double value = 0;
+    bool valid = false;
+    bool dirty = false;
+  };
+
+  FSlot& GetSlot(int32 slot);
+  void Circle(const FVector& center, const FVector& x, const FVector& y, float radius, const FColor& color);
+
+  TArray<FSlot, TInlineAllocator<8>> m_slots;
+  TArray<FBatchedLine> m_lines;
+  bool m_overlayShown = false;
+};
+
+#define CHARACTER_DEBUG_VALUE(overlay, slot, label, value) \
+  do { if (FCharacterDebugOverlay::IsEnabled(ECharacterDebug::kOverlay)) { (overlay).SetValue(slot, TEXT(label), value); } } while (0)
+#define CHARACTER_DEBUG_LINE(overlay, start, end, color) \
+  do { if (FCharacterDebugOverlay::IsEnabled(ECharacterDebug::kShift)) { (overlay).Line(start, end, color); } } while (0)
+#define CHARACTER_DEBUG_SPHERE(overlay, center, radius, color) \
+  do { if (FCharacterDebugOverlay::IsEnabled(ECharacterDebug::kShift)) { (overlay).Sphere(center, radius, color); } } while (0)
+#define CHARACTER_DEBUG_FLUSH(overlay, world, keyBase) (overlay).Flush(world, keyBase)
+
+#else
+
+#define CHARACTER_DEBUG_VALUE(overlay, slot, label, value) do {} while (0)
+#define CHARACTER_DEBUG_LINE(overlay, start, end, color) do {} while (0)
+#define CHARACTER_DEBUG_SPHERE(overlay, center, radius, color) do {} while (0)
+#define CHARACTER_DEBUG_FLUSH(overlay, world, keyBase) do {} while (0)
+
+#endif
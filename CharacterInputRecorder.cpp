@@ -0,0 +1,193 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CharacterInputRecorder.h"
+
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogCharacterInput, Log, All);
+
+namespace {
+  constexpr uint8 kMagic[4] = {'F', 'P', 'S', 'I'};
+  constexpr uint8 kVersion = 1;
+  constexpr int32 kHeaderSize = 5;
+
+  void WriteVarInt(TArray<uint8>& out, uint32 value) {
+    while (value >= 0x80) {
+      out.Add(static_cast<uint8>(value) | 0x80);
+      value >>= 7;
+    }
+    out.Add(static_cast<uint8>(value));
+  }
+
+  bool ReadVarInt(const TArray<uint8>& in, int32& offset, uint32& out) {
+    out = 0;
+    for (int32 shift = 0; shift < 32 && offset < in.Num(); shift += 7) {
+      const uint8 byte = in[offset++];
+      out |= static_cast<uint32>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+  }
+
+  int32 GetNumAxes(EInputActionValueType type) {
+    switch (type) {
+    case EInputActionValueType::Axis1D: return 1;
+    case EInputActionValueType::Axis2D: return 2;
+    case EInputActionValueType::Axis3D: return 3;
+    default: return 0;
+    }
+  }
+
+  float Percentile(TArray<float> samples, float percentile) {
+    if (samples.Num() == 0) return 0.f;
+    samples.Sort();
+    return samples[FMath::Clamp(FMath::FloorToInt(samples.Num() * percentile), 0, samples.Num() - 1)];
+  }
+}
+
+FCharacterInputRecorder::FCharacterInputRecorder() {
+  m_data.Append(kMagic, 4);
+  m_data.Add(kVersion);
+}
+
+void FCharacterInputRecorder::Record(uint32 frame, ECharacterInput channel, const FInputActionValue& value) {
+  const EInputActionValueType type = value.GetValueType();
+  const FVector axes = value.Get<FVector>();
+
+  WriteVarInt(m_data, frame - m_lastFrame);
+  m_data.Add(static_cast<uint8>(channel) | static_cast<uint8>(type) << 4 | (value.Get<bool>() ? 1 << 6 : 0));
+  for (int32 i = 0; i < GetNumAxes(type); i++) {
+    const float axis = axes[i];
+    m_data.Append(reinterpret_cast<const uint8*>(&axis), sizeof(float));
+  }
+  m_lastFrame = frame;
+  m_numRecords++;
+}
+
+bool FCharacterInputRecorder::Save(const FString& path) const {
+  UE_LOG(LogCharacterInput, Log, TEXT("Saving %d inputs (%d bytes) to %s"), m_numRecords, m_data.Num(), *path);
+  return FFileHelper::SaveArrayToFile(m_data, *path);
+}
+
+bool FCharacterInputPlayer::Load(const FString& path) {
+  m_data.Reset();
+  if (!FFileHelper::LoadFileToArray(m_data, *path) || m_data.Num() < kHeaderSize ||
+    FMemory::Memcmp(m_data.GetData(), kMagic, 4) != 0 || m_data[4] != kVersion) {
+    UE_LOG(LogCharacterInput, Error, TEXT("%s is not an input recording"), *path);
+    m_data.Reset();
+    m_hasNext = false;
+    return false;
+  }
+  Restart();
+  return true;
+}
+
+void FCharacterInputPlayer::Restart() {
+  m_offset = kHeaderSize;
+  m_nextFrame = 0;
+  ReadNext();
+}
+
+void FCharacterInputPlayer::ReadNext() {
+  uint32 delta;
+  m_hasNext = ReadVarInt(m_data, m_offset, delta) && m_offset < m_data.Num();
+  if (!m_hasNext) return;
+
+  const uint8 header = m_data[m_offset++];
+  const EInputActionValueType type = static_cast<EInputActionValueType>((header >> 4) & 0x3);
+  const int32 numAxes = GetNumAxes(type);
+  if (m_offset + numAxes * static_cast<int32>(sizeof(float)) > m_data.Num()) {
+    m_hasNext = false;
+    return;
+  }
+
+  FVector axes = FVector::ZeroVector;
+  for (int32 i = 0; i < numAxes; i++) {
+    float axis;
+    FMemory::Memcpy(&axis, &m_data[m_offset], sizeof(float));
+    axes[i] = axis;
+    m_offset += sizeof(float);
+  }
+
+  m_nextFrame += delta;
+  m_nextChannel = static_cast<ECharacterInput>(header & 0xF);
+  m_nextValue = (type == EInputActionValueType::Boolean)
+                  ? FInputActionValue((header & (1 << 6)) != 0)
+                  : FInputActionValue(type, axes);
+}
+
+void FReplayFrameStats::Reset() {
+  m_gameThreadMs.Reset();
+  m_frameMs.Reset();
+}
+
+void FReplayFrameStats::Sample() {
+  // GGameThreadTime is the previous frame's, good enough over a whole run
+  m_gameThreadMs.Add(FPlatformTime::ToMilliseconds(GGameThreadTime));
+  m_frameMs.Add(FApp::GetDeltaTime() * 1000.f);
+}
+
+bool FReplayFrameStats::CheckLimit() const {
+  float limitMs = 0.f;
+  if (!FParse::Value(FCommandLine::Get(), TEXT("InputReplayLimitP95Ms="), limitMs)) return true;
+  const float p95 = Percentile(m_gameThreadMs, .95f);
+  if (p95 <= limitMs) return true;
+  UE_LOG(LogCharacterInput, Error, TEXT("Replay game thread p95 %.3f ms is over the %.3f ms limit"), p95, limitMs);
+  return false;
+}
+
+void FReplayFrameStats::Report(const TCHAR* label) const {
+  if (m_gameThreadMs.Num() == 0) return;
+  float total = 0.f;
+  for (const float sample : m_gameThreadMs) {
+    total += sample;
+  }
+  UE_LOG(LogCharacterInput, Display,
+         TEXT("%s: %d frames, game thread avg %.3f ms, p50 %.3f ms, p95 %.3f ms, max %.3f ms, frame p95 %.3f ms"),
+         label, m_gameThreadMs.Num(), total / m_gameThreadMs.Num(), Percentile(m_gameThreadMs, .5f),
+         Percentile(m_gameThreadMs, .95f), Percentile(m_gameThreadMs, 1.f), Percentile(m_frameMs, .95f));
+}
+
+void FReplayStateTrace::Add(uint32 frame, const FReplayState& state) {
+  if (m_hasState && state == m_lastState) return;
+  m_lines.Add(FString::Printf(TEXT("%u state %d sliding %d crouching %d canShift %d ready %d mana %d"), frame,
+                              state.movementState, state.sliding, state.crouching, state.canShift, state.ready,
+                              state.mana));
+  m_lastState = state;
+  m_hasState = true;
+}
+
+void FReplayStateTrace::Reset() {
+  m_lines.Reset();
+  m_hasState = false;
+}
+
+bool FReplayStateTrace::Save(const FString& path) const {
+  if (!FFileHelper::SaveStringArrayToFile(m_lines, *path)) {
+    UE_LOG(LogCharacterInput, Error, TEXT("Could not write replay states to %s"), *path);
+    return false;
+  }
+  return true;
+}
+
+bool FReplayStateTrace::Matches(const FString& path) const {
+  TArray<FString> expected;
+  if (!FFileHelper::LoadFileToStringArray(expected, *path)) {
+    UE_LOG(LogCharacterInput, Error, TEXT("Could not read expected replay states from %s"), *path);
+    return false;
+  }
+  const int32 count = FMath::Max(expected.Num(), m_lines.Num());
+  for (int32 i = 0; i < count; i++) {
+    const FString* want = expected.IsValidIndex(i) ? &expected[i] : nullptr;
+    const FString* got = m_lines.IsValidIndex(i) ? &m_lines[i] : nullptr;
+    if (want == nullptr || got == nullptr || !want->Equals(*got)) {
+      UE_LOG(LogCharacterInput, Error, TEXT("Replay state %d differs: expected \"%s\", got \"%s\""), i,
+             want ? **want : TEXT("<end>"), got ? **got : TEXT("<end>"));
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,110 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "InputActionValue.h"
+
+// Every input handler on the character that can be recorded/replayed
+enum class ECharacterInput : uint8 {
+  kMovement,
+  kLook,
+  kJump,
+  kSprint,
+  kCrouch,
+  kThrust,
+  kStartAbility,
+  kExecuteAbility,
+};
+
+// Stream layout, after a 4 byte magic and a version byte, one record per delivered input:
+//   varint  frames since the previous record
+//   uint8   bits 0-3 channel, 4-5 value type, 6 bool value
+//   float*  0-3 axis values depending on the value type
+class FPS_CONTROLLER_API FCharacterInputRecorder {
+public:
+  FCharacterInputRecorder();
+
+  void Record(uint32 frame, ECharacterInput channel, const FInputActionValue& value);
+  bool Save(const FString& path) const;
+  int32 GetNumRecords() const { return m_numRecords; }
+
+private:
+  TArray<uint8> m_data;
+  uint32 m_lastFrame = 0;
+  int32 m_numRecords = 0;
+};
+
+class FPS_CONTROLLER_API FCharacterInputPlayer {
+public:
+  bool Load(const FString& path);
+  void Restart();
+  bool IsFinished() const { return !m_hasNext; }
+
+  // hands every record stamped with this frame to handler(ECharacterInput, const FInputActionValue&)
+  template <typename THandler>
+  void Dispatch(uint32 frame, THandler&& handler) {
+    while (m_hasNext && m_nextFrame <= frame) {
+      handler(m_nextChannel, m_nextValue);
+      ReadNext();
+    }
+  }
+
+private:
+  void ReadNext();
+
+  TArray<uint8> m_data;
+  int32 m_offset = 0;
+  uint32 m_nextFrame = 0;
+  ECharacterInput m_nextChannel = ECharacterInput::kMovement;
+  FInputActionValue m_nextValue;
+  bool m_hasNext = false;
+};
+
+// Per-frame game thread cost over a replay, logged as a summary when done
+class FPS_CONTROLLER_API FReplayFrameStats {
+public:
+  void Reset();
+  void Sample();
+  void Report(const TCHAR* label) const;
+  // false when the game thread p95 is over -InputReplayLimitP95Ms=<ms>
+  bool CheckLimit() const;
+  bool IsEmpty() const { return m_gameThreadMs.Num() == 0; }
+
+private:
+  TArray<float> m_gameThreadMs;
+  TArray<float> m_frameMs;
+};
+
+// What the state trace follows, mana in whole points so recharge doesn't change it every frame
+struct FReplayState {
+  uint8 movementState = 0;
+  bool sliding = false;
+  bool crouching = false;
+  bool canShift = false;
+  bool ready = false;
+  int32 mana = 0;
+
+  bool operator==(const FReplayState& o) const {
+    return movementState == o.movementState && sliding == o.sliding && crouching == o.crouching &&
+      canShift == o.canShift && ready == o.ready && mana == o.mana;
+  }
+};
+
+// The character's gameplay state over a replay, one line per frame it changed. Saved with
+// -InputReplayStates=<file>, compared against a known good run with -InputReplayExpect=<file>.
+// Only stable between runs with a fixed frame rate (-benchmark -fps=60 or -UseFixedTimeStep).
+class FPS_CONTROLLER_API FReplayStateTrace {
+public:
+  // only formats a line when the state differs from the last one
+  void Add(uint32 frame, const FReplayState& state);
+  void Reset();
+  bool Save(const FString& path) const;
+  // logs the first line that differs
+  bool Matches(const FString& path) const;
+
+private:
+  TArray<FString> m_lines;
+  FReplayState m_lastState;
+  bool m_hasState = false;
+};
@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CharacterSignificance.h"
+
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "PlayerCharacter.h"
+#include "SignificanceManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogCharacterSignificance, Log, All);
+
+namespace {
+  const FName kSignificanceTag(TEXT("PlayerCharacter"));
+
+  TAutoConsoleVariable<bool> CVarSignificanceEnabled(
+    TEXT("fps.Significance.Enabled"), true,
+    TEXT("Scales character tick rate and blend work by distance and visibility to the viewers."));
+
+  TAutoConsoleVariable<float> CVarSignificanceNear(
+    TEXT("fps.Significance.NearDistance"), 2000.f,
+    TEXT("Characters closer than this (cm) to a viewer tick at full rate."));
+
+  TAutoConsoleVariable<float> CVarSignificanceMid(
+    TEXT("fps.Significance.MidDistance"), 6000.f,
+    TEXT("Characters closer than this (cm) to a viewer tick at 30 Hz, the rest at 10 Hz."));
+
+  FAutoConsoleCommandWithWorld CmdSignificanceStats(
+    TEXT("fps.Significance.Stats"),
+    TEXT("Logs how many player characters are in each significance tier."),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* world) {
+      const UCharacterSignificanceSubsystem* significance =
+        world ? world->GetSubsystem<UCharacterSignificanceSubsystem>() : nullptr;
+      if (significance == nullptr) return;
+      significance->LogStats();
+    }));
+
+  // runs for every viewpoint, possibly off the game thread, and only reads
+  float EvaluateCharacter(USignificanceManager::FManagedObjectInfo* info, const FTransform& viewpoint) {
+    const APlayerCharacter* character = static_cast<const APlayerCharacter*>(info->GetObject());
+    if (character->IsLocalViewer()) return static_cast<float>(ECharacterSignificance::kLocal);
+
+    const float distanceSq = FVector::DistSquared(character->GetActorLocation(), viewpoint.GetLocation());
+    int32 tier = distanceSq < FMath::Square(CVarSignificanceNear.GetValueOnAnyThread())
+                   ? static_cast<int32>(ECharacterSignificance::kNear)
+                   : distanceSq < FMath::Square(CVarSignificanceMid.GetValueOnAnyThread())
+                   ? static_cast<int32>(ECharacterSignificance::kMid)
+                   : static_cast<int32>(ECharacterSignificance::kFar);
+    // a client knows what it drew, nobody sees a hidden character blend
+    if (tier > 0 && !IsRunningDedicatedServer() && !character->WasRecentlyRendered(.25f)) {
+      tier--;
+    }
+    return static_cast<float>(tier);
+  }
+
+  void ApplySignificance(USignificanceManager::FManagedObjectInfo* info, float oldSignificance, float significance,
+                         bool final) {
+    if (final) return;
+    static_cast<APlayerCharacter*>(info->GetObject())->SetSignificance(
+      static_cast<ECharacterSignificance>(FMath::RoundToInt(significance)));
+  }
+}
+
+float UCharacterSignificanceSubsystem::GetTickInterval(ECharacterSignificance significance) {
+  switch (significance) {
+  case ECharacterSignificance::kFar: return 1.f / 10;
+  case ECharacterSignificance::kMid: return 1.f / 30;
+  default: return 0.f;
+  }
+}
+
+void UCharacterSignificanceSubsystem::Register(APlayerCharacter* character) {
+  USignificanceManager* manager = USignificanceManager::Get(GetWorld());
+  if (manager == nullptr) return;
+  manager->RegisterObject(character, kSignificanceTag, &EvaluateCharacter,
+                          USignificanceManager::EPostSignificanceType::Sequential, &ApplySignificance);
+  m_registered++;
+}
+
+void UCharacterSignificanceSubsystem::Unregister(APlayerCharacter* character) {
+  USignificanceManager* manager = USignificanceManager::Get(GetWorld());
+  if (manager == nullptr || manager->GetManagedObject(character) == nullptr) return;
+  manager->UnregisterObject(character);
+  m_registered--;
+}
+
+void UCharacterSignificanceSubsystem::Tick(float DeltaTime) {
+  Super::Tick(DeltaTime);
+  USignificanceManager* manager = USignificanceManager::Get(GetWorld());
+  if (manager == nullptr) return;
+
+  const bool enabled = CVarSignificanceEnabled.GetValueOnGameThread();
+  if (!enabled) {
+    if (m_enabled) {
+      for (const USignificanceManager::FManagedObjectInfo* info : manager->GetManagedObjects(kSignificanceTag)) {
+        static_cast<APlayerCharacter*>(info->GetObject())->SetSignificance(ECharacterSignificance::kNear);
+      }
+    }
+    m_enabled = false;
+    return;
+  }
+  m_enabled = true;
+
+  m_viewpoints.Reset();
+  for (FConstPlayerControllerIterator it = GetWorld()->GetPlayerControllerIterator(); it; ++it) {
+    const APlayerController* controller = it->Get();
+    if (controller == nullptr) continue;
+    FVector location;
+    FRotator rotation;
+    controller->GetPlayerViewPoint(location, rotation);
+    m_viewpoints.Emplace(rotation, location);
+  }
+  // nobody watching, everything is as far away as it gets
+  if (m_viewpoints.Num() == 0) {
+    m_viewpoints.Emplace(FVector(HALF_WORLD_MAX));
+  }
+  manager->Update(m_viewpoints);
+}
+
+void UCharacterSignificanceSubsystem::LogStats() const {
+  const USignificanceManager* manager = USignificanceManager::Get(GetWorld());
+  if (manager == nullptr) {
+    UE_LOG(LogCharacterSignificance, Display, TEXT("No significance manager in this world, characters run at kNear"));
+    return;
+  }
+  int32 counts[static_cast<int32>(ECharacterSignificance::kCount)] = {};
+  for (const USignificanceManager::FManagedObjectInfo* info : manager->GetManagedObjects(kSignificanceTag)) {
+    counts[static_cast<int32>(static_cast<const APlayerCharacter*>(info->GetObject())->GetSignificance())]++;
+  }
+  UE_LOG(LogCharacterSignificance, Display, TEXT("Characters by significance%s: local %d, near %d, mid %d, far %d"),
+         m_enabled ? TEXT("") : TEXT(" (disabled)"), counts[3], counts[2], counts[1], counts[0]);
+}
+
+TStatId UCharacterSignificanceSubsystem::GetStatId() const {
+  RETURN_QUICK_DECLARE_CYCLE_STAT(UCharacterSignificanceSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CharacterSignificance.generated.h"
+
+class APlayerCharacter;
+
+// how much of its per-frame work a character gets to do, higher is more
+enum class ECharacterSignificance : uint8 {
+  kFar,   // far from every viewer: 10 Hz tick, blends snap to their target
+  kMid,   // 30 Hz tick, one variable step per tick
+  kNear,  // full rate
+  kLocal, // the viewer's own pawn, full rate and the only one with camera work
+  kCount
+};
+
+// Hands the significance manager one viewpoint per player controller each frame and passes the tier it
+// works out back to the characters (APlayerCharacter::SetSignificance). On a dedicated server the
+// viewers are the connected players, on a client the local one. Visibility only counts on clients, a
+// server goes by distance alone. Without the SignificanceManager plugin characters stay at kNear.
+// fps.Significance.Enabled 0 puts every character back on full rate so frame times can be compared,
+// fps.Significance.Stats logs how many characters sit in each tier.
+UCLASS()
+class FPS_CONTROLLER_API UCharacterSignificanceSubsystem : public UTickableWorldSubsystem {
+  GENERATED_BODY()
+
+public:
+  void Register(APlayerCharacter* character);
+  void Unregister(APlayerCharacter* character);
+  void LogStats() const;
+
+  static float GetTickInterval(ECharacterSignificance significance);
+
+  virtual void Tick(float DeltaTime) override;
+  virtual TStatId GetStatId() const override;
+  virtual bool IsTickable() const override { return m_registered > 0; }
+
+private:
+  TArray<FTransform> m_viewpoints;
+  int32 m_registered = 0;
+  bool m_enabled = true;
+};
@@ -0,0 +1,272 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CharacterStats.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_STAT(STAT_CharacterTick);
+DEFINE_STAT(STAT_CharacterHandleSpeed);
+DEFINE_STAT(STAT_CharacterHandleCrouch);
+DEFINE_STAT(STAT_CharacterStartAbility);
+DEFINE_STAT(STAT_CharacterExecuteAbility);
+DEFINE_STAT(STAT_CharacterMovement);
+DEFINE_STAT(STAT_CharacterSetCapsuleHalfHeight);
+DEFINE_STAT(STAT_CharacterSetActorLocation);
+DEFINE_STAT(STAT_CharacterShiftSolves);
+DEFINE_STAT(STAT_CharacterShiftScratchSpill);
+
+CSV_DEFINE_CATEGORY_MODULE(FPS_CONTROLLER_API, Character, true);
+UE_TRACE_CHANNEL_DEFINE(CharacterChannel);
+
+namespace {
+  // the solver's names, widened once
+  const TArray<FString>& GetBranchNames() {
+    static const TArray<FString> names = [] {
+      TArray<FString> result;
+      for (int32 i = 0; i < static_cast<int32>(EShiftBranch::kCount); i++) {
+        result.Add(ANSI_TO_TCHAR(GetShiftBranchName(static_cast<EShiftBranch>(i))));
+      }
+      return result;
+    }();
+    return names;
+  }
+}
+
+const TCHAR* LexToString(EShiftBranch branch) {
+  const int32 index = static_cast<int32>(branch);
+  return index < GetBranchNames().Num() ? *GetBranchNames()[index] : TEXT("Unknown");
+}
+
+#if ENABLE_CHARACTER_STATS
+
+DEFINE_LOG_CATEGORY_STATIC(LogCharacterStats, Log, All);
+
+static TAutoConsoleVariable<float> CVarCharacterBudget(
+  TEXT("fps.Character.BudgetMs"),
+  .5f,
+  TEXT("Warns when the characters spend more than this (ms) in one frame, 0 turns the check off."));
+
+namespace {
+  const TCHAR* const GScopeNames[] = {
+    TEXT("Tick"), TEXT("HandleSpeed"), TEXT("HandleCrouch"), TEXT("StartAbility"), TEXT("ExecuteAbility"),
+    TEXT("Movement"),
+  };
+  const TCHAR* const GCallNames[] = {TEXT("SetCapsuleHalfHeight"), TEXT("SetActorLocation"), TEXT("ShiftScratchSpill")};
+  static_assert(UE_ARRAY_COUNT(GScopeNames) == static_cast<int32>(ECharacterScope::kCount));
+  static_assert(UE_ARRAY_COUNT(GCallNames) == static_cast<int32>(ECharacterCall::kCount));
+
+#if CSV_PROFILER
+  FName GetBranchCsvName(EShiftBranch branch) {
+    static const TArray<FName> names = [] {
+      TArray<FName> result;
+      for (const FString& name : GetBranchNames()) {
+        result.Add(FName(TEXT("Shift") + name));
+      }
+      return result;
+    }();
+    return names[static_cast<int32>(branch)];
+  }
+  const char* const GCallCsvNames[] = {"SetCapsuleHalfHeight", "SetActorLocation", "ShiftScratchSpill"};
+#endif
+
+  FAutoConsoleCommand CmdCharacterStats(
+    TEXT("fps.Character.Stats"),
+    TEXT("Prints the character hot path totals. reset clears them, csv [path] writes them out."),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args) {
+      FCharacterStats& stats = FCharacterStats::Get();
+      if (args.Num() > 0 && args[0] == TEXT("reset")) {
+        stats.Reset();
+        return;
+      }
+      if (args.Num() > 0 && args[0] == TEXT("csv")) {
+        stats.WriteCsv(args.Num() > 1 ? args[1] : FCharacterStats::GetDefaultCsvPath());
+        return;
+      }
+      stats.Log();
+    }));
+
+  double ToMicroseconds(double seconds) {
+    return seconds * 1e6;
+  }
+
+  FString GetLatencyLabel(int32 bucket) {
+    const int32 last = FCharacterStats::kLatencyBuckets - 1;
+    const double bound = ToMicroseconds(FCharacterStats::kLatencyBucketBase * (1 << FMath::Min(bucket, last - 1)));
+    return FString::Printf(TEXT("%s%.0fus"), bucket == last ? TEXT(">") : TEXT("<="), bound);
+  }
+}
+
+void FCharacterStats::FTiming::Add(double time) {
+  count++;
+  seconds += time;
+  maxSeconds = FMath::Max(maxSeconds, time);
+}
+
+FCharacterStats& FCharacterStats::Get() {
+  static FCharacterStats stats;
+  return stats;
+}
+
+void FCharacterStats::RecordScope(ECharacterScope scope, double seconds) {
+  RollFrame();
+  m_scopes[static_cast<int32>(scope)].Add(seconds);
+  // the handlers run inside Tick, only the outermost scopes add up to the frame cost
+  if (scope == ECharacterScope::kTick || scope == ECharacterScope::kStartAbility ||
+    scope == ECharacterScope::kExecuteAbility) {
+    m_frameSeconds += seconds;
+  }
+  if (scope == ECharacterScope::kStartAbility) {
+    const int32 bucket =
+      seconds <= kLatencyBucketBase ? 0 : FMath::FloorToInt32(FMath::Log2(seconds / kLatencyBucketBase)) + 1;
+    m_latency[FMath::Min(bucket, kLatencyBuckets - 1)]++;
+  }
+}
+
+void FCharacterStats::RecordCall(ECharacterCall call) {
+  RollFrame();
+  FCallCount& calls = m_calls[static_cast<int32>(call)];
+  calls.total++;
+  calls.frame++;
+#if CSV_PROFILER
+  FCsvProfiler::RecordCustomStat(GCallCsvNames[static_cast<int32>(call)], CSV_CATEGORY_INDEX(Character), 1,
+                                 ECsvCustomStatOp::Accumulate);
+#endif
+}
+
+void FCharacterStats::RecordShiftSolve(EShiftBranch branch, double seconds) {
+  RollFrame();
+  m_branches[static_cast<int32>(branch)].Add(seconds);
+#if CSV_PROFILER
+  FCsvProfiler::RecordCustomStat(GetBranchCsvName(branch), CSV_CATEGORY_INDEX(Character), 1,
+                                 ECsvCustomStatOp::Accumulate);
+#endif
+}
+
+void FCharacterStats::RollFrame() {
+  if (m_currentFrame == GFrameCounter) return;
+
+  if (m_currentFrame != 0) {
+    m_frames++;
+    for (FCallCount& calls : m_calls) {
+      calls.maxPerFrame = FMath::Max(calls.maxPerFrame, calls.frame);
+      calls.frame = 0;
+    }
+    CheckBudget();
+  }
+  m_currentFrame = GFrameCounter;
+  m_frameSeconds = 0;
+}
+
+void FCharacterStats::CheckBudget() {
+  const float budgetMs = CVarCharacterBudget.GetValueOnGameThread();
+  if (budgetMs <= 0 || m_frameSeconds * 1000.0 <= budgetMs) return;
+
+  m_overBudgetFrames++;
+  // one line a second at most, a bad stretch would flood the log otherwise
+  const double now = FPlatformTime::Seconds();
+  if (now - m_lastWarningTime < 1.0) {
+    m_suppressedWarnings++;
+    return;
+  }
+  UE_LOG(LogCharacterStats, Warning,
+         TEXT("Characters took %.3f ms in frame %llu, budget is %.3f ms (%llu more since last warning)"),
+         m_frameSeconds * 1000.0, m_currentFrame, budgetMs, m_suppressedWarnings);
+  CSV_EVENT(Character, TEXT("OverBudget"));
+  m_lastWarningTime = now;
+  m_suppressedWarnings = 0;
+}
+
+void FCharacterStats::Reset() {
+  *this = FCharacterStats();
+}
+
+void FCharacterStats::Log() const {
+  UE_LOG(LogCharacterStats, Display, TEXT("Character stats over %llu frames, %llu over budget"), m_frames,
+         m_overBudgetFrames);
+  for (int32 i = 0; i < UE_ARRAY_COUNT(m_scopes); i++) {
+    const FTiming& timing = m_scopes[i];
+    UE_LOG(LogCharacterStats, Display, TEXT("  %-16s %8llu calls, %8.2f us avg, %8.2f us max"), GScopeNames[i],
+           timing.count, ToMicroseconds(timing.seconds / FMath::Max<uint64>(timing.count, 1)),
+           ToMicroseconds(timing.maxSeconds));
+  }
+  for (int32 i = 0; i < UE_ARRAY_COUNT(m_branches); i++) {
+    const FTiming& timing = m_branches[i];
+    UE_LOG(LogCharacterStats, Display, TEXT("  Shift %-14s %8llu solves, %8.2f us avg, %8.2f us max"),
+           LexToString(static_cast<EShiftBranch>(i)), timing.count, ToMicroseconds(timing.seconds / FMath::Max<uint64>(timing.count, 1)),
+           ToMicroseconds(timing.maxSeconds));
+  }
+  for (int32 i = 0; i < UE_ARRAY_COUNT(m_calls); i++) {
+    const FCallCount& calls = m_calls[i];
+    UE_LOG(LogCharacterStats, Display, TEXT("  %-20s %8llu calls, %6.2f per frame, %4u max per frame"),
+           GCallNames[i], calls.total, static_cast<double>(calls.total) / FMath::Max<uint64>(m_frames, 1),
+           calls.maxPerFrame);
+  }
+  FString histogram;
+  for (int32 i = 0; i < kLatencyBuckets; i++) {
+    histogram += FString::Printf(TEXT(" %s:%llu"), *GetLatencyLabel(i), m_latency[i]);
+  }
+  UE_LOG(LogCharacterStats, Display, TEXT("  StartAbility latency%s"), *histogram);
+}
+
+bool FCharacterStats::CheckLimits() const {
+  bool withinLimits = true;
+  for (int32 i = 0; i < UE_ARRAY_COUNT(m_scopes); i++) {
+    float limitUs = 0.f;
+    if (!FParse::Value(FCommandLine::Get(), *FString::Printf(TEXT("CharacterLimit.%s="), GScopeNames[i]), limitUs)) {
+      continue;
+    }
+    const FTiming& timing = m_scopes[i];
+    const double averageUs = ToMicroseconds(timing.seconds / FMath::Max<uint64>(timing.count, 1));
+    if (averageUs > limitUs) {
+      UE_LOG(LogCharacterStats, Error, TEXT("%s averaged %.2f us over %llu calls, limit is %.2f us"), GScopeNames[i],
+             averageUs, timing.count, limitUs);
+      withinLimits = false;
+    }
+  }
+  return withinLimits;
+}
+
+FString FCharacterStats::GetDefaultCsvPath() {
+  return FPaths::ProfilingDir() / FString::Printf(TEXT("CharacterStats-%s.csv"), *FDateTime::Now().ToString());
+}
+
+// long format so runs from different builds can be joined on section + name
+bool FCharacterStats::WriteCsv(const FString& path) const {
+  FString csv = TEXT("Section,Name,Count,TotalMs,AvgUs,MaxUs\n");
+  csv += FString::Printf(TEXT("Frames,All,%llu,,,\n"), m_frames);
+  csv += FString::Printf(TEXT("Frames,OverBudget,%llu,,,\n"), m_overBudgetFrames);
+
+  auto addTiming = [&csv](const TCHAR* section, const TCHAR* name, const FTiming& timing) {
+    csv += FString::Printf(TEXT("%s,%s,%llu,%.4f,%.3f,%.3f\n"), section, name, timing.count, timing.seconds * 1000.0,
+                           ToMicroseconds(timing.seconds / FMath::Max<uint64>(timing.count, 1)),
+                           ToMicroseconds(timing.maxSeconds));
+  };
+  for (int32 i = 0; i < UE_ARRAY_COUNT(m_scopes); i++) {
+    addTiming(TEXT("Scope"), GScopeNames[i], m_scopes[i]);
+  }
+  for (int32 i = 0; i < UE_ARRAY_COUNT(m_branches); i++) {
+    addTiming(TEXT("ShiftBranch"), LexToString(static_cast<EShiftBranch>(i)), m_branches[i]);
+  }
+  // calls are counted per frame, avg and max are calls per frame here
+  for (int32 i = 0; i < UE_ARRAY_COUNT(m_calls); i++) {
+    const FCallCount& calls = m_calls[i];
+    csv += FString::Printf(TEXT("Calls,%s,%llu,,%.3f,%u\n"), GCallNames[i], calls.total,
+                           static_cast<double>(calls.total) / FMath::Max<uint64>(m_frames, 1), calls.maxPerFrame);
+  }
+  for (int32 i = 0; i < kLatencyBuckets; i++) {
+    csv += FString::Printf(TEXT("StartAbilityLatency,%s,%llu,,,\n"), *GetLatencyLabel(i), m_latency[i]);
+  }
+
+  if (!FFileHelper::SaveStringToFile(csv, *path)) {
+    UE_LOG(LogCharacterStats, Error, TEXT("Could not write character stats to %s"), *path);
+    return false;
+  }
+  UE_LOG(LogCharacterStats, Display, TEXT("Wrote character stats to %s"), *path);
+  return true;
+}
+
+#endif
@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ShiftLandingSolver.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+
+// Per frame cost of the character hot paths. Each CHARACTER_STAT_SCOPE feeds three sinks:
+//  - "stat Character" in the viewport
+//  - the Character channel in Insights (-trace=cpu,character)
+//  - the Character category of the csv profiler (-csvCaptureFrames=N or csvprofile start/stop)
+// On top of that FCharacterStats keeps run totals, shift branch counts and the StartAbility latency
+// histogram, written out by fps.Character.Stats csv or at the end of an input replay run with
+// -CharacterStatsCsv.
+// Compiles out of Shipping builds.
+#define ENABLE_CHARACTER_STATS !UE_BUILD_SHIPPING
+
+DECLARE_STATS_GROUP(TEXT("Character"), STATGROUP_Character, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Tick"), STAT_CharacterTick, STATGROUP_Character, FPS_CONTROLLER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("HandleSpeed"), STAT_CharacterHandleSpeed, STATGROUP_Character, FPS_CONTROLLER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("HandleCrouch"), STAT_CharacterHandleCrouch, STATGROUP_Character, FPS_CONTROLLER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("StartAbility"), STAT_CharacterStartAbility, STATGROUP_Character, FPS_CONTROLLER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ExecuteAbility"), STAT_CharacterExecuteAbility, STATGROUP_Character,
+                          FPS_CONTROLLER_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Movement"), STAT_CharacterMovement, STATGROUP_Character, FPS_CONTROLLER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("SetCapsuleHalfHeight calls"), STAT_CharacterSetCapsuleHalfHeight,
+                                  STATGROUP_Character, FPS_CONTROLLER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("SetActorLocation calls"), STAT_CharacterSetActorLocation,
+                                  STATGROUP_Character, FPS_CONTROLLER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Shift solves"), STAT_CharacterShiftSolves, STATGROUP_Character,
+                                  FPS_CONTROLLER_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Shift scratch spills"), STAT_CharacterShiftScratchSpill,
+                                  STATGROUP_Character, FPS_CONTROLLER_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(FPS_CONTROLLER_API, Character);
+UE_TRACE_CHANNEL_EXTERN(CharacterChannel, FPS_CONTROLLER_API);
+
+enum class ECharacterScope : uint8 {
+  kTick,
+  kHandleSpeed,
+  kHandleCrouch,
+  kStartAbility,
+  kExecuteAbility,
+  kMovement, // the movement component's tick, HandleSpeed runs inside it
+  kCount
+};
+
+enum class ECharacterCall : uint8 {
+  kSetCapsuleHalfHeight,
+  kSetActorLocation,
+  kShiftScratchSpill, // a shift query touched more components than its inline slots hold
+  kCount
+};
+
+// GetShiftBranchName as TCHAR, what the stats and the telemetry reader print
+FPS_CONTROLLER_API const TCHAR* LexToString(EShiftBranch branch);
+
+#if ENABLE_CHARACTER_STATS
+
+class FPS_CONTROLLER_API FCharacterStats {
+public:
+  // log2 buckets from 16us up, the last one takes everything slower
+  static constexpr int32 kLatencyBuckets = 10;
+  static constexpr double kLatencyBucketBase = 16e-6;
+
+  static FCharacterStats& Get();
+
+  void RecordScope(ECharacterScope scope, double seconds);
+  void RecordCall(ECharacterCall call);
+  void RecordShiftSolve(EShiftBranch branch, double seconds);
+
+  // run totals since the last Reset
+  uint64 GetScopeCount(ECharacterScope scope) const { return m_scopes[static_cast<int32>(scope)].count; }
+  double GetScopeSeconds(ECharacterScope scope) const { return m_scopes[static_cast<int32>(scope)].seconds; }
+  double GetScopeMaxSeconds(ECharacterScope scope) const { return m_scopes[static_cast<int32>(scope)].maxSeconds; }
+
+  void Reset();
+  void Log() const;
+  bool WriteCsv(const FString& path) const;
+  // -CharacterLimit.<Scope>=<us> on the command line caps the average of that scope, false if any is over
+  bool CheckLimits() const;
+  static FString GetDefaultCsvPath();
+
+private:
+  struct FTiming {
+    uint64 count = 0;
+    double seconds = 0;
+    double maxSeconds = 0;
+
+    void Add(double time);
+  };
+
+  struct FCallCount {
+    uint64 total = 0;
+    uint32 frame = 0;
+    uint32 maxPerFrame = 0;
+  };
+
+  // frame totals are closed lazily by the first record of the next frame
+  void RollFrame();
+  void CheckBudget();
+
+  FTiming m_scopes[static_cast<int32>(ECharacterScope::kCount)];
+  FTiming m_branches[static_cast<int32>(EShiftBranch::kCount)];
+  FCallCount m_calls[static_cast<int32>(ECharacterCall::kCount)];
+  uint64 m_latency[kLatencyBuckets] = {};
+  uint64 m_frames = 0;
+  uint64 m_overBudgetFrames = 0;
+  uint64 m_suppressedWarnings = 0;
+  uint64 m_currentFrame = 0;
+  double m_frameSeconds = 0;
+  double m_lastWarningTime = 0;
+};
+
+// times one call of a hot path, the Tick scope is also what the frame budget is checked against
+class FCharacterStatScope {
+public:
+  explicit FCharacterStatScope(ECharacterScope scope) : m_scope(scope), m_start(FPlatformTime::Cycles64()) {}
+
+  ~FCharacterStatScope() {
+    FCharacterStats::Get().RecordScope(m_scope, FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - m_start));
+  }
+
+private:
+  ECharacterScope m_scope;
+  uint64 m_start;
+};
+
+#define CHARACTER_STAT_SCOPE(Name) \
+  SCOPE_CYCLE_COUNTER(STAT_Character##Name); \
+  CSV_SCOPED_TIMING_STAT(Character, Name); \
+  TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL_STR("Character::" #Name, CharacterChannel); \
+  FCharacterStatScope CharacterStatScope_##Name(ECharacterScope::k##Name)
+#define CHARACTER_STAT_CALL(Name) \
+  do { \
+    INC_DWORD_STAT(STAT_Character##Name); \
+    FCharacterStats::Get().RecordCall(ECharacterCall::k##Name); \
+  } while (0)
+#define CHARACTER_STAT_SHIFT_SOLVE(branch, seconds) \
+  do { \
+    INC_DWORD_STAT(STAT_CharacterShiftSolves); \
+    FCharacterStats::Get().RecordShiftSolve(branch, seconds); \
+  } while (0)
+
+#else
+
+#define CHARACTER_STAT_SCOPE(Name)
+#define CHARACTER_STAT_CALL(Name) do {} while (0)
+#define CHARACTER_STAT_SHIFT_SOLVE(branch, seconds) do {} while (0)
+
+#endif
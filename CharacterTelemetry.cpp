@@ -0,0 +1,467 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CharacterTelemetry.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/ScopeLock.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogCharacterTelemetry, Log, All);
+
+// Rows of one recording thread, handed to the flush thread whole. Sized so a character sampled every frame
+// fills one in about ten seconds, the other tables fill far slower and ride along.
+struct FTelemetryChunk {
+  static constexpr int32 kFrames = 512;
+  static constexpr int32 kShifts = 64;
+  static constexpr int32 kCharacters = 16;
+
+  uint32 session = 0;
+  int32 frameCount = 0;
+  int32 shiftCount = 0;
+  int32 characterCount = 0;
+  FTelemetryFrame frames[kFrames];
+  FTelemetryShift shifts[kShifts];
+  FTelemetryCharacter characters[kCharacters];
+};
+
+namespace {
+  constexpr uint32 kTelemetryMagic = 0x4D4C5443; // CTLM
+  constexpr uint32 kTelemetryVersion = 1;
+  constexpr uint32 kFlushIntervalMs = 200;
+  // frames per block, what the flush thread sorts and compresses in one go
+  constexpr int32 kBlockRows = 16 * 1024;
+  // what a reader accepts before calling a block corrupt, far above anything the writer produces
+  constexpr uint32 kMaxBlockRows = 1 << 24;
+
+  enum class ETelemetryTable : uint8 { kFrames, kShifts, kCharacters };
+
+  // fixed point steps, plenty for tuning statistics
+  constexpr double kVelocityScale = 1;   // 1 cm/s
+  constexpr double kHalfHeightScale = 10;
+  constexpr double kManaScale = 10;
+  constexpr double kCoolDownScale = 1000; // ms
+  constexpr double kTuningScale = 1000;
+
+  // the one place a column is defined, the writer and the reader both go through these
+  template <typename TRow>
+  struct TTelemetryColumn {
+    int64 (*get)(const TRow&);
+    void (*set)(TRow&, int64);
+  };
+
+#define TELEMETRY_INT_COLUMN(Row, Field) \
+  {[](const Row& row) -> int64 { return row.Field; }, \
+   [](Row& row, int64 value) { row.Field = static_cast<decltype(row.Field)>(value); }}
+#define TELEMETRY_FIXED_COLUMN(Row, Field, Scale) \
+  {[](const Row& row) -> int64 { return FMath::RoundToInt64(row.Field * (Scale)); }, \
+   [](Row& row, int64 value) { row.Field = static_cast<float>(value / (Scale)); }}
+
+  const TTelemetryColumn<FTelemetryFrame> GFrameColumns[] = {
+    TELEMETRY_INT_COLUMN(FTelemetryFrame, character),
+    TELEMETRY_INT_COLUMN(FTelemetryFrame, timeMs),
+    TELEMETRY_INT_COLUMN(FTelemetryFrame, movementState),
+    TELEMETRY_FIXED_COLUMN(FTelemetryFrame, velocity.X, kVelocityScale),
+    TELEMETRY_FIXED_COLUMN(FTelemetryFrame, velocity.Y, kVelocityScale),
+    TELEMETRY_FIXED_COLUMN(FTelemetryFrame, velocity.Z, kVelocityScale),
+    TELEMETRY_FIXED_COLUMN(FTelemetryFrame, halfHeight, kHalfHeightScale),
+    TELEMETRY_FIXED_COLUMN(FTelemetryFrame, mana, kManaScale),
+    TELEMETRY_FIXED_COLUMN(FTelemetryFrame, coolDown, kCoolDownScale),
+  };
+
+  const TTelemetryColumn<FTelemetryShift> GShiftColumns[] = {
+    TELEMETRY_INT_COLUMN(FTelemetryShift, character),
+    TELEMETRY_INT_COLUMN(FTelemetryShift, timeMs),
+    TELEMETRY_INT_COLUMN(FTelemetryShift, branch),
+    TELEMETRY_INT_COLUMN(FTelemetryShift, flags),
+    TELEMETRY_INT_COLUMN(FTelemetryShift, outcome),
+  };
+
+  const TTelemetryColumn<FTelemetryCharacter> GCharacterColumns[] = {
+    TELEMETRY_INT_COLUMN(FTelemetryCharacter, character),
+    TELEMETRY_FIXED_COLUMN(FTelemetryCharacter, slideBoost, kTuningScale),
+    TELEMETRY_FIXED_COLUMN(FTelemetryCharacter, slideTime, kTuningScale),
+    TELEMETRY_FIXED_COLUMN(FTelemetryCharacter, speedMultiplier, kTuningScale),
+    TELEMETRY_FIXED_COLUMN(FTelemetryCharacter, manaCost, kTuningScale),
+    TELEMETRY_FIXED_COLUMN(FTelemetryCharacter, rechargeRate, kTuningScale),
+    TELEMETRY_FIXED_COLUMN(FTelemetryCharacter, rechargeDelay, kTuningScale),
+  };
+
+#undef TELEMETRY_INT_COLUMN
+#undef TELEMETRY_FIXED_COLUMN
+
+  void PutTelemetryVarInt(TArray<uint8>& out, uint64 value) {
+    while (value >= 0x80) {
+      out.Add(static_cast<uint8>(value) | 0x80);
+      value >>= 7;
+    }
+    out.Add(static_cast<uint8>(value));
+  }
+
+  bool GetTelemetryVarInt(const uint8*& data, const uint8* end, uint64& out) {
+    out = 0;
+    for (int32 shift = 0; shift < 70 && data < end; shift += 7) {
+      const uint8 byte = *data++;
+      out |= static_cast<uint64>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+  }
+
+  uint64 TelemetryZigZag(int64 value) {
+    return (static_cast<uint64>(value) << 1) ^ static_cast<uint64>(value >> 63);
+  }
+
+  int64 TelemetryUnZigZag(uint64 value) {
+    return static_cast<int64>((value >> 1) ^ (0ull - (value & 1)));
+  }
+
+  template <typename T>
+  bool GetTelemetryValue(const uint8*& data, const uint8* end, T& out) {
+    if (end - data < static_cast<int64>(sizeof(T))) return false;
+    FMemory::Memcpy(&out, data, sizeof(T));
+    data += sizeof(T);
+    return true;
+  }
+
+  // Columns one after the other, each as zigzag varint deltas against the row before, Oodle compressed
+  // unless that does not pay. Per column: raw size, stored size (0 when stored raw), bytes.
+  template <typename TRow, int32 N>
+  void WriteTelemetryBlock(FArchive& file, ETelemetryTable table, TConstArrayView<TRow> rows,
+                           const TTelemetryColumn<TRow> (&columns)[N], TArray<uint8>& column,
+                           TArray<uint8>& compressed, FTelemetryWriteStats& stats) {
+    uint8 tableId = static_cast<uint8>(table);
+    uint32 rowCount = rows.Num();
+    uint8 columnCount = N;
+    file << tableId << rowCount << columnCount;
+    for (const TTelemetryColumn<TRow>& definition : columns) {
+      column.Reset();
+      int64 previous = 0;
+      for (const TRow& row : rows) {
+        const int64 value = definition.get(row);
+        PutTelemetryVarInt(column, TelemetryZigZag(value - previous));
+        previous = value;
+      }
+
+      int32 packedSize = FCompression::CompressMemoryBound(NAME_Oodle, column.Num());
+      compressed.SetNumUninitialized(packedSize, false);
+      const bool packed = FCompression::CompressMemory(NAME_Oodle, compressed.GetData(), packedSize,
+                                                       column.GetData(), column.Num());
+      uint32 rawSize = column.Num();
+      uint32 storedSize = packed && packedSize < column.Num() ? packedSize : 0;
+      file << rawSize << storedSize;
+      file.Serialize(storedSize > 0 ? compressed.GetData() : column.GetData(), storedSize > 0 ? storedSize : rawSize);
+      stats.rawBytes += rawSize;
+    }
+    stats.rows += rows.Num();
+    stats.blocks++;
+  }
+
+  // columns this build does not know are skipped, ones the file does not have keep their defaults
+  template <typename TRow, int32 N>
+  bool ReadTelemetryBlock(const uint8*& data, const uint8* end, uint32 rowCount, uint8 columnCount,
+                          const TTelemetryColumn<TRow> (&columns)[N], TArray<TRow>& outRows,
+                          TArray<uint8>& scratch) {
+    outRows.Reset();
+    outRows.SetNum(rowCount, false);
+    for (int32 i = 0; i < columnCount; i++) {
+      uint32 rawSize;
+      uint32 storedSize;
+      if (!GetTelemetryValue(data, end, rawSize) || !GetTelemetryValue(data, end, storedSize)) return false;
+      const uint32 size = storedSize > 0 ? storedSize : rawSize;
+      if (end - data < static_cast<int64>(size)) return false;
+
+      const uint8* column = data;
+      data += size;
+      if (i >= N) continue;
+      if (storedSize > 0) {
+        scratch.SetNumUninitialized(rawSize, false);
+        if (!FCompression::UncompressMemory(NAME_Oodle, scratch.GetData(), rawSize, column, storedSize)) {
+          return false;
+        }
+        column = scratch.GetData();
+      }
+
+      const uint8* columnEnd = column + rawSize;
+      int64 value = 0;
+      for (TRow& row : outRows) {
+        uint64 encoded;
+        if (!GetTelemetryVarInt(column, columnEnd, encoded)) return false;
+        value += TelemetryUnZigZag(encoded);
+        columns[i].set(row, value);
+      }
+    }
+    return true;
+  }
+
+  // the chunk this thread is filling and the session it belongs to
+  thread_local FTelemetryChunk* GTelemetryChunk = nullptr;
+  thread_local uint32 GTelemetryChunkSession = 0;
+}
+
+class FCharacterTelemetry::FFlushThread : public FRunnable {
+public:
+  explicit FFlushThread(FCharacterTelemetry& owner) : m_owner(owner) {}
+
+  virtual uint32 Run() override {
+    while (!m_stopping.load(std::memory_order_acquire)) {
+      m_owner.m_wake->Wait(kFlushIntervalMs);
+      m_owner.Drain(false);
+    }
+    m_owner.Drain(true);
+    return 0;
+  }
+
+  virtual void Stop() override {
+    m_stopping.store(true, std::memory_order_release);
+    m_owner.m_wake->Trigger();
+  }
+
+private:
+  FCharacterTelemetry& m_owner;
+  std::atomic<bool> m_stopping{false};
+};
+
+FCharacterTelemetry& FCharacterTelemetry::Get() {
+  static FCharacterTelemetry telemetry;
+  return telemetry;
+}
+
+bool FCharacterTelemetry::Start(const FString& path) {
+  check(IsInGameThread());
+  Stop();
+  m_file.Reset(IFileManager::Get().CreateFileWriter(*path));
+  if (!m_file) {
+    UE_LOG(LogCharacterTelemetry, Error, TEXT("Could not open %s for telemetry"), *path);
+    return false;
+  }
+  uint32 magic = kTelemetryMagic;
+  uint32 version = kTelemetryVersion;
+  *m_file << magic << version;
+  {
+    FScopeLock lock(&m_statsLock);
+    m_stats = FTelemetryWriteStats();
+  }
+
+  m_path = path;
+  m_session.fetch_add(1, std::memory_order_relaxed);
+  m_startCycles = FPlatformTime::Cycles64();
+  m_wake = FPlatformProcess::GetSynchEventFromPool(false);
+  m_flush = new FFlushThread(*this);
+  m_thread = FRunnableThread::Create(m_flush, TEXT("CharacterTelemetryFlush"), 0, TPri_BelowNormal);
+  m_recording.store(true, std::memory_order_release);
+  UE_LOG(LogCharacterTelemetry, Display, TEXT("Recording telemetry to %s"), *path);
+  return true;
+}
+
+void FCharacterTelemetry::Stop() {
+  check(IsInGameThread());
+  if (!IsRecording()) return;
+  m_recording.store(false, std::memory_order_release);
+  if (GTelemetryChunk != nullptr && GTelemetryChunkSession == m_session.load(std::memory_order_relaxed)) {
+    Submit(GTelemetryChunk);
+  }
+
+  // stops the runnable and waits for the last drain
+  m_thread->Kill(true);
+  delete m_thread;
+  delete m_flush;
+  m_thread = nullptr;
+  m_flush = nullptr;
+  FPlatformProcess::ReturnSynchEventToPool(m_wake);
+  m_wake = nullptr;
+  m_file->Close();
+  m_file.Reset();
+
+  const FTelemetryWriteStats stats = GetStats();
+  UE_LOG(LogCharacterTelemetry, Display,
+         TEXT("Telemetry %s: %llu rows in %u blocks, %.1f KB of columns written as %.1f KB, ")
+         TEXT("%.1f ms on the flush thread"),
+         *m_path, stats.rows, stats.blocks, stats.rawBytes / 1024.0, stats.writtenBytes / 1024.0,
+         stats.flushSeconds * 1000);
+}
+
+uint32 FCharacterTelemetry::GetTimeMs() const {
+  return static_cast<uint32>(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - m_startCycles));
+}
+
+FTelemetryWriteStats FCharacterTelemetry::GetStats() const {
+  FScopeLock lock(&m_statsLock);
+  return m_stats;
+}
+
+FTelemetryChunk* FCharacterTelemetry::GetChunk() {
+  if (!IsRecording()) return nullptr;
+  const uint32 session = m_session.load(std::memory_order_relaxed);
+  if (GTelemetryChunk != nullptr && GTelemetryChunkSession == session) return GTelemetryChunk;
+
+  // a chunk left over from an earlier session goes back with its rows
+  if (GTelemetryChunk != nullptr) {
+    m_free.Push(GTelemetryChunk);
+  }
+  FTelemetryChunk* chunk = m_free.Pop();
+  if (chunk == nullptr) {
+    chunk = new FTelemetryChunk;
+  }
+  chunk->session = session;
+  chunk->frameCount = chunk->shiftCount = chunk->characterCount = 0;
+  GTelemetryChunk = chunk;
+  GTelemetryChunkSession = session;
+  return chunk;
+}
+
+void FCharacterTelemetry::Submit(FTelemetryChunk* chunk) {
+  GTelemetryChunk = nullptr;
+  m_filled.Enqueue(chunk);
+}
+
+void FCharacterTelemetry::Record(const FTelemetryFrame& row) {
+  FTelemetryChunk* chunk = GetChunk();
+  if (chunk == nullptr) return;
+  chunk->frames[chunk->frameCount++] = row;
+  if (chunk->frameCount == FTelemetryChunk::kFrames) {
+    Submit(chunk);
+  }
+}
+
+void FCharacterTelemetry::Record(const FTelemetryShift& row) {
+  FTelemetryChunk* chunk = GetChunk();
+  if (chunk == nullptr) return;
+  chunk->shifts[chunk->shiftCount++] = row;
+  if (chunk->shiftCount == FTelemetryChunk::kShifts) {
+    Submit(chunk);
+  }
+}
+
+void FCharacterTelemetry::Record(const FTelemetryCharacter& row) {
+  FTelemetryChunk* chunk = GetChunk();
+  if (chunk == nullptr) return;
+  chunk->characters[chunk->characterCount++] = row;
+  if (chunk->characterCount == FTelemetryChunk::kCharacters) {
+    Submit(chunk);
+  }
+}
+
+void FCharacterTelemetry::Drain(bool final) {
+  const uint64 start = FPlatformTime::Cycles64();
+  const uint32 session = m_session.load(std::memory_order_relaxed);
+  FTelemetryChunk* chunk;
+  while (m_filled.Dequeue(chunk)) {
+    // a thread can still submit a chunk of the last session after it stopped
+    if (chunk->session == session) {
+      m_stagedFrames.Append(chunk->frames, chunk->frameCount);
+      m_stagedShifts.Append(chunk->shifts, chunk->shiftCount);
+      m_stagedCharacters.Append(chunk->characters, chunk->characterCount);
+    }
+    m_free.Push(chunk);
+    if (m_stagedFrames.Num() >= kBlockRows) {
+      WriteBlocks();
+    }
+  }
+  if (final) {
+    WriteBlocks();
+  }
+
+  FScopeLock lock(&m_statsLock);
+  m_stats.flushSeconds += FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - start);
+}
+
+void FCharacterTelemetry::WriteBlocks() {
+  // sorted the delta columns barely move: character and time go up in small steps, the state repeats
+  m_stagedFrames.StableSort([](const FTelemetryFrame& a, const FTelemetryFrame& b) {
+    return a.character != b.character ? a.character < b.character : a.timeMs < b.timeMs;
+  });
+  m_stagedShifts.StableSort([](const FTelemetryShift& a, const FTelemetryShift& b) {
+    return a.character != b.character ? a.character < b.character : a.timeMs < b.timeMs;
+  });
+
+  FTelemetryWriteStats stats;
+  // characters first, a reader sees the tuning before the rows that ran on it
+  if (m_stagedCharacters.Num() > 0) {
+    WriteTelemetryBlock<FTelemetryCharacter>(*m_file, ETelemetryTable::kCharacters, m_stagedCharacters,
+                                             GCharacterColumns, m_column, m_compressed, stats);
+  }
+  if (m_stagedFrames.Num() > 0) {
+    WriteTelemetryBlock<FTelemetryFrame>(*m_file, ETelemetryTable::kFrames, m_stagedFrames, GFrameColumns,
+                                         m_column, m_compressed, stats);
+  }
+  if (m_stagedShifts.Num() > 0) {
+    WriteTelemetryBlock<FTelemetryShift>(*m_file, ETelemetryTable::kShifts, m_stagedShifts, GShiftColumns,
+                                         m_column, m_compressed, stats);
+  }
+  m_stagedFrames.Reset();
+  m_stagedShifts.Reset();
+  m_stagedCharacters.Reset();
+
+  FScopeLock lock(&m_statsLock);
+  m_stats.rows += stats.rows;
+  m_stats.rawBytes += stats.rawBytes;
+  m_stats.blocks += stats.blocks;
+  m_stats.writtenBytes = m_file->Tell();
+}
+
+bool FCharacterTelemetryReader::Read(const FString& path, FTelemetryReadStats& outStats) const {
+  const uint64 start = FPlatformTime::Cycles64();
+  outStats = FTelemetryReadStats();
+  TArray<uint8> file;
+  if (!FFileHelper::LoadFileToArray(file, *path)) {
+    UE_LOG(LogCharacterTelemetry, Error, TEXT("Could not read %s"), *path);
+    return false;
+  }
+  outStats.fileBytes = file.Num();
+
+  const uint8* data = file.GetData();
+  const uint8* end = data + file.Num();
+  uint32 magic;
+  uint32 version;
+  if (!GetTelemetryValue(data, end, magic) || !GetTelemetryValue(data, end, version) ||
+    magic != kTelemetryMagic || version != kTelemetryVersion) {
+    UE_LOG(LogCharacterTelemetry, Error, TEXT("%s is not a telemetry file of version %u"), *path, kTelemetryVersion);
+    return false;
+  }
+
+  TArray<FTelemetryFrame> frames;
+  TArray<FTelemetryShift> shifts;
+  TArray<FTelemetryCharacter> characters;
+  TArray<uint8> scratch;
+  while (data < end) {
+    uint8 table;
+    uint32 rowCount;
+    uint8 columnCount;
+    bool valid = GetTelemetryValue(data, end, table) && GetTelemetryValue(data, end, rowCount) &&
+      GetTelemetryValue(data, end, columnCount) && rowCount <= kMaxBlockRows;
+    if (valid) {
+      switch (static_cast<ETelemetryTable>(table)) {
+      case ETelemetryTable::kFrames: valid = ReadTelemetryBlock(data, end, rowCount, columnCount, GFrameColumns,
+                                                                frames, scratch);
+        if (valid && onFrames) onFrames(frames);
+        break;
+      case ETelemetryTable::kShifts: valid = ReadTelemetryBlock(data, end, rowCount, columnCount, GShiftColumns,
+                                                                shifts, scratch);
+        if (valid && onShifts) onShifts(shifts);
+        break;
+      case ETelemetryTable::kCharacters: valid = ReadTelemetryBlock(data, end, rowCount, columnCount,
+                                                                    GCharacterColumns, characters, scratch);
+        if (valid && onCharacters) onCharacters(characters);
+        break;
+      default: valid = false;
+        break;
+      }
+    }
+    // a session cut short (crash, killed process) ends in a partial block, everything before it still counts
+    if (!valid) {
+      UE_LOG(LogCharacterTelemetry, Warning, TEXT("%s is truncated or corrupt after %u blocks"), *path,
+             outStats.blocks);
+      break;
+    }
+    outStats.rows += rowCount;
+    outStats.blocks++;
+  }
+  outStats.seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - start);
+  return true;
+}
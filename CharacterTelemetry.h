@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LockFreeList.h"
+#include "Containers/Queue.h"
+#include <atomic>
+
+class FArchive;
+class FEvent;
+class FRunnableThread;
+struct FTelemetryChunk;
+
+// one character on one frame, movementState matches EMovementState on the character
+struct FTelemetryFrame {
+  uint32 timeMs = 0; // since the session started
+  uint16 character = 0;
+  uint8 movementState = 0;
+  FVector3f velocity = FVector3f::ZeroVector;
+  float halfHeight = 0.f;
+  float mana = 0.f;
+  float coolDown = 0.f; // UShiftAbilityComponent::GetCoolDownElapsed
+};
+
+enum class ETelemetryShiftOutcome : uint8 {
+  kShifted,
+  kNoTarget, // the last solve found no spot
+  kNotReady, // still cooling down
+  kNoMana,
+  kCount
+};
+
+// one release of the shift, with the solve it went on
+struct FTelemetryShift {
+  uint32 timeMs = 0;
+  uint16 character = 0;
+  uint8 branch = 0; // EShiftBranch
+  uint8 flags = 0;  // FShiftSolution::flags, the flagChecks pattern
+  uint8 outcome = 0; // ETelemetryShiftOutcome
+};
+
+// the tuning a character ran with, written once per character and session
+struct FTelemetryCharacter {
+  uint16 character = 0;
+  float slideBoost = 0.f;
+  float slideTime = 0.f;
+  float speedMultiplier = 0.f;
+  float manaCost = 0.f;
+  float rechargeRate = 0.f;
+  float rechargeDelay = 0.f;
+};
+
+struct FTelemetryWriteStats {
+  uint64 rows = 0;
+  uint64 rawBytes = 0;     // column bytes before compression
+  uint64 writtenBytes = 0; // file size
+  uint32 blocks = 0;
+  double flushSeconds = 0; // spent on the flush thread
+};
+
+// Records gameplay telemetry into a columnar file for offline tuning. Recording copies the row into the
+// calling thread's chunk, no lock and no allocation; full chunks go through a lock free queue to a flush
+// thread, which sorts them into blocks by character and time, encodes every column on its own as zigzag
+// varint deltas of the quantized values and compresses each column with Oodle. A file is a header and a
+// run of blocks, FCharacterTelemetryReader decodes them back.
+// See UCharacterTelemetrySubsystem for what gets sampled and UCharacterTelemetryCommandlet for the report.
+class FPS_CONTROLLER_API FCharacterTelemetry {
+public:
+  static FCharacterTelemetry& Get();
+
+  // both on the game thread. Stop hands over the game thread's open chunk, rows still sitting in other
+  // threads' chunks are dropped
+  bool Start(const FString& path);
+  void Stop();
+  bool IsRecording() const { return m_recording.load(std::memory_order_relaxed); }
+  uint32 GetTimeMs() const;
+  const FString& GetPath() const { return m_path; }
+  FTelemetryWriteStats GetStats() const;
+
+  // any thread
+  void Record(const FTelemetryFrame& row);
+  void Record(const FTelemetryShift& row);
+  void Record(const FTelemetryCharacter& row);
+
+private:
+  class FFlushThread;
+
+  FTelemetryChunk* GetChunk();
+  void Submit(FTelemetryChunk* chunk);
+  // flush thread, moves queued chunks into the block being staged and writes it once it is full
+  void Drain(bool final);
+  void WriteBlocks();
+
+  std::atomic<bool> m_recording{false};
+  std::atomic<uint32> m_session{0};
+  uint64 m_startCycles = 0;
+  FString m_path;
+
+  TQueue<FTelemetryChunk*, EQueueMode::Mpsc> m_filled;
+  TLockFreePointerListUnordered<FTelemetryChunk, PLATFORM_CACHE_LINE_SIZE> m_free;
+
+  // flush thread only
+  TArray<FTelemetryFrame> m_stagedFrames;
+  TArray<FTelemetryShift> m_stagedShifts;
+  TArray<FTelemetryCharacter> m_stagedCharacters;
+  TUniquePtr<FArchive> m_file;
+  TArray<uint8> m_column;
+  TArray<uint8> m_compressed;
+
+  FRunnableThread* m_thread = nullptr;
+  FFlushThread* m_flush = nullptr;
+  FEvent* m_wake = nullptr;
+  mutable FCriticalSection m_statsLock;
+  FTelemetryWriteStats m_stats;
+};
+
+struct FTelemetryReadStats {
+  uint64 rows = 0;
+  uint64 fileBytes = 0;
+  uint32 blocks = 0;
+  double seconds = 0;
+};
+
+// Decodes a telemetry file one block at a time, the visitors see every row of a block in one call. Blocks
+// are sorted by character and time within themselves only.
+class FPS_CONTROLLER_API FCharacterTelemetryReader {
+public:
+  TFunction<void(TConstArrayView<FTelemetryFrame>)> onFrames;
+  TFunction<void(TConstArrayView<FTelemetryShift>)> onShifts;
+  TFunction<void(TConstArrayView<FTelemetryCharacter>)> onCharacters;
+
+  bool Read(const FString& path, FTelemetryReadStats& outStats) const;
+};
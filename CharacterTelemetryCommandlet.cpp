@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CharacterTelemetryCommandlet.h"
+
+#include "CharacterStats.h"
+#include "CharacterTelemetry.h"
+#include "Containers/SortedMap.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogCharacterTelemetryReport, Log, All);
+
+namespace {
+  // EMovementState on the character
+  const TCHAR* const GTelemetryStateNames[] = {TEXT("Walking"), TEXT("Running"), TEXT("Crouching"), TEXT("Sliding")};
+  constexpr int32 kTelemetryStates = UE_ARRAY_COUNT(GTelemetryStateNames);
+  constexpr uint8 kTelemetrySliding = 3;
+
+  const TCHAR* const GTelemetryOutcomeNames[] = {TEXT("shifted"), TEXT("no target"), TEXT("not ready"),
+                                                 TEXT("no mana")};
+  static_assert(UE_ARRAY_COUNT(GTelemetryOutcomeNames) == static_cast<int32>(ETelemetryShiftOutcome::kCount));
+
+  // samples further apart than this are a gap in the recording, not time spent in a state
+  constexpr uint32 kMaxSampleGapMs = 250;
+
+  struct FTelemetryStateTotals {
+    double seconds = 0;
+    double distance = 0;
+    float maxSpeed = 0;
+  };
+
+  // releases of one branch and flags pattern by outcome
+  struct FTelemetryShiftTotals {
+    uint64 outcomes[static_cast<int32>(ETelemetryShiftOutcome::kCount)] = {};
+  };
+
+  // everything the characters that ran one tuning did
+  struct FTelemetryTuningTotals {
+    FTelemetryCharacter tuning;
+    int32 characters = 0;
+    FTelemetryStateTotals states[kTelemetryStates];
+    uint32 slides = 0;
+    double seconds = 0;
+    double manaSeconds = 0;
+    double lowManaSeconds = 0; // below the shift cost
+    TSortedMap<uint16, FTelemetryShiftTotals> shifts; // branch << 8 | flags
+  };
+
+  struct FTelemetryCharacterCursor {
+    int32 tuning = INDEX_NONE;
+    uint32 lastTimeMs = 0;
+    uint8 lastState = 0;
+    bool hasLast = false;
+  };
+
+  bool IsSameTuning(const FTelemetryCharacter& a, const FTelemetryCharacter& b) {
+    return a.slideBoost == b.slideBoost && a.slideTime == b.slideTime && a.speedMultiplier == b.speedMultiplier &&
+      a.manaCost == b.manaCost && a.rechargeRate == b.rechargeRate && a.rechargeDelay == b.rechargeDelay;
+  }
+
+  void LogTuningTotals(const FTelemetryTuningTotals& totals) {
+    const FTelemetryCharacter& tuning = totals.tuning;
+    UE_LOG(LogCharacterTelemetryReport, Display,
+           TEXT("slideBoost %.2f, slideTime %.2f, speedMultiplier %.1f, manaCost %.1f, rechargeRate %.1f, ")
+           TEXT("rechargeDelay %.2f: %d characters, %.1f min"),
+           tuning.slideBoost, tuning.slideTime, tuning.speedMultiplier, tuning.manaCost, tuning.rechargeRate,
+           tuning.rechargeDelay, totals.characters, totals.seconds / 60);
+    for (int32 i = 0; i < kTelemetryStates; i++) {
+      const FTelemetryStateTotals& state = totals.states[i];
+      UE_LOG(LogCharacterTelemetryReport, Display, TEXT("  %-10s %5.1f%%, %4.0f cm/s avg, %4.0f cm/s max"),
+             GTelemetryStateNames[i], state.seconds * 100 / FMath::Max(totals.seconds, 1e-6),
+             state.distance / FMath::Max(state.seconds, 1e-6), state.maxSpeed);
+    }
+    UE_LOG(LogCharacterTelemetryReport, Display, TEXT("  slides: %u, %.2f s avg"), totals.slides,
+           totals.states[kTelemetrySliding].seconds / FMath::Max<uint32>(totals.slides, 1));
+    UE_LOG(LogCharacterTelemetryReport, Display, TEXT("  mana: %.1f avg, below the shift cost %.1f%% of the time"),
+           totals.manaSeconds / FMath::Max(totals.seconds, 1e-6),
+           totals.lowManaSeconds * 100 / FMath::Max(totals.seconds, 1e-6));
+    for (const TPair<uint16, FTelemetryShiftTotals>& pattern : totals.shifts) {
+      uint64 released = 0;
+      FString outcomes;
+      for (int32 i = 0; i < UE_ARRAY_COUNT(GTelemetryOutcomeNames); i++) {
+        released += pattern.Value.outcomes[i];
+        outcomes += FString::Printf(TEXT(", %s %llu"), GTelemetryOutcomeNames[i], pattern.Value.outcomes[i]);
+      }
+      UE_LOG(LogCharacterTelemetryReport, Display, TEXT("  shift %s flags 0x%02x: %llu released%s"),
+             LexToString(static_cast<EShiftBranch>(pattern.Key >> 8)), pattern.Key & 0xFF, released, *outcomes);
+    }
+  }
+}
+
+int32 UCharacterTelemetryCommandlet::Main(const FString& params) {
+  FString files;
+  if (!FParse::Value(*params, TEXT("Files="), files, false)) {
+    UE_LOG(LogCharacterTelemetryReport, Error, TEXT("Usage: -run=CharacterTelemetry -Files=A.ctlm+B.ctlm"));
+    return 1;
+  }
+
+  TArray<FString> paths;
+  files.ParseIntoArray(paths, TEXT("+"));
+  TArray<FTelemetryTuningTotals> tunings;
+  // ids are per file, keyed by file index << 16 | id
+  TMap<uint32, FTelemetryCharacterCursor> cursors;
+  uint64 unmatchedRows = 0;
+  FTelemetryReadStats total;
+  int32 failed = 0;
+  const uint64 start = FPlatformTime::Cycles64();
+  for (int32 file = 0; file < paths.Num(); file++) {
+    const uint32 fileKey = static_cast<uint32>(file) << 16;
+    FCharacterTelemetryReader reader;
+    reader.onCharacters = [&](TConstArrayView<FTelemetryCharacter> rows) {
+      for (const FTelemetryCharacter& row : rows) {
+        int32 tuning = tunings.IndexOfByPredicate([&row](const FTelemetryTuningTotals& totals) {
+          return IsSameTuning(totals.tuning, row);
+        });
+        if (tuning == INDEX_NONE) {
+          tuning = tunings.AddDefaulted();
+          tunings[tuning].tuning = row;
+        }
+        tunings[tuning].characters++;
+        cursors.FindOrAdd(fileKey | row.character).tuning = tuning;
+      }
+    };
+    reader.onFrames = [&](TConstArrayView<FTelemetryFrame> rows) {
+      for (const FTelemetryFrame& row : rows) {
+        FTelemetryCharacterCursor* cursor = cursors.Find(fileKey | row.character);
+        if (cursor == nullptr || cursor->tuning == INDEX_NONE) {
+          unmatchedRows++;
+          continue;
+        }
+        FTelemetryTuningTotals& totals = tunings[cursor->tuning];
+        const uint8 state = FMath::Min<uint8>(row.movementState, kTelemetryStates - 1);
+        const float speed = row.velocity.Size();
+        if (state == kTelemetrySliding && (!cursor->hasLast || cursor->lastState != kTelemetrySliding)) {
+          totals.slides++;
+        }
+        // the time since the last sample goes to this one
+        const uint32 stepMs = row.timeMs - cursor->lastTimeMs;
+        if (cursor->hasLast && row.timeMs >= cursor->lastTimeMs && stepMs <= kMaxSampleGapMs) {
+          const double step = stepMs / 1000.0;
+          totals.states[state].seconds += step;
+          totals.states[state].distance += speed * step;
+          totals.seconds += step;
+          totals.manaSeconds += row.mana * step;
+          totals.lowManaSeconds += row.mana < totals.tuning.manaCost ? step : 0;
+        }
+        totals.states[state].maxSpeed = FMath::Max(totals.states[state].maxSpeed, speed);
+        cursor->lastTimeMs = row.timeMs;
+        cursor->lastState = state;
+        cursor->hasLast = true;
+      }
+    };
+    reader.onShifts = [&](TConstArrayView<FTelemetryShift> rows) {
+      for (const FTelemetryShift& row : rows) {
+        const FTelemetryCharacterCursor* cursor = cursors.Find(fileKey | row.character);
+        if (cursor == nullptr || cursor->tuning == INDEX_NONE ||
+          row.outcome >= static_cast<uint8>(ETelemetryShiftOutcome::kCount)) {
+          unmatchedRows++;
+          continue;
+        }
+        const uint16 pattern = static_cast<uint16>(row.branch << 8 | row.flags);
+        tunings[cursor->tuning].shifts.FindOrAdd(pattern).outcomes[row.outcome]++;
+      }
+    };
+
+    FTelemetryReadStats stats;
+    if (!reader.Read(paths[file], stats)) {
+      failed++;
+      continue;
+    }
+    total.rows += stats.rows;
+    total.blocks += stats.blocks;
+    total.fileBytes += stats.fileBytes;
+  }
+  total.seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - start);
+
+  for (const FTelemetryTuningTotals& totals : tunings) {
+    LogTuningTotals(totals);
+  }
+  if (unmatchedRows > 0) {
+    UE_LOG(LogCharacterTelemetryReport, Warning, TEXT("%llu rows belonged to no known character"), unmatchedRows);
+  }
+  UE_LOG(LogCharacterTelemetryReport, Display,
+         TEXT("Read %d files, %llu rows in %u blocks, %.1f MB, decoded and aggregated in %.2f s"),
+         paths.Num() - failed, total.rows, total.blocks, total.fileBytes / (1024.0 * 1024.0), total.seconds);
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,20 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CharacterTelemetryCommandlet.generated.h"
+
+// Aggregates telemetry files (see FCharacterTelemetry) per tuning set:
+//   UnrealEditor-Cmd <project> -run=CharacterTelemetry -Files=A.ctlm+B.ctlm
+// Logs the time share and speed of every movement state, slide count and length, mana against the shift
+// cost and the shift releases of every branch and flagChecks pattern with their outcomes, then the decode
+// time. Returns non zero if a file could not be read.
+UCLASS()
+class FPS_CONTROLLER_API UCharacterTelemetryCommandlet : public UCommandlet {
+  GENERATED_BODY()
+
+public:
+  virtual int32 Main(const FString& params) override;
+};
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CharacterTelemetrySubsystem.h"
+
+#include "CharacterTelemetry.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+#include "PlayerCharacter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogCharacterTelemetrySubsystem, Log, All);
+
+namespace {
+  // FCharacterTelemetry writes one file per process, the world that started the session owns it. Other worlds
+  // (PIE clients next to a listen server) would restart it on the same path and hand out colliding ids
+  TWeakObjectPtr<UCharacterTelemetrySubsystem> GTelemetryOwner;
+
+  FAutoConsoleCommandWithWorldAndArgs CmdStartTelemetry(
+    TEXT("fps.Telemetry.Start"),
+    TEXT("Starts recording character telemetry. Argument: file path (default Saved/Telemetry/<map>-<time>.ctlm)."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& args, UWorld* world) {
+      UCharacterTelemetrySubsystem* telemetry = world ? world->GetSubsystem<UCharacterTelemetrySubsystem>() : nullptr;
+      if (telemetry == nullptr) return;
+      telemetry->StartSession(args.Num() > 0 ? args[0] : UCharacterTelemetrySubsystem::GetDefaultPath(world));
+    }));
+
+  FAutoConsoleCommandWithWorld CmdStopTelemetry(
+    TEXT("fps.Telemetry.Stop"),
+    TEXT("Stops recording character telemetry, flushes the file and logs what the recording cost."),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* world) {
+      UCharacterTelemetrySubsystem* telemetry = world ? world->GetSubsystem<UCharacterTelemetrySubsystem>() : nullptr;
+      if (telemetry == nullptr) return;
+      telemetry->StopSession();
+    }));
+}
+
+uint16 UCharacterTelemetrySubsystem::Register(APlayerCharacter* character) {
+  m_characters.Add(character);
+  const uint16 id = m_nextId++;
+  if (m_recording) {
+    RecordCharacter(character);
+  }
+  return id;
+}
+
+void UCharacterTelemetrySubsystem::Unregister(APlayerCharacter* character) {
+  m_characters.RemoveSwap(character);
+}
+
+bool UCharacterTelemetrySubsystem::StartSession(const FString& path) {
+  if (GTelemetryOwner.IsValid() && GTelemetryOwner.Get() != this) {
+    UE_LOG(LogCharacterTelemetrySubsystem, Warning, TEXT("Telemetry is already recording %s, stop it there first"),
+           *GetNameSafe(GTelemetryOwner->GetWorld()));
+    return false;
+  }
+  StopSession();
+  if (!FCharacterTelemetry::Get().Start(path)) return false;
+  GTelemetryOwner = this;
+  m_recording = true;
+  m_sampleSeconds = 0;
+  m_frameSeconds = 0;
+  m_frames = 0;
+  for (const TWeakObjectPtr<APlayerCharacter>& character : m_characters) {
+    if (character.IsValid()) {
+      RecordCharacter(character.Get());
+    }
+  }
+  return true;
+}
+
+void UCharacterTelemetrySubsystem::StopSession() {
+  if (!m_recording) return;
+  m_recording = false;
+  GTelemetryOwner.Reset();
+  FCharacterTelemetry::Get().Stop();
+  UE_LOG(LogCharacterTelemetrySubsystem, Display,
+         TEXT("Telemetry sampling over %llu frames: %.2f us per frame, %.3f%% of frame time"), m_frames,
+         m_sampleSeconds * 1e6 / FMath::Max<uint64>(m_frames, 1),
+         m_frameSeconds > 0 ? m_sampleSeconds * 100 / m_frameSeconds : 0.0);
+}
+
+FString UCharacterTelemetrySubsystem::GetDefaultPath(const UWorld* world) {
+  const FString map = world ? world->GetMapName() : TEXT("Unknown");
+  return FPaths::ProjectSavedDir() / TEXT("Telemetry") /
+    FString::Printf(TEXT("%s-%s.ctlm"), *map, *FDateTime::Now().ToString());
+}
+
+void UCharacterTelemetrySubsystem::RecordCharacter(const APlayerCharacter* character) const {
+  FTelemetryCharacter row;
+  character->FillTelemetry(row);
+  FCharacterTelemetry::Get().Record(row);
+}
+
+void UCharacterTelemetrySubsystem::Tick(float DeltaTime) {
+  const uint64 start = FPlatformTime::Cycles64();
+  FCharacterTelemetry& telemetry = FCharacterTelemetry::Get();
+  FTelemetryFrame row;
+  row.timeMs = telemetry.GetTimeMs();
+  for (const TWeakObjectPtr<APlayerCharacter>& character : m_characters) {
+    if (!character.IsValid()) continue;
+    character->FillTelemetry(row);
+    telemetry.Record(row);
+  }
+  m_sampleSeconds += FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - start);
+  // real frame time, the world's delta is dilated
+  m_frameSeconds += FApp::GetDeltaTime();
+  m_frames++;
+}
+
+TStatId UCharacterTelemetrySubsystem::GetStatId() const {
+  RETURN_QUICK_DECLARE_CYCLE_STAT(UCharacterTelemetrySubsystem, STATGROUP_Tickables);
+}
+
+void UCharacterTelemetrySubsystem::OnWorldBeginPlay(UWorld& world) {
+  Super::OnWorldBeginPlay(world);
+  // the server or a standalone game sees every character, clients only record when asked from their console
+  if (world.GetNetMode() == NM_Client) return;
+  FString path;
+  if (!FParse::Value(FCommandLine::Get(), TEXT("CharacterTelemetry="), path)) return;
+  StartSession(path.IsEmpty() ? GetDefaultPath(&world) : path);
+}
+
+void UCharacterTelemetrySubsystem::Deinitialize() {
+  StopSession();
+  Super::Deinitialize();
+}
@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CharacterTelemetrySubsystem.generated.h"
+
+class APlayerCharacter;
+
+// Samples every registered character into FCharacterTelemetry once a frame while a session runs, whatever
+// rate the characters themselves tick at, and writes each one's tuning when it joins. Times its own share
+// of the frame and logs it when the session stops.
+// -CharacterTelemetry=<path> records the server's (or the standalone) world from the start of play,
+// fps.Telemetry.Start [path] and fps.Telemetry.Stop from the console. One world records at a time, the file
+// and the ids are that world's. Without a path files go to Saved/Telemetry/<map>-<time>.ctlm.
+UCLASS()
+class FPS_CONTROLLER_API UCharacterTelemetrySubsystem : public UTickableWorldSubsystem {
+  GENERATED_BODY()
+
+public:
+  // the id the character's rows go by
+  uint16 Register(APlayerCharacter* character);
+  void Unregister(APlayerCharacter* character);
+
+  bool StartSession(const FString& path);
+  void StopSession();
+  static FString GetDefaultPath(const UWorld* world);
+
+  virtual void OnWorldBeginPlay(UWorld& world) override;
+  virtual void Deinitialize() override;
+  virtual void Tick(float DeltaTime) override;
+  virtual TStatId GetStatId() const override;
+  virtual bool IsTickable() const override { return m_recording && m_characters.Num() > 0; }
+
+private:
+  void RecordCharacter(const APlayerCharacter* character) const;
+
+  TArray<TWeakObjectPtr<APlayerCharacter>> m_characters;
+  uint16 m_nextId = 0;
+  bool m_recording = false;
+
+  // what the sampling costs against the frames it ran in
+  double m_sampleSeconds = 0;
+  double m_frameSeconds = 0;
+  uint64 m_frames = 0;
+};
@@ -0,0 +1,36 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Turns variable frame time into a whole number of fixed steps. What is left over stays in the
+// accumulator and is used to interpolate the presented state between the last two steps.
+struct FFixedStepClock {
+  float step = 1.f / 60.f;
+  int32 maxSteps = 4;
+  float accumulator = 0.f;
+
+  void Reset(float rate, int32 maxSubSteps) {
+    step = 1.f / FMath::Max(rate, 1.f);
+    maxSteps = FMath::Max(maxSubSteps, 1);
+    accumulator = 0.f;
+  }
+
+  // Frame time beyond maxSteps is dropped, under heavy load the simulation slows down
+  // instead of spending more and more steps catching up.
+  int32 Advance(float deltaTime) {
+    accumulator += deltaTime;
+    int32 steps = 0;
+    while (accumulator >= step && steps < maxSteps) {
+      accumulator -= step;
+      steps++;
+    }
+    if (accumulator >= step) {
+      accumulator = FMath::Fmod(accumulator, step);
+    }
+    return steps;
+  }
+
+  float GetAlpha() const { return accumulator / step; }
+};
@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LoadTestBotController.h"
+
+#include "PlayerCharacter.h"
+
+FBotBehaviorMix FBotBehaviorMix::Parse(const FString& spec) {
+  FBotBehaviorMix mix;
+  TArray<FString> entries;
+  spec.ParseIntoArray(entries, TEXT(","));
+  for (const FString& entry : entries) {
+    FString name;
+    FString value;
+    if (!entry.Split(TEXT("="), &name, &value)) continue;
+    const float weight = FMath::Max(FCString::Atof(*value), 0.f);
+    float* field = name == TEXT("idle") ? &mix.idle
+                 : name == TEXT("walk") ? &mix.walk
+                 : name == TEXT("sprint") ? &mix.sprint
+                 : name == TEXT("slide") ? &mix.slide
+                 : name == TEXT("crouch") ? &mix.crouch
+                 : name == TEXT("jump") ? &mix.jump
+                 : name == TEXT("shift") ? &mix.shift
+                 : nullptr;
+    if (field != nullptr) {
+      *field = weight;
+    }
+  }
+  return mix;
+}
+
+ALoadTestBotController::ALoadTestBotController() {
+  PrimaryActorTick.bCanEverTick = true;
+  bWantsPlayerState = false;
+}
+
+void ALoadTestBotController::Configure(const FBotBehaviorMix& mix, int32 seed) {
+  m_mix = mix;
+  m_random.Initialize(seed);
+  // spread the first decisions so a freshly spawned crowd doesn't act in lockstep
+  m_actionTimeLeft = m_random.FRandRange(0.f, 2.f);
+}
+
+void ALoadTestBotController::OnPossess(APawn* pawn) {
+  Super::OnPossess(pawn);
+  m_character = Cast<APlayerCharacter>(pawn);
+}
+
+void ALoadTestBotController::OnUnPossess() {
+  m_character = nullptr;
+  Super::OnUnPossess();
+}
+
+void ALoadTestBotController::Send(ECharacterInput input, const FInputActionValue& value) {
+  m_character->DispatchInput(input, value);
+}
+
+void ALoadTestBotController::SetHeld(ECharacterInput input, bool held, bool toggle, bool& state) {
+  if (state == held) return;
+  state = held;
+  Send(input, FInputActionValue(toggle || held));
+}
+
+ALoadTestBotController::EBotAction ALoadTestBotController::PickAction() {
+  const float weights[] = {m_mix.idle, m_mix.walk, m_mix.sprint, m_mix.slide, m_mix.crouch, m_mix.jump, m_mix.shift};
+  static_assert(UE_ARRAY_COUNT(weights) == static_cast<int32>(EBotAction::kCount));
+  float total = 0.f;
+  for (const float weight : weights) {
+    total += weight;
+  }
+  float pick = m_random.FRandRange(0.f, total);
+  for (int32 i = 0; i < UE_ARRAY_COUNT(weights); i++) {
+    pick -= weights[i];
+    if (pick <= 0.f && weights[i] > 0.f) return static_cast<EBotAction>(i);
+  }
+  return EBotAction::kIdle;
+}
+
+void ALoadTestBotController::StartAction(EBotAction action) {
+  m_action = action;
+  const bool toggleSprint = m_character->m_sprintToggle;
+  const bool toggleCrouch = m_character->m_crouchToggle;
+
+  // everything starts from plain walking, the slide and crouch set their own keys again below
+  SetHeld(ECharacterInput::kSprint, false, toggleSprint, m_sprinting);
+  SetHeld(ECharacterInput::kCrouch, false, toggleCrouch, m_crouching);
+  m_move = FVector2D(m_random.FRandRange(-.5f, .5f), 1.f);
+  m_look = FVector2D(m_random.FRandRange(-90.f, 90.f), m_random.FRandRange(-10.f, 10.f));
+  m_actionTimeLeft = m_random.FRandRange(2.f, 4.f);
+
+  switch (action) {
+  case EBotAction::kIdle: m_move = FVector2D::ZeroVector;
+    m_look = FVector2D::ZeroVector;
+    break;
+  case EBotAction::kWalk:
+    break;
+  case EBotAction::kSprint: m_move.X = 0.f;
+    SetHeld(ECharacterInput::kSprint, true, toggleSprint, m_sprinting);
+    break;
+  case EBotAction::kSlide: m_move.X = 0.f;
+    m_actionTimeLeft = 1.f;
+    SetHeld(ECharacterInput::kSprint, true, toggleSprint, m_sprinting);
+    SetHeld(ECharacterInput::kCrouch, true, toggleCrouch, m_crouching);
+    break;
+  case EBotAction::kCrouch: SetHeld(ECharacterInput::kCrouch, true, toggleCrouch, m_crouching);
+    break;
+  case EBotAction::kJump: m_actionTimeLeft = 1.f;
+    Send(ECharacterInput::kJump, FInputActionValue(true));
+    break;
+  case EBotAction::kShift: m_actionTimeLeft = 1.f;
+    m_abilityHoldLeft = m_random.FRandRange(.1f, .5f);
+    Send(ECharacterInput::kStartAbility, FInputActionValue(true));
+    break;
+  case EBotAction::kCount:
+    break;
+  }
+}
+
+void ALoadTestBotController::Tick(float DeltaSeconds) {
+  Super::Tick(DeltaSeconds);
+  if (m_character == nullptr) return;
+
+  if (m_abilityHoldLeft > 0.f) {
+    m_abilityHoldLeft -= DeltaSeconds;
+    if (m_abilityHoldLeft <= 0.f) {
+      Send(ECharacterInput::kExecuteAbility, FInputActionValue(true));
+    }
+  }
+  m_actionTimeLeft -= DeltaSeconds;
+  if (m_actionTimeLeft <= 0.f && m_abilityHoldLeft <= 0.f) {
+    StartAction(PickAction());
+  }
+
+  // held keys arrive every frame like Triggered events do
+  if (!m_move.IsZero()) {
+    Send(ECharacterInput::kMovement, FInputActionValue(m_move));
+  }
+  if (!m_look.IsZero()) {
+    const FVector2D look = m_look * DeltaSeconds;
+    Send(ECharacterInput::kLook, FInputActionValue(look));
+    // AddControllerYawInput only reaches player controllers, the turn itself is applied here
+    const float scale = m_character->m_mouseSensitivity / 10;
+    FRotator rotation = GetControlRotation();
+    rotation.Yaw += look.X * scale;
+    rotation.Pitch = FMath::ClampAngle(rotation.Pitch - look.Y * scale, -80.f, 80.f);
+    SetControlRotation(rotation);
+  }
+}
@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CharacterInputRecorder.h"
+#include "GameFramework/Controller.h"
+#include "LoadTestBotController.generated.h"
+
+class APlayerCharacter;
+
+// relative weights of what a bot picks next, "idle=1,sprint=3,shift=.5" style specs override the defaults
+struct FBotBehaviorMix {
+  float idle = 1.f;
+  float walk = 3.f;
+  float sprint = 2.f;
+  float slide = 1.f;
+  float crouch = .5f;
+  float jump = .5f;
+  float shift = .5f;
+
+  static FBotBehaviorMix Parse(const FString& spec);
+};
+
+// Drives an APlayerCharacter for load tests through the same handlers player input reaches, so a bot
+// costs what a player costs. Picks a weighted random action every few seconds, deterministic per seed.
+// A plain AController, nothing in here needs the AI module.
+UCLASS()
+class FPS_CONTROLLER_API ALoadTestBotController : public AController {
+  GENERATED_BODY()
+
+public:
+  ALoadTestBotController();
+
+  void Configure(const FBotBehaviorMix& mix, int32 seed);
+
+  virtual void Tick(float DeltaSeconds) override;
+
+protected:
+  virtual void OnPossess(APawn* pawn) override;
+  virtual void OnUnPossess() override;
+
+private:
+  enum class EBotAction : uint8 { kIdle, kWalk, kSprint, kSlide, kCrouch, kJump, kShift, kCount };
+
+  EBotAction PickAction();
+  void StartAction(EBotAction action);
+  // presses or releases, toggle bindings only get a press when the state has to flip
+  void SetHeld(ECharacterInput input, bool held, bool toggle, bool& state);
+  void Send(ECharacterInput input, const FInputActionValue& value);
+
+  APlayerCharacter* m_character = nullptr;
+  FBotBehaviorMix m_mix;
+  FRandomStream m_random;
+  EBotAction m_action = EBotAction::kIdle;
+  FVector2D m_move = FVector2D::ZeroVector;
+  FVector2D m_look = FVector2D::ZeroVector; // per second
+  float m_actionTimeLeft = 0.f;
+  float m_abilityHoldLeft = 0.f;
+  bool m_sprinting = false;
+  bool m_crouching = false;
+};
@@ -0,0 +1,210 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LoadTestSubsystem.h"
+
+#include "CharacterSignificance.h"
+#include "CharacterStats.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerStart.h"
+#include "PlayerCharacter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogLoadTest, Log, All);
+
+namespace {
+  // frames right after spawning a batch are all BeginPlay and component registration
+  constexpr float kLoadTestWarmupSeconds = 3.f;
+  constexpr float kLoadTestSpacing = 300.f;
+
+  // a square spiral out from the start, a slot doesn't depend on how many bots are asked for, so each ramp
+  // step only adds bots around the ones already standing
+  FIntPoint GetGridSlot(int32 index) {
+    if (index == 0) return FIntPoint(0, 0);
+    // ring r holds the 8r slots from (2r-1)^2 on
+    const int32 ring = FMath::CeilToInt32((FMath::Sqrt(static_cast<float>(index + 1)) - 1.f) * .5f);
+    const int32 side = 2 * ring;
+    const int32 offset = index - (side - 1) * (side - 1);
+    const int32 along = offset % side;
+    switch (offset / side) {
+    case 0: return FIntPoint(ring, 1 - ring + along);
+    case 1: return FIntPoint(ring - 1 - along, ring);
+    case 2: return FIntPoint(-ring, ring - 1 - along);
+    default: return FIntPoint(1 - ring + along, -ring);
+    }
+  }
+
+  TArray<int32> ParseBotCounts(const FString& spec) {
+    TArray<FString> entries;
+    spec.ParseIntoArray(entries, TEXT("+"));
+    TArray<int32> counts;
+    for (const FString& entry : entries) {
+      const int32 count = FCString::Atoi(*entry);
+      if (count > 0) {
+        counts.Add(count);
+      }
+    }
+    return counts;
+  }
+
+  FAutoConsoleCommandWithWorldAndArgs CmdLoadTestSpawn(
+    TEXT("fps.LoadTest.Spawn"),
+    TEXT("Spawns bot driven player characters until N are alive. Arguments: N [mix, e.g. sprint=2,shift=1]."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& args, UWorld* world) {
+      ULoadTestSubsystem* loadTest = world ? world->GetSubsystem<ULoadTestSubsystem>() : nullptr;
+      if (loadTest == nullptr || args.Num() == 0) return;
+      loadTest->SpawnBots(FCString::Atoi(*args[0]), FBotBehaviorMix::Parse(args.Num() > 1 ? args[1] : FString()));
+    }));
+
+  FAutoConsoleCommandWithWorldAndArgs CmdLoadTestRamp(
+    TEXT("fps.LoadTest.Ramp"),
+    TEXT("Steps through bot counts and reports frame time, scope breakdown and memory per bot at each. ")
+    TEXT("Arguments: 10+50+100 [seconds per step, default 20] [mix]."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& args, UWorld* world) {
+      ULoadTestSubsystem* loadTest = world ? world->GetSubsystem<ULoadTestSubsystem>() : nullptr;
+      if (loadTest == nullptr || args.Num() == 0) return;
+      loadTest->StartRamp(ParseBotCounts(args[0]), args.Num() > 1 ? FCString::Atof(*args[1]) : 20.f,
+                          FBotBehaviorMix::Parse(args.Num() > 2 ? args[2] : FString()));
+    }));
+
+  FAutoConsoleCommandWithWorldAndArgs CmdLoadTestClear(
+    TEXT("fps.LoadTest.Clear"),
+    TEXT("Destroys every load test bot and stops a running ramp."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>&, UWorld* world) {
+      ULoadTestSubsystem* loadTest = world ? world->GetSubsystem<ULoadTestSubsystem>() : nullptr;
+      if (loadTest == nullptr) return;
+      loadTest->ClearBots();
+    }));
+}
+
+void ULoadTestSubsystem::SpawnBots(int32 count, const FBotBehaviorMix& mix) {
+  UWorld* world = GetWorld();
+  m_bots.RemoveAll([](const TWeakObjectPtr<APawn>& bot) { return !bot.IsValid(); });
+
+  TSubclassOf<APlayerCharacter> pawnClass = APlayerCharacter::StaticClass();
+  FString pawnPath;
+  if (FParse::Value(FCommandLine::Get(), TEXT("LoadTestPawn="), pawnPath)) {
+    if (UClass* loaded = LoadClass<APlayerCharacter>(nullptr, *pawnPath)) {
+      pawnClass = loaded;
+    }
+    else {
+      UE_LOG(LogLoadTest, Warning, TEXT("Could not load %s, spawning APlayerCharacter"), *pawnPath);
+    }
+  }
+
+  FTransform origin = FTransform::Identity;
+  for (TActorIterator<APlayerStart> start(world); start; ++start) {
+    origin = start->GetActorTransform();
+    break;
+  }
+
+  FActorSpawnParameters spawnParams;
+  spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+  for (int32 i = m_bots.Num(); i < count; i++) {
+    const FIntPoint slot = GetGridSlot(i);
+    const FVector offset(slot.X * kLoadTestSpacing, slot.Y * kLoadTestSpacing, 0.f);
+    const FTransform transform(origin.GetRotation(), origin.TransformPosition(offset));
+    APlayerCharacter* bot = world->SpawnActor<APlayerCharacter>(pawnClass, transform, spawnParams);
+    if (bot == nullptr) continue;
+    ALoadTestBotController* controller = world->SpawnActor<ALoadTestBotController>(spawnParams);
+    controller->Configure(mix, i);
+    controller->Possess(bot);
+    m_bots.Add(bot);
+  }
+  UE_LOG(LogLoadTest, Display, TEXT("%d load test bots alive"), m_bots.Num());
+}
+
+void ULoadTestSubsystem::ClearBots() {
+  for (const TWeakObjectPtr<APawn>& bot : m_bots) {
+    if (!bot.IsValid()) continue;
+    if (AController* controller = bot->GetController()) {
+      controller->Destroy();
+    }
+    bot->Destroy();
+  }
+  m_bots.Reset();
+  m_steps.Reset();
+}
+
+void ULoadTestSubsystem::StartRamp(const TArray<int32>& counts, float seconds, const FBotBehaviorMix& mix) {
+  if (counts.Num() == 0) return;
+  ClearBots();
+  m_steps = counts;
+  m_step = 0;
+  m_stepSeconds = FMath::Max(seconds, 1.f);
+  m_mix = mix;
+  m_baseMemory = FPlatformMemory::GetStats().UsedPhysical;
+  BeginStep();
+}
+
+void ULoadTestSubsystem::BeginStep() {
+  SpawnBots(m_steps[m_step], m_mix);
+  m_stepElapsed = 0.f;
+  m_measuredFrames = 0;
+  m_frameStats.Reset();
+}
+
+void ULoadTestSubsystem::EndStep() {
+  const int32 bots = FMath::Max(m_bots.Num(), 1);
+  const uint64 used = FPlatformMemory::GetStats().UsedPhysical;
+  const double perBotKB = used > m_baseMemory ? static_cast<double>(used - m_baseMemory) / bots / 1024.0 : 0.0;
+  UE_LOG(LogLoadTest, Display, TEXT("%d bots: %.1f KB used physical per bot, %.1f MB total"), m_bots.Num(),
+         perBotKB, used / (1024.0 * 1024.0));
+  m_frameStats.Report(*FString::Printf(TEXT("Load test %d bots"), m_bots.Num()));
+  GetWorld()->GetSubsystem<UCharacterSignificanceSubsystem>()->LogStats();
+#if ENABLE_CHARACTER_STATS
+  // the unit fps.Agents.Bench gives the SoA agents, skipped ticks of insignificant bots count as free
+  const FCharacterStats& stats = FCharacterStats::Get();
+  const double characterSeconds =
+    stats.GetScopeSeconds(ECharacterScope::kTick) + stats.GetScopeSeconds(ECharacterScope::kMovement);
+  UE_LOG(LogLoadTest, Display, TEXT("%d bots: Tick + Movement %.2f ns per bot per frame"), m_bots.Num(),
+         characterSeconds * 1e9 / (static_cast<double>(bots) * FMath::Max(m_measuredFrames, 1)));
+  FCharacterStats::Get().Log();
+  FCharacterStats::Get().Reset();
+#endif
+
+  if (++m_step < m_steps.Num()) {
+    BeginStep();
+    return;
+  }
+  m_steps.Reset();
+  UE_LOG(LogLoadTest, Display, TEXT("Load test ramp done"));
+  if (m_quitWhenDone) {
+    FPlatformMisc::RequestExitWithStatus(false, 0);
+  }
+}
+
+void ULoadTestSubsystem::Tick(float DeltaTime) {
+  Super::Tick(DeltaTime);
+  m_stepElapsed += DeltaTime;
+  if (m_stepElapsed < kLoadTestWarmupSeconds) return;
+  if (m_frameStats.IsEmpty()) {
+    // the character stats should only cover the measured frames too
+#if ENABLE_CHARACTER_STATS
+    FCharacterStats::Get().Reset();
+#endif
+  }
+  m_frameStats.Sample();
+  m_measuredFrames++;
+  if (m_stepElapsed >= kLoadTestWarmupSeconds + m_stepSeconds) {
+    EndStep();
+  }
+}
+
+TStatId ULoadTestSubsystem::GetStatId() const {
+  RETURN_QUICK_DECLARE_CYCLE_STAT(ULoadTestSubsystem, STATGROUP_Tickables);
+}
+
+void ULoadTestSubsystem::OnWorldBeginPlay(UWorld& world) {
+  Super::OnWorldBeginPlay(world);
+  // bots are the server's, a client world next to it (PIE, -LoadTest on a client's command line) stays out
+  if (world.GetNetMode() == NM_Client) return;
+  FString spec;
+  if (!FParse::Value(FCommandLine::Get(), TEXT("LoadTest="), spec)) return;
+
+  float seconds = 20.f;
+  FParse::Value(FCommandLine::Get(), TEXT("LoadTestSeconds="), seconds);
+  FString mix;
+  FParse::Value(FCommandLine::Get(), TEXT("LoadTestMix="), mix, false);
+  m_quitWhenDone = FParse::Param(FCommandLine::Get(), TEXT("LoadTestQuit"));
+  StartRamp(ParseBotCounts(spec), seconds, FBotBehaviorMix::Parse(mix));
+}
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CharacterInputRecorder.h"
+#include "LoadTestBotController.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "LoadTestSubsystem.generated.h"
+
+// Spawns bot driven player characters and measures what they cost the server. A ramp goes through bot
+// counts one step at a time: spawn up to the count, let it settle, then sample frame times and report
+// them with the character scope breakdown and the memory each bot added.
+// Launch mode for a headless server:
+//   -LoadTest=10+50+100 [-LoadTestSeconds=20] [-LoadTestMix=sprint=2,shift=1] [-LoadTestPawn=<class>] [-LoadTestQuit]
+// fps.LoadTest.Spawn N [mix], fps.LoadTest.Ramp 10+50+100 [seconds] [mix], fps.LoadTest.Clear
+// A ramp with -dpcvars=fps.Significance.Enabled=0 next to one without shows what the
+// significance tiers save. Each step also logs the characters' Tick + Movement time per bot per frame,
+// the figure fps.Agents.Bench sets next to the SoA agents.
+UCLASS()
+class FPS_CONTROLLER_API ULoadTestSubsystem : public UTickableWorldSubsystem {
+  GENERATED_BODY()
+
+public:
+  // adds bots until count are alive
+  void SpawnBots(int32 count, const FBotBehaviorMix& mix);
+  void ClearBots();
+  void StartRamp(const TArray<int32>& counts, float seconds, const FBotBehaviorMix& mix);
+
+  virtual void OnWorldBeginPlay(UWorld& world) override;
+  virtual void Tick(float DeltaTime) override;
+  virtual TStatId GetStatId() const override;
+  virtual bool IsTickable() const override { return m_steps.Num() > 0; }
+
+private:
+  void BeginStep();
+  void EndStep();
+
+  TArray<TWeakObjectPtr<APawn>> m_bots;
+  TArray<int32> m_steps;
+  int32 m_step = 0;
+  float m_stepSeconds = 0.f;
+  float m_stepElapsed = 0.f;
+  int32 m_measuredFrames = 0;
+  FBotBehaviorMix m_mix;
+  FReplayFrameStats m_frameStats;
+  uint64 m_baseMemory = 0; // used physical before the first bot
+  bool m_quitWhenDone = false;
+};
@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LookLatch.h"
+
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/PlayerController.h"
+#include "PlayerCharacter.h"
+#include "SceneView.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogLookLatch, Log, All);
+
+namespace {
+  // nothing renders the samples away when the window is minimized
+  constexpr int32 kMaxLookSamples = 256;
+
+  float LookPercentileMs(TArray<float> samples, float percentile) {
+    if (samples.Num() == 0) return 0.f;
+    samples.Sort();
+    return samples[FMath::Clamp(FMath::FloorToInt(samples.Num() * percentile), 0, samples.Num() - 1)];
+  }
+
+  FAutoConsoleCommandWithWorld CmdLookLatency(
+    TEXT("fps.Look.Latency"),
+    TEXT("Logs the local player's input to view latency since the last call and starts over. Needs -LookLatency ")
+    TEXT("or latched look."),
+    FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* world) {
+      const APlayerController* controller = world ? world->GetFirstPlayerController() : nullptr;
+      const APlayerCharacter* character = controller ? Cast<APlayerCharacter>(controller->GetPawn()) : nullptr;
+      FLookLatch* latch = character ? character->GetLookLatch() : nullptr;
+      if (latch == nullptr) {
+        UE_LOG(LogLookLatch, Warning, TEXT("Look isn't timed, start with -LookLatency"));
+        return;
+      }
+      latch->Report(TEXT("Look"));
+      latch->Reset();
+    }));
+}
+
+FLookLatch::FLookLatch(bool rendered) : m_rendered(rendered) {}
+
+void FLookLatch::Add(float yaw, float pitch, bool latched) {
+  const FSample sample{FPlatformTime::Seconds(), yaw, pitch, 0, latched, false};
+  FScopeLock lock(&m_lock);
+  m_samples.Add(sample);
+}
+
+FVector2f FLookLatch::Commit(uint64 frame) {
+  const double now = FPlatformTime::Seconds();
+  FVector2f input = FVector2f::ZeroVector;
+  FScopeLock lock(&m_lock);
+  for (FSample& sample : m_samples) {
+    if (sample.frame != 0) continue;
+    sample.frame = frame;
+    m_cameraMs.Add((now - sample.arrival) * 1000);
+    if (sample.latched) {
+      input += FVector2f(sample.yaw, sample.pitch);
+    }
+  }
+  // without a renderer nothing else is waiting for them
+  if (!m_rendered) {
+    m_samples.Reset();
+  }
+  else if (m_samples.Num() > kMaxLookSamples) {
+    m_samples.RemoveAt(0, m_samples.Num() - kMaxLookSamples);
+  }
+  return input;
+}
+
+void FLookLatch::Calibrate(const FVector2f& input, const FRotator& applied) {
+  FScopeLock lock(&m_lock);
+  if (FMath::Abs(input.X) > KINDA_SMALL_NUMBER && !FMath::IsNearlyZero(applied.Yaw)) {
+    m_yawScale = applied.Yaw / input.X;
+  }
+  if (FMath::Abs(input.Y) > KINDA_SMALL_NUMBER && !FMath::IsNearlyZero(applied.Pitch)) {
+    m_pitchScale = applied.Pitch / input.Y;
+  }
+}
+
+FRotator FLookLatch::Latch(uint64 frame) {
+  const double now = FPlatformTime::Seconds();
+  FRotator extra = FRotator::ZeroRotator;
+  FScopeLock lock(&m_lock);
+  for (FSample& sample : m_samples) {
+    const bool committed = sample.frame != 0 && sample.frame <= frame;
+    // too late for this frame's camera, added here and committed with the next one
+    const bool late = sample.latched && !committed;
+    if (late) {
+      extra.Yaw += sample.yaw * m_yawScale;
+      extra.Pitch += sample.pitch * m_pitchScale;
+    }
+    if ((committed || late) && !sample.shown) {
+      sample.shown = true;
+      m_viewMs.Add((now - sample.arrival) * 1000);
+      m_renderLatched += late ? 1 : 0;
+    }
+  }
+  m_samples.RemoveAll([frame](const FSample& sample) {
+    return sample.shown && sample.frame != 0 && sample.frame <= frame;
+  });
+  return extra;
+}
+
+void FLookLatch::Report(const TCHAR* label) const {
+  FScopeLock lock(&m_lock);
+  if (m_cameraMs.Num() == 0) return;
+  UE_LOG(LogLookLatch, Display,
+         TEXT("%s: %d inputs, input to camera p50 %.2f ms p95 %.2f ms, input to rendered view p50 %.2f ms ")
+         TEXT("p95 %.2f ms over %d views, %d latched on the render thread"),
+         label, m_cameraMs.Num(), LookPercentileMs(m_cameraMs, .5f), LookPercentileMs(m_cameraMs, .95f),
+         LookPercentileMs(m_viewMs, .5f), LookPercentileMs(m_viewMs, .95f), m_viewMs.Num(), m_renderLatched);
+}
+
+void FLookLatch::Reset() {
+  FScopeLock lock(&m_lock);
+  m_cameraMs.Reset();
+  m_viewMs.Reset();
+  m_renderLatched = 0;
+}
+
+bool ULookLatchModifier::ModifyCamera(float DeltaTime, FMinimalViewInfo& InOutPOV) {
+  APlayerController* controller = CameraOwner ? CameraOwner->GetOwningPlayerController() : nullptr;
+  const APlayerCharacter* character = controller ? Cast<APlayerCharacter>(controller->GetPawn()) : nullptr;
+  FLookLatch* latch = character ? character->GetLookLatch() : nullptr;
+  if (latch == nullptr) return false;
+
+  const FVector2f input = latch->Commit(GFrameCounter);
+  if (input.IsZero()) return false;
+  // through the controller, so look scaling, pitch limits and the pawn's facing stay what they were
+  const FRotator before = controller->GetControlRotation();
+  controller->AddYawInput(input.X);
+  controller->AddPitchInput(input.Y);
+  controller->UpdateRotation(DeltaTime);
+  const FRotator applied = (controller->GetControlRotation() - before).GetNormalized();
+  latch->Calibrate(input, applied);
+  InOutPOV.Rotation += applied;
+  return false;
+}
+
+FLookLatchViewExtension::FLookLatchViewExtension(const FAutoRegister& autoRegister, UWorld* world,
+                                                 const TSharedRef<FLookLatch, ESPMode::ThreadSafe>& latch)
+  : FWorldSceneViewExtension(autoRegister, world), m_latch(latch) {}
+
+void FLookLatchViewExtension::BeginRenderViewFamily(FSceneViewFamily& InViewFamily) {
+  // the extension can go away with the character before the command runs, the command keeps it alive
+  ENQUEUE_RENDER_COMMAND(LookLatchFrame)(
+    [extension = StaticCastSharedRef<FLookLatchViewExtension>(AsShared()), frame = GFrameCounter](
+    FRHICommandListImmediate&) {
+      extension->m_renderFrame = frame;
+    });
+}
+
+void FLookLatchViewExtension::PreRenderView_RenderThread(FRDGBuilder& GraphBuilder, FSceneView& InView) {
+  if (!InView.bIsGameView) return;
+  const FRotator extra = m_latch->Latch(m_renderFrame);
+  if (extra.IsZero()) return;
+  InView.ViewRotation += extra;
+  InView.UpdateViewMatrix();
+}
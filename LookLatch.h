@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Camera/CameraModifier.h"
+#include "SceneViewExtension.h"
+#include "LookLatch.generated.h"
+
+// Look input of the local player with the time it reached the game, shared by the game and render thread.
+// Every delta is timed to the camera update that first uses it and, when something renders, to the first
+// rendered view that shows it. Latched deltas are not handed to the controller by the look handler but held
+// back: ULookLatchModifier applies them while the camera is finalized, and whatever comes in after that is
+// added on top of the previous frame's view by FLookLatchViewExtension while the render thread picks it up.
+// Gameplay sees latched look a frame later than the camera does. The character only makes one when look is
+// latched or timed (-LookLatency, input replays).
+class FPS_CONTROLLER_API FLookLatch {
+public:
+  explicit FLookLatch(bool rendered);
+
+  // game thread, from the look handler. Deltas that are not latched already went to the controller and
+  // are only timed
+  void Add(float yaw, float pitch, bool latched);
+  // game thread, while the camera of frame is finalized: the latched input since the last commit
+  FVector2f Commit(uint64 frame);
+  // game thread, what the commit's input turned into after the controller's scaling and limits
+  void Calibrate(const FVector2f& input, const FRotator& applied);
+  // render thread, for the view of frame: latched input that came in after that frame's commit, in degrees
+  FRotator Latch(uint64 frame);
+
+  void Report(const TCHAR* label) const;
+  void Reset();
+
+private:
+  struct FSample {
+    double arrival;
+    float yaw;
+    float pitch;
+    uint64 frame; // committed with, 0 while pending
+    bool latched;
+    bool shown;
+  };
+
+  mutable FCriticalSection m_lock;
+  TArray<FSample> m_samples;
+  TArray<float> m_cameraMs; // arrival to the camera update
+  TArray<float> m_viewMs;   // arrival to the first rendered view
+  int32 m_renderLatched = 0;
+  float m_yawScale = 1.f;
+  float m_pitchScale = 1.f;
+  bool m_rendered;
+};
+
+// Commits the latched look of the pawn it is looking through as the last thing before the view is final.
+UCLASS()
+class FPS_CONTROLLER_API ULookLatchModifier : public UCameraModifier {
+  GENERATED_BODY()
+
+public:
+  virtual bool ModifyCamera(float DeltaTime, FMinimalViewInfo& InOutPOV) override;
+};
+
+// Adds the look that arrived after the camera update to the game view on the render thread, and times when
+// the input of each frame makes it to a rendered view.
+class FPS_CONTROLLER_API FLookLatchViewExtension : public FWorldSceneViewExtension {
+public:
+  FLookLatchViewExtension(const FAutoRegister& autoRegister, UWorld* world,
+                          const TSharedRef<FLookLatch, ESPMode::ThreadSafe>& latch);
+
+  virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override {}
+  virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override {}
+  virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override;
+  virtual void PreRenderView_RenderThread(FRDGBuilder& GraphBuilder, FSceneView& InView) override;
+
+private:
+  TSharedRef<FLookLatch, ESPMode::ThreadSafe> m_latch;
+  uint64 m_renderFrame = 0; // render thread only
+};
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MovementAgentSubsystem.h"
+
+#include "Engine/World.h"
+#include "LoadTestSubsystem.h"
+
+namespace {
+  FAutoConsoleCommandWithWorldAndArgs CmdSpawnAgents(
+    TEXT("fps.Agents.Spawn"),
+    TEXT("Adds N randomly driven SoA movement agents, 0 removes them all."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& args, UWorld* world) {
+      UMovementAgentSubsystem* agents = world ? world->GetSubsystem<UMovementAgentSubsystem>() : nullptr;
+      if (agents == nullptr || args.Num() == 0) return;
+      const int32 count = FCString::Atoi(*args[0]);
+      if (count <= 0) {
+        agents->ClearAgents();
+        return;
+      }
+      agents->AddAgents(count);
+      agents->SetDriveRandomly(true);
+    }));
+
+  FAutoConsoleCommandWithWorldAndArgs CmdBenchAgents(
+    TEXT("fps.Agents.Bench"),
+    TEXT("Per-agent cost of the SoA pass, then of spawned characters through a load test ramp, at 100, 1000 ")
+    TEXT("and 10000 agents. Arguments: [SoA frames, default 300] [seconds per ramp step, default 10]."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& args, UWorld* world) {
+      const TArray<int32> counts = {100, 1000, 10000};
+      RunMovementAgentBenchmark(counts, args.Num() > 0 ? FCString::Atoi(*args[0]) : 300);
+      // the characters tick with the world, their cost is logged at the end of each step
+      ULoadTestSubsystem* loadTest = world ? world->GetSubsystem<ULoadTestSubsystem>() : nullptr;
+      if (loadTest == nullptr || world->GetNetMode() == NM_Client) return;
+      loadTest->StartRamp(counts, args.Num() > 1 ? FCString::Atof(*args[1]) : 10.f, FBotBehaviorMix());
+    }));
+}
+
+int32 UMovementAgentSubsystem::AddAgents(int32 count) {
+  return m_agents.Add(count, m_params);
+}
+
+void UMovementAgentSubsystem::ClearAgents() {
+  m_agents.Reset();
+  m_driveRandomly = false;
+}
+
+void UMovementAgentSubsystem::Tick(float DeltaTime) {
+  Super::Tick(DeltaTime);
+  if (m_driveRandomly) {
+    m_agents.RandomizeInputs(m_seed, .02f);
+  }
+  m_agents.Update(DeltaTime, m_params);
+}
+
+TStatId UMovementAgentSubsystem::GetStatId() const {
+  RETURN_QUICK_DECLARE_CYCLE_STAT(UMovementAgentSubsystem, STATGROUP_Tickables);
+}
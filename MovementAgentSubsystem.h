@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MovementAgents.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "MovementAgentSubsystem.generated.h"
+
+// Owns the SoA movement agents of a world and updates all of them in one pass per frame.
+// fps.Agents.Spawn N adds agents driven by random inputs, fps.Agents.Bench times the SoA pass and then
+// ramps real bot driven characters through the same counts with ULoadTestSubsystem.
+UCLASS()
+class FPS_CONTROLLER_API UMovementAgentSubsystem : public UTickableWorldSubsystem {
+  GENERATED_BODY()
+
+public:
+  int32 AddAgents(int32 count);
+  void ClearAgents();
+  FMovementAgentSoA& GetAgents() { return m_agents; }
+  FMovementAgentParams& GetParams() { return m_params; }
+
+  // randomly flip inputs every frame, for load tests without anything driving the agents
+  void SetDriveRandomly(bool drive) { m_driveRandomly = drive; }
+
+  virtual void Tick(float DeltaTime) override;
+  virtual TStatId GetStatId() const override;
+  virtual bool IsTickable() const override { return m_agents.Num() > 0; }
+
+private:
+  FMovementAgentSoA m_agents;
+  FMovementAgentParams m_params;
+  uint32 m_seed = 1;
+  bool m_driveRandomly = false;
+};
@@ -0,0 +1,155 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MovementAgents.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMovementAgents, Log, All);
+
+namespace {
+  uint32 NextRandom(uint32& seed) {
+    seed = seed * 1664525u + 1013904223u;
+    return seed;
+  }
+}
+
+int32 FMovementAgentSoA::Add(int32 count, const FMovementAgentParams& params) {
+  const int32 first = Num();
+  m_flags.AddZeroed(count);
+  m_state.AddZeroed(count);
+  m_speed.AddZeroed(count);
+  m_coolDownTimer.AddZeroed(count);
+  m_maxSpeed.Reserve(first + count);
+  m_height.Reserve(first + count);
+  m_mana.Reserve(first + count);
+  for (int32 i = 0; i < count; i++) {
+    m_maxSpeed.Add(params.baseSpeed);
+    m_height.Add(params.standingHeight);
+    m_mana.Add(100.f);
+  }
+  return first;
+}
+
+void FMovementAgentSoA::Reset() {
+  m_flags.Reset();
+  m_state.Reset();
+  m_speed.Reset();
+  m_maxSpeed.Reset();
+  m_height.Reset();
+  m_mana.Reset();
+  m_coolDownTimer.Reset();
+}
+
+void FMovementAgentSoA::SetInput(int32 index, bool sprint, bool crouch) {
+  uint8& flags = m_flags[index];
+  flags = (flags & ~(kAgentSprinting | kAgentWantsCrouch)) | (sprint ? kAgentSprinting : 0) |
+    (crouch ? kAgentWantsCrouch : 0);
+}
+
+void FMovementAgentSoA::RandomizeInputs(uint32& seed, float changeChance) {
+  const uint32 threshold = static_cast<uint32>(FMath::Clamp(changeChance, 0.f, 1.f) * MAX_uint32);
+  for (int32 i = 0; i < m_flags.Num(); i++) {
+    if (NextRandom(seed) < threshold) {
+      m_flags[i] ^= (NextRandom(seed) & 1) ? kAgentSprinting : kAgentWantsCrouch;
+    }
+  }
+}
+
+void FMovementAgentSoA::Update(float deltaTime, const FMovementAgentParams& params) {
+  const int32 num = Num();
+  uint8* flags = m_flags.GetData();
+  uint8* state = m_state.GetData();
+  float* speed = m_speed.GetData();
+  float* maxSpeed = m_maxSpeed.GetData();
+  float* height = m_height.GetData();
+  float* mana = m_mana.GetData();
+  float* coolDownTimer = m_coolDownTimer.GetData();
+
+  const float crouchSpeed = params.baseSpeed / 1.75f;
+  const float stateSpeed[4] = {
+    params.baseSpeed, params.baseSpeed + params.baseSpeed * params.speedMultiplier / 100, crouchSpeed, 0.f
+  };
+
+  // transitions, the only pass with real branches
+  for (int32 i = 0; i < num; i++) {
+    uint8 f = flags[i];
+    if (f & kAgentSliding) continue;
+    uint8 next;
+    if (f & kAgentSprinting) {
+      if (f & kAgentCrouching) f &= ~kAgentWantsCrouch;
+      next = static_cast<uint8>(EMovementAgentState::kRunning);
+    }
+    else {
+      next = static_cast<uint8>((f & kAgentWantsCrouch) ? EMovementAgentState::kCrouching
+                                                          : EMovementAgentState::kWalking);
+    }
+    if ((f & (kAgentSprinting | kAgentCrouching | kAgentWantsCrouch)) == (kAgentSprinting | kAgentWantsCrouch)) {
+      f = (f | kAgentSliding | kAgentSlideOverride) & ~kAgentSprinting;
+      next = static_cast<uint8>(EMovementAgentState::kSliding);
+      speed[i] += params.slideBoost * 100;
+    }
+    flags[i] = f;
+    state[i] = next;
+  }
+
+  // speed, straight line math over the arrays
+  const float slideDecay = params.slideTime * deltaTime;
+  const float accelStep = params.acceleration * deltaTime;
+  for (int32 i = 0; i < num; i++) {
+    const bool sliding = state[i] == static_cast<uint8>(EMovementAgentState::kSliding);
+    maxSpeed[i] = sliding ? speed[i] - slideDecay : stateSpeed[state[i]];
+    speed[i] = FMath::Max(FMath::Min(speed[i] + accelStep, maxSpeed[i]), 0.f);
+  }
+
+  // slide end and crouch height
+  for (int32 i = 0; i < num; i++) {
+    uint8 f = flags[i];
+    if ((f & kAgentSliding) && speed[i] < crouchSpeed) {
+      f &= ~kAgentSliding;
+      state[i] = static_cast<uint8>(EMovementAgentState::kCrouching);
+    }
+    const bool slideOverride = (f & kAgentSlideOverride) != 0;
+    const float target = ((f & kAgentWantsCrouch) ? params.crouchedHeight : params.standingHeight) -
+      (slideOverride ? 10.f : 0.f);
+    const float blend = FMath::Min(deltaTime * params.crouchSmoothValue * (slideOverride ? 2.f : 1.f), 1.f);
+    height[i] += (target - height[i]) * blend;
+    if (FMath::Abs(height[i] - target) < 0.1f) {
+      if (slideOverride) {
+        f &= ~kAgentSlideOverride;
+      }
+      else {
+        height[i] = target;
+        f = (f & ~kAgentCrouching) | ((f & kAgentWantsCrouch) ? kAgentCrouching : 0);
+      }
+    }
+    flags[i] = f;
+  }
+
+  // resources
+  for (int32 i = 0; i < num; i++) {
+    const bool coolingDown = coolDownTimer[i] < params.coolDownTimeRecharge;
+    coolDownTimer[i] += coolingDown ? deltaTime : 0.f;
+    mana[i] += (!coolingDown && mana[i] <= 100.f) ? deltaTime * params.rechargeRate : 0.f;
+  }
+}
+
+void RunMovementAgentBenchmark(const TArray<int32>& agentCounts, int32 frames) {
+  const FMovementAgentParams params;
+  const float deltaTime = 1.f / 60.f;
+  frames = FMath::Max(frames, 1);
+
+  for (const int32 count : agentCounts) {
+    uint32 seed = 1234;
+    FMovementAgentSoA agents;
+    agents.Add(count, params);
+    double soaSeconds = 0;
+    for (int32 frame = 0; frame < frames; frame++) {
+      agents.RandomizeInputs(seed, .02f);
+      const double start = FPlatformTime::Seconds();
+      agents.Update(deltaTime, params);
+      soaSeconds += FPlatformTime::Seconds() - start;
+    }
+
+    UE_LOG(LogMovementAgents, Display, TEXT("%6d agents: SoA %.2f ns per agent per frame"), count,
+           soaSeconds * 1e9 / (static_cast<double>(count) * frames));
+  }
+}
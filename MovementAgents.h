@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// A sprint/crouch/slide state machine with mana and cooldown, laid out as structure-of-arrays so a whole
+// crowd of agents updates in a few tight passes. Load on the server's scale of the character, not the
+// character's rules: the speed integration and the slide are a simple stand-in for UPlayerMovementComponent,
+// and mana and cooldown count up every frame where UShiftAbilityComponent keeps timestamps.
+
+// values match EMovementState on the character
+enum class EMovementAgentState : uint8 { kWalking, kRunning, kCrouching, kSliding };
+
+enum EMovementAgentFlags : uint8 {
+  kAgentSprinting = 1 << 0,
+  kAgentWantsCrouch = 1 << 1,
+  kAgentCrouching = 1 << 2,
+  kAgentSliding = 1 << 3,
+  kAgentSlideOverride = 1 << 4,
+};
+
+struct FMovementAgentParams {
+  float baseSpeed = 600.f;
+  float speedMultiplier = 50.f; // percent on top of base while sprinting
+  float acceleration = 2048.f;
+  float standingHeight = 88.f;
+  float crouchedHeight = 40.f;
+  float crouchSmoothValue = 10.f;
+  float slideBoost = 5.f;
+  float slideTime = 300.f;
+  float rechargeRate = 10.f;
+  float coolDownTimeRecharge = 4.f;
+};
+
+class FPS_CONTROLLER_API FMovementAgentSoA {
+public:
+  // returns the index of the first new agent
+  int32 Add(int32 count, const FMovementAgentParams& params);
+  void Reset();
+  int32 Num() const { return m_flags.Num(); }
+
+  void SetInput(int32 index, bool sprint, bool crouch);
+  // flips sprint/crouch on roughly changeChance of the agents, deterministic for a given seed
+  void RandomizeInputs(uint32& seed, float changeChance);
+  void Update(float deltaTime, const FMovementAgentParams& params);
+
+  EMovementAgentState GetState(int32 index) const { return static_cast<EMovementAgentState>(m_state[index]); }
+  float GetSpeed(int32 index) const { return m_speed[index]; }
+  float GetHeight(int32 index) const { return m_height[index]; }
+  float GetMana(int32 index) const { return m_mana[index]; }
+
+private:
+  TArray<uint8> m_flags;
+  TArray<uint8> m_state;
+  TArray<float> m_speed;
+  TArray<float> m_maxSpeed;
+  TArray<float> m_height;
+  TArray<float> m_mana;
+  TArray<float> m_coolDownTimer;
+};
+
+// ns per agent per frame of the SoA pass at the given agent counts. The actor path it is compared against
+// is ULoadTestSubsystem's ramp over real characters, which reports the same unit
+FPS_CONTROLLER_API void RunMovementAgentBenchmark(const TArray<int32>& agentCounts, int32 frames);
@@ -3,21 +3,61 @@
 
 #include "PlayerCharacter.h"
 
+#include "ActorPoolSubsystem.h"
+#include "CharacterSignificance.h"
+#include "CharacterStats.h"
+#include "CharacterTelemetrySubsystem.h"
+#include "PlayerMovementComponent.h"
+#include "ShiftAllocationCounter.h"
+#include "ShiftLandingIndexSubsystem.h"
+#include "ShiftRootMotionSource.h"
+#include "TimerWheelSubsystem.h"
+#include "CharacterDebug.h"
 #include "CollisionDebugDrawingPublic.h"
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "KismetTraceUtils.h"
+#include "Camera/PlayerCameraManager.h"
 #include "Components/CapsuleComponent.h"
+#include "Engine/AssetManager.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Kismet/KismetMathLibrary.h"
-#include "Kismet/KismetStringLibrary.h"
 #include "Kismet/KismetSystemLibrary.h"
-#include "bitset"
 #include "Kismet/GameplayStatics.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Net/UnrealNetwork.h"
+
+namespace {
+  FAutoConsoleCommandWithWorldAndArgs CmdRewindLoop(
+    TEXT("fps.Loop.Rewind"),
+    TEXT("Rewinds the local player character by N seconds (default 5) along its recorded time loop."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& args, UWorld* world) {
+      const APlayerController* controller = world ? world->GetFirstPlayerController() : nullptr;
+      APlayerCharacter* character = controller ? Cast<APlayerCharacter>(controller->GetPawn()) : nullptr;
+      if (character == nullptr) return;
+      character->RewindTimeLoop(args.Num() > 0 ? FCString::Atof(*args[0]) : 5.f);
+    }));
+
+#if ENABLE_CHARACTER_STATS
+  FAutoConsoleCommandWithWorldAndArgs CmdShiftAllocBench(
+    TEXT("fps.Shift.AllocBench"),
+    TEXT("Runs N full shift resolves (default 1000) from the local player's view and logs the heap allocations ")
+    TEXT("made after the first few. Debug overlays allocate, leave them off."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& args, UWorld* world) {
+      const APlayerController* controller = world ? world->GetFirstPlayerController() : nullptr;
+      APlayerCharacter* character = controller ? Cast<APlayerCharacter>(controller->GetPawn()) : nullptr;
+      if (character == nullptr) return;
+      character->RunShiftAllocationBench(FMath::Max(args.Num() > 0 ? FCString::Atoi(*args[0]) : 1000, 1));
+    }));
+#endif
+}
 
+DEFINE_LOG_CATEGORY_STATIC(LogPlayerCharacter, Log, All);
 
 // Sets default values
-APlayerCharacter::APlayerCharacter() {
+APlayerCharacter::APlayerCharacter(const FObjectInitializer& objectInitializer)
+  : Super(objectInitializer.SetDefaultSubobjectClass<UPlayerMovementComponent>(CharacterMovementComponentName)) {
   // Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
   PrimaryActorTick.bCanEverTick = true;
 
@@ -26,19 +66,37 @@ APlayerCharacter::APlayerCharacter() {
   m_cameraComponent->SetRelativeLocation(FVector(0, 0, BaseEyeHeight));
   m_cameraComponent->bUsePawnControlRotation = true;
 
+  m_shiftAbility = CreateDefaultSubobject<UShiftAbilityComponent>(TEXT("Shift Ability"));
+  // the movement component crouches, inside the move on every machine
+  GetCharacterMovement()->GetNavAgentPropertiesRef().bCanCrouch = true;
+
   VFX = nullptr;
   m_testBool = false;
+  m_shiftSequence = 0;
+  m_shiftRootMotionId = 0;
+  m_shiftAbilityHandle = INDEX_NONE;
+  m_timerWheel = nullptr;
+  m_shiftCandidateSearch = false;
+  m_useShiftLandingIndex = true;
+  m_recordTimeLoop = true;
+  m_lateLatchedLook = false;
+  m_timerChannel = INDEX_NONE;
+  m_shiftTraceDelegate.BindUObject(this, &APlayerCharacter::OnShiftTraceDone);
 }
 
 // Called when the game starts or when spawned
 void APlayerCharacter::BeginPlay() {
   Super::BeginPlay();
-  check(GEngine != nullptr);
-  GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Red, FString("Using Custom Player"));
+#if ENABLE_CHARACTER_DEBUG
+  if (GEngine != nullptr) {
+    GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Red, FString("Using Custom Player"));
+  }
+#endif
 
   m_playerController = Cast<APlayerController>(GetController());
-  // Setup player input subsystem
-  if (const ULocalPlayer* localPlayer = Cast<ULocalPlayer>(m_playerController->GetLocalPlayer())) {
+  // Setup player input subsystem, simulated proxies have no controller
+  const ULocalPlayer* localPlayer = m_playerController ? m_playerController->GetLocalPlayer() : nullptr;
+  if (localPlayer != nullptr) {
     if (UEnhancedInputLocalPlayerSubsystem* InputSystem =
       localPlayer->GetSubsystem<UEnhancedInputLocalPlayerSubsystem>()) {
       if (InputMapping != nullptr) {
@@ -46,7 +104,22 @@ void APlayerCharacter::BeginPlay() {
       }
     }
   }
-  m_characterMovementComponent = GetCharacterMovement();
+  // only when look is latched or timed (-LookLatency, or an input replay reporting it), the plain look path
+  // has nothing to hold back or sample
+  FString replayPath;
+  const bool timeLook = FParse::Param(FCommandLine::Get(), TEXT("LookLatency")) ||
+    FParse::Value(FCommandLine::Get(), TEXT("InputReplay="), replayPath);
+  FParse::Bool(FCommandLine::Get(), TEXT("LateLatchedLook="), m_lateLatchedLook);
+  if (localPlayer != nullptr && m_playerController->PlayerCameraManager != nullptr &&
+    (m_lateLatchedLook || timeLook)) {
+    m_lookLatch = MakeShared<FLookLatch, ESPMode::ThreadSafe>(FApp::CanEverRender());
+    m_playerController->PlayerCameraManager->AddNewCameraModifier(ULookLatchModifier::StaticClass());
+    if (FApp::CanEverRender()) {
+      m_lookLatchExtension =
+        FSceneViewExtensions::NewExtension<FLookLatchViewExtension>(GetWorld(), m_lookLatch.ToSharedRef());
+    }
+  }
+  m_characterMovementComponent = CastChecked<UPlayerMovementComponent>(GetCharacterMovement());
   m_characterMovementComponent->MaxWalkSpeed = m_movementMeterPerSec * 100;
   m_baseSpeed = m_characterMovementComponent->MaxWalkSpeed;
   // GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Yellow,
@@ -56,70 +129,476 @@ void APlayerCharacter::BeginPlay() {
   // magic number but i think this would be more flexible
 
   m_maxSprintSpeed = m_baseSpeed + (m_baseSpeed * m_speedMultiplier / 100);
+  m_characterMovementComponent->SetStateSpeeds(m_maxSprintSpeed, m_slideBoost * 100, m_slideTime);
 
   m_capsuleComponent = GetCapsuleComponent();
 
-  // cached values
-  m_cachedStandingHeight = m_capsuleComponent->GetScaledCapsuleHalfHeight();
+  // cached values, from the defaults since a replicated crouch can come in before BeginPlay
+  const ACharacter* defaults = GetClass()->GetDefaultObject<ACharacter>();
+  m_cachedStandingHeight = defaults->GetCapsuleComponent()->GetScaledCapsuleHalfHeight();
+  m_standingEyeHeight = defaults->BaseEyeHeight;
   m_cacheFOV = m_cameraComponent->FieldOfView;
+  m_cachedSimulationTimeStep = m_characterMovementComponent->MaxSimulationTimeStep;
+
+  // simulated values, presented to the camera/actor after each frame's steps
+  m_crouchHeight = m_prevCrouchHeight = GetTargetCrouchHeight();
+  m_fov = m_prevFov = m_cacheFOV;
+  m_fixedStepClock.Reset(m_fixedStepRate, m_maxSubSteps);
+
+  // every character shares one channel, the wheel hands over all expired timers of a frame at once
+  m_timerWheel = GetWorld()->GetSubsystem<UTimerWheelSubsystem>();
+  m_timerChannel = m_timerWheel->FindOrAddChannel(TEXT("PlayerCharacter"), &APlayerCharacter::OnWheelTimers);
+  m_shiftTraceParams = FShiftTraceParams(this);
+  GetWorld()->GetSubsystem<UCharacterSignificanceSubsystem>()->Register(this);
+
+  // without an asset the shift runs on the defaults of UAbilityData
+  m_shiftAbilityHandle =
+    m_shiftAbility->AddAbility(m_shiftAbilityData ? m_shiftAbilityData : GetMutableDefault<UAbilityData>());
+  // after the ability, a running session writes the tuning right away
+  m_telemetryId = GetWorld()->GetSubsystem<UCharacterTelemetrySubsystem>()->Register(this);
+
+  // possession can come before BeginPlay, the wheel is only there from here on
+  UpdateTimeLoopRecording();
+
+  // stream the VFX in now rather than on the first shift
+  if (!ShiftVFX.IsNull()) {
+    UAssetManager::GetStreamableManager().RequestAsyncLoad(
+      ShiftVFX.ToSoftObjectPath(), FStreamableDelegate::CreateUObject(this, &APlayerCharacter::OnShiftVFXLoaded));
+  }
+
+  // possession usually comes later, whichever is last starts the replay or the recording
+  UpdateInputCapture();
 }
 
 
 // Called every frame
 void APlayerCharacter::Tick(float DeltaTime) {
+  TickCharacter(DeltaTime);
+  // replay bookkeeping stays out of the Tick scope that -CharacterLimit.Tick checks
+  if (m_inputPlayer) {
+    EndInputReplayFrame();
+  }
+}
+
+void APlayerCharacter::TickCharacter(float DeltaTime) {
+  CHARACTER_STAT_SCOPE(Tick);
   Super::Tick(DeltaTime);
 
-  GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Blue,
-                                   FString::Printf(
-                                     TEXT("Movement State: %hhd"), m_movementState));
-  GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Blue,
-                                   FString::Printf(
-                                     TEXT("Sprinting: %s"), *UKismetStringLibrary::Conv_BoolToString(m_isSprinting)));
-  GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Blue,
-                                   FString::Printf(
-                                     TEXT("Crouching: %s"), *UKismetStringLibrary::Conv_BoolToString(m_isCrouching)));
-  GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Blue,
-                                   FString::Printf(
-                                     TEXT("Sliding: %s"), *UKismetStringLibrary::Conv_BoolToString(m_isSliding)));
-  GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Blue,
-                                   FString::Printf(
-                                     TEXT("Wants 2 Slide: %f"),
-                                     m_capsuleComponent->GetScaledCapsuleHalfHeight()));
-  GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Blue,
-                                   FString::Printf(
-                                     TEXT("Wants 2 Crouch: %s"),
-                                     *UKismetStringLibrary::Conv_BoolToString(m_wantsToCrouch)));
-
-  if(m_coolDownTimer < m_coolDownTimeRecharge && !m_shiftToLocation) {
-    m_coolDownTimer += DeltaTime; 
-  } else {
-    RechargeMana(DeltaTime);
+  TickInputReplay();
+  // the movement component runs the slide and ends it (too slow, off the floor, a jump or a shift)
+  if (m_isSliding && !m_characterMovementComponent->IsSliding() && !m_characterMovementComponent->IsSlidePending()) {
+    EndSlide();
   }
+
+  CHARACTER_DEBUG_VALUE(m_debugOverlay, kDebugMovementState, "Movement State", static_cast<int32>(m_movementState));
+  CHARACTER_DEBUG_VALUE(m_debugOverlay, kDebugSprinting, "Sprinting", m_isSprinting);
+  CHARACTER_DEBUG_VALUE(m_debugOverlay, kDebugCrouching, "Crouching", m_isCrouching);
+  CHARACTER_DEBUG_VALUE(m_debugOverlay, kDebugSliding, "Sliding", m_isSliding);
+  CHARACTER_DEBUG_VALUE(m_debugOverlay, kDebugHalfHeight, "Half Height",
+                        m_capsuleComponent->GetScaledCapsuleHalfHeight());
+  CHARACTER_DEBUG_VALUE(m_debugOverlay, kDebugWantsToCrouch, "Wants 2 Crouch", m_wantsToCrouch);
+
   
-  HandleSpeed();
-  HandleCrouch(); // could go into another thread?
-  // Lerp Movement + Camera Movement
-  if(m_shiftToLocation) {
-    m_elapsedTime += GetWorld()->DeltaTimeSeconds;
-    m_cameraComponent->SetFieldOfView(FMath::Lerp( m_cacheFOV,170, m_elapsedTime/(m_desiredTime * 2)));
-    SetActorLocation(FMath::Lerp(m_cacheLocation, m_shiftLocation, m_elapsedTime/m_desiredTime));
-    if(m_elapsedTime >= m_desiredTime) {
-      m_shiftToLocation = false;
-      m_elapsedTime = 0;
-      m_fovOffset = m_cameraComponent->FieldOfView;
-    }
+  // variable mode is a single step of the frame time, presented as is. Characters nobody is close to
+  // take that too, their ticks are far enough apart that fixed steps would only catch up in bursts
+  const bool fixedSteps = m_fixedStepSimulation && m_significance >= ECharacterSignificance::kNear;
+  int32 steps = 1;
+  float stepTime = DeltaTime;
+  if (fixedSteps) {
+    steps = m_fixedStepClock.Advance(DeltaTime);
+    stepTime = m_fixedStepClock.step;
+  }
+  for (int32 i = 0; i < steps; i++) {
+    SimulateStep(stepTime);
+  }
+  if (IsLocalViewer()) {
+    UpdateShiftFov();
+  }
+  PresentSimulation(fixedSteps ? m_fixedStepClock.GetAlpha() : 1.f);
+
+  CHARACTER_DEBUG_FLUSH(m_debugOverlay, GetWorld(), static_cast<uint64>(GetUniqueID()) << 4);
+  RefreshTickEnabled();
+}
+
+// Advances everything that blends over time by one step. Only touches simulated values, the
+// capsule/camera/actor only see them through PresentSimulation.
+void APlayerCharacter::SimulateStep(float deltaTime) {
+  m_prevCrouchHeight = m_crouchHeight;
+  m_prevFov = m_fov;
+
+  // state changes come from the input callbacks, only the running blends are advanced here
+  if (m_crouchBlendActive) HandleCrouch(deltaTime);
+}
+
+// The shift itself is moved by the movement component (FRootMotionSource_Shift), the FOV reads the
+// same timeline: up while the root motion runs, back down over the return timer.
+void APlayerCharacter::UpdateShiftFov() {
+  const float duration = GetShiftDuration();
+  const float returnTime = duration * 2;
+  if (m_shiftToLocation) {
+    const TSharedPtr<FRootMotionSource> shift =
+      m_characterMovementComponent->GetRootMotionSourceByID(m_shiftRootMotionId);
+    const float time = shift ? static_cast<FRootMotionSource_Shift*>(shift.Get())->GetAlpha() * duration
+                         : duration;
+    m_fov = FMath::Lerp(m_cacheFOV, 170.f, FMath::Min(time / returnTime, 1.f));
   }
   // Lerp Camera Return Movement
-  if(!m_shiftToLocation && m_cameraComponent->FieldOfView > m_cacheFOV)  {
-    m_elapsedTime += GetWorld()->DeltaTimeSeconds;
-    m_cameraComponent->SetFieldOfView(FMath::Lerp( m_fovOffset,m_cacheFOV, m_elapsedTime/(m_desiredTime * 2)));
-    if(m_elapsedTime >= (m_desiredTime * 2)) {
-      m_elapsedTime = 0;
-      m_cameraComponent->SetFieldOfView(m_cacheFOV);
+  else if (m_fovReturnTimer.IsValid()) {
+    const float time = returnTime - m_timerWheel->GetRemaining(m_fovReturnTimer);
+    m_fov = FMath::Lerp(m_fovOffset, m_cacheFOV, FMath::Min(time / returnTime, 1.f));
+  }
+  else {
+    return;
+  }
+  // not part of the fixed steps, shown as is
+  m_prevFov = m_fov;
+}
+
+float APlayerCharacter::GetShiftDuration() const {
+  const UAbilityData* ability = m_shiftAbilityHandle != INDEX_NONE ? m_shiftAbility->GetAbility(m_shiftAbilityHandle)
+                                                                   : GetDefault<UAbilityData>();
+  return ability->m_activeTime;
+}
+
+void APlayerCharacter::StartShift(const FVector& target) {
+  const float duration = GetShiftDuration();
+  m_shiftLocation = target;
+  m_cacheLocation = GetActorLocation();
+  m_shiftToLocation = true;
+  m_timerWheel->Cancel(m_fovReturnTimer);
+  m_timerWheel->Cancel(m_shiftEndTimer);
+  m_shiftEndTimer = AddCharacterTimer(ECharacterTimer::kShiftEnd, duration);
+
+  const TSharedPtr<FRootMotionSource_Shift> shift = MakeShared<FRootMotionSource_Shift>();
+  shift->InstanceName = TEXT("Shift");
+  shift->Duration = duration;
+  shift->startLocation = m_cacheLocation;
+  shift->targetLocation = target;
+  // don't carry the shift speed past the landing spot
+  shift->FinishVelocityParams.Mode = ERootMotionFinishVelocityMode::ClampVelocity;
+  shift->FinishVelocityParams.ClampVelocity = m_baseSpeed;
+  m_characterMovementComponent->RemoveRootMotionSourceByID(m_shiftRootMotionId);
+  m_shiftRootMotionId = m_characterMovementComponent->ApplyRootMotionSource(shift);
+
+  // falling is the mode that sub-steps, root motion overrides its gravity while the shift runs
+  if (m_characterMovementComponent->IsMovingOnGround()) {
+    m_characterMovementComponent->SetMovementMode(MOVE_Falling);
+  }
+  m_characterMovementComponent->MaxSimulationTimeStep = m_shiftSubStepTime;
+  RefreshTickEnabled();
+}
+
+FWheelTimerHandle APlayerCharacter::AddCharacterTimer(ECharacterTimer timer, float delay) {
+  // UObjects are aligned well past 4 bytes, the low bits of the pointer carry the timer kind
+  return m_timerWheel->Add(m_timerChannel, delay, reinterpret_cast<uint64>(this) | static_cast<uint64>(timer));
+}
+
+void APlayerCharacter::OnWheelTimers(TConstArrayView<uint64> payloads) {
+  for (const uint64 payload : payloads) {
+    APlayerCharacter* character = reinterpret_cast<APlayerCharacter*>(payload & ~uint64(kCharacterTimerMask));
+    character->OnCharacterTimer(static_cast<ECharacterTimer>(payload & kCharacterTimerMask));
+  }
+}
+
+void APlayerCharacter::OnCharacterTimer(ECharacterTimer timer) {
+  switch (timer) {
+  case ECharacterTimer::kShiftEnd: m_shiftEndTimer.Invalidate();
+    EndShift();
+    break;
+  case ECharacterTimer::kFovReturn: m_fovReturnTimer.Invalidate();
+    // the tick may go idle right after this, so show the final FOV now
+    m_fov = m_prevFov = m_cacheFOV;
+    m_cameraComponent->SetFieldOfView(m_cacheFOV);
+    RefreshTickEnabled();
+    break;
+  case ECharacterTimer::kLoopSample: m_loopSampleTimer.Invalidate();
+    // an earlier timer of the same batch may have stopped the recording
+    if (!m_timeLoop) break;
+    SampleTimeLoop();
+    m_loopSampleTimer = AddCharacterTimer(ECharacterTimer::kLoopSample, 1.f / m_timeLoop->GetSampleRate());
+    break;
+  }
+}
+
+void APlayerCharacter::NotifyControllerChanged() {
+  Super::NotifyControllerChanged();
+  UpdateTimeLoopRecording();
+  UpdateInputCapture();
+}
+
+// -InputRecord=<file> captures every input, -InputReplay=<file> plays one back (headless works fine,
+// -InputReplayLoops=N repeats it, -InputReplayQuit exits once done). A replay doubles as the regression
+// run for this class: -InputReplayExpect=<file> checks the state transitions against a known good run,
+// -CharacterLimit.<Scope>=<us> and -InputReplayLimitP95Ms=<ms> gate the timings, the exit code says which
+void APlayerCharacter::UpdateInputCapture() {
+  if (!HasActorBegunPlay() && !IsActorBeginningPlay()) return;
+  // only the pawn the local player looks through. Bots, simulated proxies and the server's copies would
+  // each replay the stream, or save over the player's recording when they end play
+  if (!IsLocalViewer()) {
+    StopInputCapture();
+    return;
+  }
+  if (m_inputPlayer || m_inputRecorder) return;
+
+  FString replayPath;
+  m_inputStartFrame = GFrameCounter;
+  if (FParse::Value(FCommandLine::Get(), TEXT("InputReplay="), replayPath)) {
+    m_inputPlayer = MakeUnique<FCharacterInputPlayer>();
+    if (!m_inputPlayer->Load(replayPath)) {
+      m_inputPlayer.Reset();
     }
+    m_replayLoops = 1;
+    m_replayPassed = true;
+    FParse::Value(FCommandLine::Get(), TEXT("InputReplayLoops="), m_replayLoops);
+    FParse::Value(FCommandLine::Get(), TEXT("InputReplayStates="), m_replayStatesPath);
+    FParse::Value(FCommandLine::Get(), TEXT("InputReplayExpect="), m_replayExpectPath);
+    RefreshTickEnabled();
+  }
+  else if (FParse::Value(FCommandLine::Get(), TEXT("InputRecord="), m_inputRecordPath)) {
+    m_inputRecorder = MakeUnique<FCharacterInputRecorder>();
+  }
+}
+
+void APlayerCharacter::StopInputCapture() {
+  if (m_inputRecorder) {
+    m_inputRecorder->Save(m_inputRecordPath);
+    m_inputRecorder.Reset();
+  }
+  if (m_inputPlayer) {
+    m_replayStats.Report(TEXT("Input replay (cut short)"));
+    m_inputPlayer.Reset();
+    RefreshTickEnabled();
+  }
+}
+
+void APlayerCharacter::UpdateTimeLoopRecording() {
+  if (m_timerWheel == nullptr) return;
+  // only the local player rewinds, simulated proxies and bots never get a ring or a sample timer
+  const bool record = m_recordTimeLoop && IsLocallyControlled() && IsPlayerControlled();
+  if (record && !m_timeLoop) {
+    m_timeLoop = MakeUnique<FTimeLoopRecorder>(m_timeLoopBudgetKB * 1024);
+    m_loopSampleTimer = AddCharacterTimer(ECharacterTimer::kLoopSample, 1.f / m_timeLoop->GetSampleRate());
+  }
+  else if (!record && m_timeLoop) {
+    m_timerWheel->Cancel(m_loopSampleTimer);
+    m_timeLoop.Reset();
+  }
+}
+
+void APlayerCharacter::SampleTimeLoop() {
+  FTimeLoopState state;
+  state.location = GetActorLocation();
+  state.velocity = GetVelocity();
+  state.capsuleHalfHeight = m_crouchHeight;
+  state.fov = m_cameraComponent->FieldOfView;
+  state.mana = m_shiftAbility->GetMana();
+  state.coolDownElapsed = m_shiftAbility->GetCoolDownElapsed(m_shiftAbilityHandle);
+  state.movementState = static_cast<uint8>(m_movementState);
+  m_timeLoop->Record(GetWorld()->GetTimeSeconds(), state);
+}
+
+void APlayerCharacter::FillTelemetry(FTelemetryFrame& row) const {
+  row.character = m_telemetryId;
+  row.movementState = static_cast<uint8>(m_movementState);
+  row.velocity = FVector3f(GetVelocity());
+  row.halfHeight = m_crouchHeight;
+  row.mana = m_shiftAbility->GetMana();
+  // long over past this, clamped so the column stays flat between shifts
+  row.coolDown = FMath::Min(m_shiftAbility->GetCoolDownElapsed(m_shiftAbilityHandle), 10.f);
+}
+
+void APlayerCharacter::FillTelemetry(FTelemetryCharacter& row) const {
+  const UAbilityData* ability = m_shiftAbility->GetAbility(m_shiftAbilityHandle);
+  row.character = m_telemetryId;
+  row.slideBoost = m_slideBoost;
+  row.slideTime = m_slideTime;
+  row.speedMultiplier = m_speedMultiplier;
+  row.manaCost = ability->m_manaCost;
+  row.rechargeRate = m_shiftAbility->GetRechargeRate();
+  row.rechargeDelay = ability->m_rechargeDelay;
+}
+
+void APlayerCharacter::RecordShiftTelemetry(ETelemetryShiftOutcome outcome) const {
+  FCharacterTelemetry& telemetry = FCharacterTelemetry::Get();
+  if (!telemetry.IsRecording()) return;
+  FTelemetryShift row;
+  row.timeMs = telemetry.GetTimeMs();
+  row.character = m_telemetryId;
+  row.branch = static_cast<uint8>(m_lastShiftBranch);
+  row.flags = m_lastShiftFlags;
+  row.outcome = static_cast<uint8>(outcome);
+  telemetry.Record(row);
+}
+
+bool APlayerCharacter::RewindTimeLoop(float seconds) {
+  FTimeLoopState state;
+  if (!m_timeLoop || !m_timeLoop->Seek(GetWorld()->GetTimeSeconds() - seconds, state)) return false;
+
+  if (m_shiftToLocation) {
+    m_characterMovementComponent->RemoveRootMotionSourceByID(m_shiftRootMotionId);
+    EndShift();
+  }
+  SetActorLocation(state.location, false, nullptr, ETeleportType::TeleportPhysics);
+  CHARACTER_STAT_CALL(SetActorLocation);
+  m_characterMovementComponent->Velocity = state.velocity;
+  m_shiftAbility->SyncState(m_shiftAbilityHandle, state.mana, state.coolDownElapsed);
+  m_fov = m_prevFov = state.fov;
+  m_cameraComponent->SetFieldOfView(state.fov);
+
+  const EMovementState movementState = static_cast<EMovementState>(state.movementState);
+  m_isSliding = false;
+  m_characterMovementComponent->StopSlide();
+  m_isSprinting = movementState == EMovementState::kRunning;
+  m_wantsToCrouch = movementState == EMovementState::kCrouching || movementState == EMovementState::kSliding;
+  m_crouchHeight = m_prevCrouchHeight = state.capsuleHalfHeight;
+  UpdateMovementState();
+  return true;
+}
+
+// hands over from the shift to the camera return
+void APlayerCharacter::EndShift() {
+  m_timerWheel->Cancel(m_shiftEndTimer);
+  m_shiftToLocation = false;
+  m_characterMovementComponent->MaxSimulationTimeStep = m_cachedSimulationTimeStep;
+  m_fovOffset = m_fov;
+  m_timerWheel->Cancel(m_fovReturnTimer);
+  m_fovReturnTimer = AddCharacterTimer(ECharacterTimer::kFovReturn, GetShiftDuration() * 2);
+  RefreshTickEnabled();
+}
+
+// alpha is how far the frame got into the next step, 1 when not running fixed steps
+void APlayerCharacter::PresentSimulation(float alpha) {
+  const float height = FMath::Lerp(m_prevCrouchHeight, m_crouchHeight, alpha);
+  // the movement component already gave the capsule its final height, only the eye follows the blend
+  const float eyeHeight = m_standingEyeHeight + height - m_capsuleComponent->GetScaledCapsuleHalfHeight();
+  if (eyeHeight != m_cameraComponent->GetRelativeLocation().Z) {
+    m_cameraComponent->SetRelativeLocation(FVector(0, 0, eyeHeight));
+  }
+  // m_fov only moves for the local viewer (UpdateShiftFov)
+  const float fov = FMath::Lerp(m_prevFov, m_fov, alpha);
+  if (fov != m_cameraComponent->FieldOfView) {
+    m_cameraComponent->SetFieldOfView(fov);
+  }
+  // the last step still has to be shown fully before the tick can go idle
+  m_presentPending = alpha < 1.f && (m_prevCrouchHeight != m_crouchHeight || m_prevFov != m_fov);
+}
+
+void APlayerCharacter::OnShiftVFXLoaded() {
+  if (UActorPoolSubsystem* pool = GetWorld()->GetSubsystem<UActorPoolSubsystem>()) {
+    pool->Prewarm(ShiftVFX.Get(), m_shiftVFXPoolSize);
+  }
+}
+
+void APlayerCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+  StopInputCapture();
+#if ENABLE_CHARACTER_DEBUG
+  m_debugOverlay.Clear(static_cast<uint64>(GetUniqueID()) << 4);
+#endif
+  // the wheel holds raw pointers to us
+  if (m_timerWheel) {
+    m_timerWheel->Cancel(m_shiftEndTimer);
+    m_timerWheel->Cancel(m_fovReturnTimer);
+    m_timerWheel->Cancel(m_loopSampleTimer);
+  }
+  if (UCharacterSignificanceSubsystem* significance = GetWorld()->GetSubsystem<UCharacterSignificanceSubsystem>()) {
+    significance->Unregister(this);
+  }
+  if (UCharacterTelemetrySubsystem* telemetry = GetWorld()->GetSubsystem<UCharacterTelemetrySubsystem>()) {
+    telemetry->Unregister(this);
+  }
+  if (m_lookLatch && m_playerController != nullptr && m_playerController->PlayerCameraManager != nullptr) {
+    APlayerCameraManager* cameraManager = m_playerController->PlayerCameraManager;
+    cameraManager->RemoveCameraModifier(cameraManager->FindCameraModifierByClass(ULookLatchModifier::StaticClass()));
+  }
+  m_lookLatchExtension.Reset();
+  m_lookLatch.Reset();
+  Super::EndPlay(EndPlayReason);
+}
+
+void APlayerCharacter::RecordInput(ECharacterInput channel, const FInputActionValue& value) {
+  if (m_inputRecorder) {
+    m_inputRecorder->Record(static_cast<uint32>(GFrameCounter - m_inputStartFrame), channel, value);
+  }
+}
+
+void APlayerCharacter::DispatchInput(ECharacterInput channel, const FInputActionValue& value) {
+  switch (channel) {
+  case ECharacterInput::kMovement: Movement(value);
+    break;
+  case ECharacterInput::kLook: LookMovement(value);
+    break;
+  case ECharacterInput::kJump: Jump();
+    break;
+  case ECharacterInput::kSprint: Sprint(value);
+    break;
+  case ECharacterInput::kCrouch: SetCrouch(value);
+    break;
+  case ECharacterInput::kThrust: Thrust();
+    break;
+  case ECharacterInput::kStartAbility: StartAbility();
+    break;
+  case ECharacterInput::kExecuteAbility: ExecuteAbility();
+    break;
   }
 }
 
+void APlayerCharacter::TickInputReplay() {
+  if (!m_inputPlayer) return;
+
+  m_replayStats.Sample();
+  m_inputPlayer->Dispatch(static_cast<uint32>(GFrameCounter - m_inputStartFrame),
+                          [this](ECharacterInput channel, const FInputActionValue& value) {
+                            DispatchInput(channel, value);
+                          });
+}
+
+void APlayerCharacter::EndInputReplayFrame() {
+  // without a states file or an expected one there is nobody to read the trace
+  if (!m_replayStatesPath.IsEmpty() || !m_replayExpectPath.IsEmpty()) {
+    FReplayState state;
+    state.movementState = static_cast<uint8>(m_movementState);
+    state.sliding = m_isSliding;
+    state.crouching = m_isCrouching;
+    state.canShift = m_canShift;
+    state.ready = m_shiftAbility->IsReady(m_shiftAbilityHandle);
+    state.mana = FMath::RoundToInt(m_shiftAbility->GetMana());
+    m_replayStates.Add(static_cast<uint32>(GFrameCounter - m_inputStartFrame), state);
+  }
+  if (!m_inputPlayer->IsFinished()) return;
+
+  m_replayStats.Report(TEXT("Input replay"));
+  if (m_lookLatch) {
+    m_lookLatch->Report(m_lateLatchedLook ? TEXT("Input replay look, latched") : TEXT("Input replay look"));
+    m_lookLatch->Reset();
+  }
+  m_replayPassed &= m_replayStats.CheckLimit();
+  m_replayStats.Reset();
+  if (--m_replayLoops > 0) {
+    m_inputStartFrame = GFrameCounter + 1;
+    m_inputPlayer->Restart();
+    return;
+  }
+  m_inputPlayer.Reset();
+#if ENABLE_CHARACTER_STATS
+  if (FParse::Param(FCommandLine::Get(), TEXT("CharacterStatsCsv"))) {
+    FCharacterStats::Get().WriteCsv(FCharacterStats::GetDefaultCsvPath());
+  }
+  m_replayPassed &= FCharacterStats::Get().CheckLimits();
+  m_replayPassed &= FShiftAllocationCounter::CheckLimit(m_shiftAllocWarmup);
+#endif
+  if (!m_replayStatesPath.IsEmpty()) {
+    m_replayStates.Save(m_replayStatesPath);
+  }
+  if (!m_replayExpectPath.IsEmpty()) {
+    m_replayPassed &= m_replayStates.Matches(m_replayExpectPath);
+  }
+  m_replayStates.Reset();
+  if (FParse::Param(FCommandLine::Get(), TEXT("InputReplayQuit"))) {
+    FPlatformMisc::RequestExitWithStatus(false, m_replayPassed ? 0 : 1);
+  }
+  RefreshTickEnabled();
+}
+
 // Called to bind functionality to input
 void APlayerCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent) {
   UEnhancedInputComponent* inputComponent = Cast<UEnhancedInputComponent>(PlayerInputComponent);
@@ -138,6 +617,7 @@ void APlayerCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputCom
 }
 
 void APlayerCharacter::Movement(const FInputActionValue& value) {
+  RecordInput(ECharacterInput::kMovement, value);
   FVector2d moveVec2d = value.Get<FVector2d>();
   moveVec2d.Normalize();
   if (Controller != nullptr) {
@@ -147,15 +627,24 @@ void APlayerCharacter::Movement(const FInputActionValue& value) {
 }
 
 void APlayerCharacter::LookMovement(const FInputActionValue& value) {
+  RecordInput(ECharacterInput::kLook, value);
   FVector2d lookVec2d = value.Get<FVector2d>();
   lookVec2d *= (m_mouseSensitivity / 10);
-  if (Controller != nullptr) {
-    AddControllerYawInput(lookVec2d.X);
-    AddControllerPitchInput(-lookVec2d.Y);
+  if (Controller == nullptr) return;
+  // handed to the controller by ULookLatchModifier as the camera is finalized
+  if (m_lookLatch && m_lateLatchedLook) {
+    m_lookLatch->Add(lookVec2d.X, -lookVec2d.Y, true);
+    return;
+  }
+  AddControllerYawInput(lookVec2d.X);
+  AddControllerPitchInput(-lookVec2d.Y);
+  if (m_lookLatch) {
+    m_lookLatch->Add(lookVec2d.X, -lookVec2d.Y, false);
   }
 }
 
 void APlayerCharacter::Sprint(const FInputActionValue& value) {
+  RecordInput(ECharacterInput::kSprint, value);
   // m_characterMovementComponent->MaxWalkSpeed = m_baseSpeed + (m_baseSpeed * m_speedMultiplier / 100);
   // This solves the toggle action either using Started and Completed Triggers 
   // or in IMC using the pressed and released Triggers
@@ -165,9 +654,11 @@ void APlayerCharacter::Sprint(const FInputActionValue& value) {
   else if (!m_sprintToggle) {
     m_isSprinting = value.Get<bool>();
   }
+  UpdateMovementState();
 }
 
 void APlayerCharacter::SetCrouch(const FInputActionValue& value) {
+  RecordInput(ECharacterInput::kCrouch, value);
   // m_characterMovementComponent->MaxWalkSpeed = m_baseSpeed - ((m_baseSpeed * .01) / 2) * ((m_baseSpeed / 100) *
   //   m_speedMultiplier);
   if (m_crouchToggle && value.Get<bool>()) {
@@ -176,109 +667,188 @@ void APlayerCharacter::SetCrouch(const FInputActionValue& value) {
   else if (!m_crouchToggle) {
     m_wantsToCrouch = value.Get<bool>();
   }
+  UpdateMovementState();
 }
 
-void APlayerCharacter::HandleCrouch() {
-  const float currentHeight = m_capsuleComponent->GetScaledCapsuleHalfHeight();
-  float targetHeight = (m_wantsToCrouch)
-                         ? m_characterMovementComponent->GetCrouchedHalfHeight()
-                         : m_cachedStandingHeight;
-  float crouchSpeedModifier = 1.0;
+// Works out the state from the current inputs and fires the transition. Called from the input
+// callbacks and whenever a blend settles, never polled.
+void APlayerCharacter::UpdateMovementState() {
+  if (!m_isSliding) {
+    if (m_isSprinting) {
+      if (m_isCrouching) m_wantsToCrouch = false;
+      // a capsule stuck under something low stays crouched until the movement component finds room
+      TransitionTo(bIsCrouched ? EMovementState::kCrouching : EMovementState::kRunning);
+    }
+    else if (m_wantsToCrouch || bIsCrouched) {
+      TransitionTo(EMovementState::kCrouching);
+    }
+    else {
+      TransitionTo(EMovementState::kWalking);
+    }
+  }
+  // the input, not the state: the movement component keeps trying to stand up while this is off
+  m_characterMovementComponent->bWantsToCrouch = m_wantsToCrouch || m_isSliding;
 
   if (m_isSprinting && !m_isCrouching && m_wantsToCrouch) {
     StartSlide();
-    return;
   }
+  else {
+    StartCrouchBlend();
+  }
+  RefreshTickEnabled();
+}
+
+void APlayerCharacter::TransitionTo(EMovementState state) {
+  if (m_movementState == state) return;
+  m_movementState = state;
+  // the movement component picks the speed from this and the crouch, both go to the server with every move
+  m_characterMovementComponent->SetWantsToSprint(state == EMovementState::kRunning);
+}
 
+float APlayerCharacter::GetTargetCrouchHeight() const {
+  // what the movement component gave the capsule, a blocked stand up keeps the crouched height
+  float targetHeight = bIsCrouched ? m_characterMovementComponent->GetCrouchedHalfHeight() : m_cachedStandingHeight;
   if (m_slideOverride) {
-    crouchSpeedModifier = 2;
     targetHeight -= 10;
   }
+  return targetHeight;
+}
+
+void APlayerCharacter::StartCrouchBlend() {
+  // also mid-blend, the eye always follows the latest capsule
+  if (m_crouchBlendActive) return;
+  if (FMath::Abs(m_crouchHeight - GetTargetCrouchHeight()) < 0.1f) {
+    m_isCrouching = bIsCrouched;
+    return;
+  }
+  m_crouchBlendActive = true;
+}
 
-  GEngine->AddOnScreenDebugMessage(-1, 0.f, FColor::Red, FString::Printf(TEXT("%f"), crouchSpeedModifier));
+// The movement component resizes the capsule inside the move, on the server and the simulated proxies
+// as well, and keeps the feet where they are. Only the eye is blended from here.
+void APlayerCharacter::OnStartCrouch(float HalfHeightAdjust, float ScaledHalfHeightAdjust) {
+  Super::OnStartCrouch(HalfHeightAdjust, ScaledHalfHeightAdjust);
+  FollowCrouch();
+}
+
+void APlayerCharacter::OnEndCrouch(float HalfHeightAdjust, float ScaledHalfHeightAdjust) {
+  Super::OnEndCrouch(HalfHeightAdjust, ScaledHalfHeightAdjust);
+  FollowCrouch();
+}
 
-  float heightValue =
-    UKismetMathLibrary::Lerp(currentHeight, targetHeight,
-                             GetWorld()->DeltaTimeSeconds * (m_crouchSmoothValue * crouchSpeedModifier));
+void APlayerCharacter::FollowCrouch() {
+  // the resize itself happened in the movement component
+  CHARACTER_STAT_CALL(SetCapsuleHalfHeight);
+  if (!HasActorBegunPlay()) return;
+  // the states come from the input, where there is none (server, simulated proxies) only the eye follows.
+  // Touching the states there would change the speeds of the move the server is running
+  if (IsLocallyControlled()) {
+    UpdateMovementState();
+    return;
+  }
+  StartCrouchBlend();
+  RefreshTickEnabled();
+}
+
+bool APlayerCharacter::NeedsTick() const {
+  // replays are driven from Tick
+  if (m_inputPlayer) return true;
+#if ENABLE_CHARACTER_DEBUG
+  // the overlay is refreshed from Tick
+  if (FCharacterDebugOverlay::IsEnabled(ECharacterDebug::kOverlay)) return true;
+#endif
+  // cooldown and mana are worked out on demand by the ability component and need no tick
+  return m_crouchBlendActive || m_isSliding || m_shiftToLocation || m_abilityHeld || m_presentPending ||
+    (m_fovReturnTimer.IsValid() && IsLocalViewer());
+}
+
+void APlayerCharacter::SetSignificance(ECharacterSignificance significance) {
+  if (m_significance == significance) return;
+  m_significance = significance;
+  SetActorTickInterval(UCharacterSignificanceSubsystem::GetTickInterval(significance));
+  // coarse tiers run variable steps, whatever the clock had banked is stale once they are back
+  m_fixedStepClock.Reset(m_fixedStepRate, m_maxSubSteps);
+}
+
+// Idle characters switch their own tick off, anything that starts a blend switches it back on
+void APlayerCharacter::RefreshTickEnabled() {
+  const bool needsTick = NeedsTick();
+  if (IsActorTickEnabled() != needsTick) {
+    SetActorTickEnabled(needsTick);
+  }
+}
+
+void APlayerCharacter::HandleCrouch(float deltaTime) {
+  CHARACTER_STAT_SCOPE(HandleCrouch);
+  const float currentHeight = m_crouchHeight;
+  const float targetHeight = GetTargetCrouchHeight();
+  const float crouchSpeedModifier = (m_slideOverride) ? 2 : 1;
+
+  CHARACTER_DEBUG_VALUE(m_debugOverlay, kDebugCrouchSpeed, "Crouch Speed", crouchSpeedModifier);
+
+  // far away nobody sees the eye height move, it goes straight to the target
+  const float blend = m_significance == ECharacterSignificance::kFar
+                        ? 1.f
+                        : FMath::Min(deltaTime * (m_crouchSmoothValue * crouchSpeedModifier), 1.f);
+  float heightValue = UKismetMathLibrary::Lerp(currentHeight, targetHeight, blend);
   if (UKismetMathLibrary::Abs(heightValue - targetHeight) < 0.1f) {
     if (m_slideOverride) {
+      // keeps blending back up to the regular crouch height
       m_slideOverride = false;
       return;
     }
     heightValue = targetHeight;
-    m_isCrouching = m_wantsToCrouch;
-  }
-  m_capsuleComponent->SetCapsuleHalfHeight(heightValue);
-}
-
-void APlayerCharacter::HandleSpeed() {
-  if (!m_isSliding) {
-    if (m_isSprinting) {
-      if (m_isCrouching) m_wantsToCrouch = false;
-      m_movementState = EMovementState::kRunning;
-    }
-    else if (m_wantsToCrouch) {
-      m_movementState = EMovementState::kCrouching;
-    }
-    else {
-      m_movementState = EMovementState::kWalking;
-    }
+    m_isCrouching = bIsCrouched;
+    m_crouchBlendActive = false;
   }
-
-  switch (m_movementState) {
-  case EMovementState::kWalking:
-    m_characterMovementComponent->MaxWalkSpeed = m_baseSpeed;
-    break;
-  case EMovementState::kRunning: m_characterMovementComponent->MaxWalkSpeed = m_maxSprintSpeed;
-    break;
-  case EMovementState::kCrouching:
-    m_characterMovementComponent->MaxWalkSpeed = m_baseSpeed / 1.75;
-    break;
-  case EMovementState::kSliding:
-    m_characterMovementComponent->MaxWalkSpeed = GetVelocity().Length() - (m_slideTime * GetWorld()->DeltaTimeSeconds);
-    if (m_characterMovementComponent->Velocity.Length() < m_baseSpeed / 1.75) {
-      EndSlide();
-    }
-    break;
+  m_crouchHeight = heightValue;
+  if (!m_crouchBlendActive && IsLocallyControlled()) {
+    UpdateMovementState();
   }
 }
 
-void APlayerCharacter::RechargeMana(float t) {
-  if(m_abilityMana <= 100)
-  m_abilityMana += t * m_rechargeRate;
-}
-
-
 void APlayerCharacter::StartSlide() {
   if (m_isSliding) return;
+  // the slide keeps the crouch wanted (UpdateMovementState), the movement component shrinks the capsule
+  // on the same move it adds the boost
   m_isSliding = true;
   m_isSprinting = false;
 
 
-  FVector currentVelocity = GetVelocity();
-  currentVelocity.Z = 0;
-  FVector desiredDirectionVec = currentVelocity;
-  desiredDirectionVec += GetActorForwardVector() * (m_slideBoost * 100);;
-  m_characterMovementComponent->Velocity = desiredDirectionVec;
+  // boosted and slowed down by the movement component, on the client and the server alike
+  m_characterMovementComponent->RequestSlide();
   m_slideOverride = true;
-  m_movementState = EMovementState::kSliding;
+  TransitionTo(EMovementState::kSliding);
+  m_crouchBlendActive = true;
 }
 
 void APlayerCharacter::EndSlide() {
   m_isSliding = false;
-  m_movementState = EMovementState::kCrouching;
+  TransitionTo(EMovementState::kCrouching);
+  UpdateMovementState();
 }
 
 
 void APlayerCharacter::Jump() {
-  if (m_characterMovementComponent->IsCrouching() || m_isCrouching) {
-    m_isCrouching = false;
-    m_characterMovementComponent->bWantsToCrouch = false;
+  RecordInput(ECharacterInput::kJump, FInputActionValue(true));
+  // a jump stands up, out of a slide as well. The movement component stands the capsule up in the air
+  if (m_isSliding) {
+    m_characterMovementComponent->StopSlide();
+    m_isSliding = false;
   }
+  m_wantsToCrouch = false;
   Super::Jump();
+  UpdateMovementState();
+}
+
+bool APlayerCharacter::CanJumpInternal_Implementation() const {
+  // the engine won't jump while crouched, Jump lets go of the crouch but the capsule only stands up
+  // on the same move the jump is checked on
+  return JumpIsAllowedInternal();
 }
 
 void APlayerCharacter::Thrust() {
+  RecordInput(ECharacterInput::kThrust, FInputActionValue(true));
 
   m_testBool = true;
   m_shiftLocation = m_cameraComponent->GetComponentLocation() + m_cameraComponent->GetForwardVector() * 400;
@@ -290,203 +860,329 @@ void APlayerCharacter::Thrust() {
   // m_movementState = EMovementState::kSliding;
 }
 void APlayerCharacter::StartAbility() {
-  if(m_coolDownTimer < m_coolDownTimeAbility) {
+  CHARACTER_STAT_SCOPE(StartAbility);
+  RecordInput(ECharacterInput::kStartAbility, FInputActionValue(true));
+  m_abilityHeld = true;
+  RefreshTickEnabled();
+  if(!m_shiftAbility->IsReady(m_shiftAbilityHandle)) {
     m_canShift = false;
     return;
   }
-  // TODO: Move ability to its only class/interface
-  // SHIFT Ability
-  FVector start = m_cameraComponent->GetComponentLocation();
-  FVector end = start + m_cameraComponent->GetForwardVector() * 800;
-  FVector endLocation;
-  DrawDebugLine(GetWorld(), start, end, FColor::Red);
-  FHitResult hitResult;
-  TArray<AActor*> actorResults;
-  TArray<FOverlapResult> results;
-  TArray<TEnumAsByte<EObjectTypeQuery>> objectQuery;
-  bool overrideLocation = false; // quick hack
 
   // VFX
-  if(VFX == nullptr) {
-    VFX = GetWorld()->SpawnActor(ShiftVFX);
+  // still streaming in, the shift just goes without it
+  if(VFX == nullptr && ShiftVFX.Get() != nullptr) {
+    VFX = GetWorld()->GetSubsystem<UActorPoolSubsystem>()->Acquire(ShiftVFX.Get(), FTransform::Identity);
   }
 
-  
-  // TODO: Create preprocessor directive 
-  // to store multiple bools in on byte to save some memory
-  std::bitset<8> flagChecks{0b0000'0000};
-
-  FHitResult OutHitResult;
-  objectQuery.Add(UEngineTypes::ConvertToObjectType(ECC_Visibility));
-
-  flagChecks.set(0, GetWorld()->LineTraceSingleByChannel(hitResult, start, end, ECC_Visibility));
-
-  // first contact with something
-  if (flagChecks[0]) {
-    bool isSurfaceNormalZ = (FMath::Abs(hitResult.Normal.X) < FLT_EPSILON && FMath::Abs(hitResult.Normal.Y) <
-      FLT_EPSILON);
-
-    DrawDebugSphere(GetWorld(), hitResult.Location, 10, 10, FColor::Yellow);
-
-    // handling the wall/climbable check
-    FHitResult surfaceResult;
-    float scaleWallThreshold = m_capsuleComponent->GetUnscaledCapsuleHalfHeight() / 2;
-    FVector lineStart = hitResult.ImpactPoint + (GetActorForwardVector() * m_capsuleComponent->
-      GetUnscaledCapsuleRadius());
-    FVector lineEnd = lineStart + FVector::UpVector * scaleWallThreshold;
-    // TODO: need to convert this to a reusable bool
-    if (!isSurfaceNormalZ && UKismetSystemLibrary::LineTraceSingle(GetWorld(), lineEnd, lineStart,
-                                                                   UEngineTypes::ConvertToTraceType(ECC_Visibility),
-                                                                   false, actorResults,
-                                                                   EDrawDebugTrace::ForOneFrame, surfaceResult,
-                                                                   false)) {
-      // DrawDebugSphere(
-      //   GetWorld(), surfaceResult.Location + FVector::UpVector * m_capsuleComponent->GetUnscaledCapsuleHalfHeight(), 20,
-      //   20, FColor::Green);
-      FVector sphereStart = surfaceResult.Location + FVector::UpVector * m_capsuleComponent->
-        GetUnscaledCapsuleHalfHeight();
-      FVector sphereEnd = surfaceResult.Location + FVector::UpVector * m_capsuleComponent->
-        GetUnscaledCapsuleHalfHeight() * 2;
-
-
-      // Checks if clipping with object from mental location
-      flagChecks.set(1, UKismetSystemLibrary::SphereTraceSingle(GetWorld(), sphereStart, sphereEnd,
-                                                                m_capsuleComponent->GetUnscaledCapsuleRadius(),
-                                                                UEngineTypes::ConvertToTraceType(ECC_Visibility),
-                                                                false,
-                                                                actorResults,
-                                                                EDrawDebugTrace::ForOneFrame, OutHitResult, true));
-
-      if (!flagChecks[1]) {
-        endLocation = sphereStart;
-        overrideLocation = true;
-      }
-    }
-    // ----
-
-
-    // end = hitResult.Location + (hitResult.Normal * m_capsuleComponent->GetUnscaledCapsuleHalfHeight()/((mod)? 1 : 2));
-    GEngine->AddOnScreenDebugMessage(-1, 0, FColor::Red,
-                                     FString::Printf(
-                                       TEXT("Normal - X: %f, Y: %f, Z: %f"), hitResult.Normal.X, hitResult.Normal.Y,
-                                       hitResult.Normal.Z));
-
-
-    FVector capsulePositionOffset = hitResult.Location + (hitResult.Normal * m_capsuleComponent->
-      GetUnscaledCapsuleHalfHeight() / (
-        (isSurfaceNormalZ) ? 1 : 2) + FVector::UpVector);
-
-
-    // location sweep
-    flagChecks.set(2, UKismetSystemLibrary::CapsuleTraceSingle(
-                     GetWorld(),
-                     capsulePositionOffset,
-                     capsulePositionOffset, m_capsuleComponent->GetUnscaledCapsuleRadius(),
-                     m_capsuleComponent->GetUnscaledCapsuleHalfHeight(),
-                     ETraceTypeQuery::TraceTypeQuery1, false, actorResults,
-                     EDrawDebugTrace::ForOneFrame, hitResult, true));
-
-    // mainly checks if contact with the wall and the capsule clips with the floor, is it still valid by check
-    // the area above.
-    if (flagChecks[2]) {
-      // UE_LOG(LogTemp,Warning,TEXT("Clipping"));
-      flagChecks.set(3, UKismetSystemLibrary::SphereTraceSingle(
-                       GetWorld(), capsulePositionOffset + (FVector::UpVector * m_capsuleComponent->
-                         GetUnscaledCapsuleHalfHeight() * .25f),
-                       capsulePositionOffset + (FVector::UpVector * m_capsuleComponent->GetUnscaledCapsuleHalfHeight() *
-                         1.75f),
-                       m_capsuleComponent->GetUnscaledCapsuleRadius(),
-                       UEngineTypes::ConvertToTraceType(ECC_Visibility),
-                       false,
-                       actorResults,
-                       EDrawDebugTrace::ForOneFrame, OutHitResult, true));
-    }
+  if (m_asyncShiftTrace && !m_shiftCandidateSearch) {
+    StartAbilityAsync();
+    return;
+  }
+  ResolveShiftTarget();
+}
 
-    // between the player and the desired location sweep
-    if (flagChecks[2] && (flagChecks[1] || flagChecks[3])) {
-      UKismetSystemLibrary::CapsuleTraceSingle(GetWorld(),
-                                               start,
-                                               end,
-                                               m_capsuleComponent->GetUnscaledCapsuleRadius(),
-                                               m_capsuleComponent->GetUnscaledCapsuleHalfHeight(),
-                                               ETraceTypeQuery::TraceTypeQuery1, false, actorResults,
-                                               EDrawDebugTrace::ForOneFrame, hitResult, true);
-      overrideLocation = true;
-      endLocation = hitResult.Location;
-
-      
-    }
-    if (!overrideLocation) {
-      endLocation = capsulePositionOffset;
-    }
+void APlayerCharacter::ResolveShiftTarget() {
+  // TODO: Move ability to its only class/interface
+  // SHIFT Ability
+  SHIFT_ALLOCATION_SCOPE();
+  // batch hit buffers and the touched components live until the solution is stored
+  FMemMark scratch(FMemStack::Get());
+#if ENABLE_CHARACTER_DEBUG
+  FWorldShiftCollisionQuery query(GetWorld(), m_shiftTraceParams, &m_debugOverlay);
+#else
+  FWorldShiftCollisionQuery query(GetWorld(), m_shiftTraceParams, nullptr);
+#endif
+  const FShiftQueryParams params = MakeShiftQueryParams();
+  CHARACTER_DEBUG_LINE(m_debugOverlay, ToFVector(params.start), ToFVector(params.end), FColor::Red);
+  // the index is tried first when it is on, the cascade or the candidates answer otherwise
+  const uint8 solveMode = (m_shiftCandidateSearch ? kShiftSolveCandidates : kShiftSolveCascade) |
+    (m_useShiftLandingIndex ? kShiftSolveIndex : 0);
+  FShiftSolution solution;
+  if (m_shiftTargetCache.Lookup(params, solveMode, GetWorld()->GetTimeSeconds(), solution)) {
+    ApplyShiftSolution(solution);
+    return;
+  }
+  [[maybe_unused]] const uint64 solveStart = FPlatformTime::Cycles64();
+  if (!SolveFromLandingIndex(query, params, solution)) {
+    solution = m_shiftCandidateSearch ? FShiftLandingSolver::SolveCandidates(query, params)
+                                      : FShiftLandingSolver::Solve(query, params);
   }
+  CHARACTER_STAT_SHIFT_SOLVE(solution.branch, FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - solveStart));
+  m_shiftTargetCache.Store(params, solveMode, GetWorld()->GetTimeSeconds(), solution,
+                           query.GetTouchedComponents());
+  ApplyShiftSolution(solution);
+#if ENABLE_CHARACTER_STATS
+  NoteShiftWarmedUp();
+#endif
+}
 
-  else {
-    DrawDebugSphere(GetWorld(), end, 10, 10, FColor::Red);
-    // DrawCapsuleOverlap(GetWorld(), end, m_capsuleComponent->GetUnscaledCapsuleHalfHeight(),
-    //                    m_capsuleComponent->GetUnscaledCapsuleRadius(), FQuat::Identity, results, 0);
-
-    flagChecks.set(1, UKismetSystemLibrary::CapsuleTraceSingle(GetWorld(), end, end,
-                                                               m_capsuleComponent->GetUnscaledCapsuleRadius(),
-                                                               m_capsuleComponent->GetUnscaledCapsuleHalfHeight(),
-                                                               ETraceTypeQuery::TraceTypeQuery1, false, actorResults,
-                                                               EDrawDebugTrace::ForOneFrame, hitResult, true));
-
-    if (flagChecks[1]) {
-      flagChecks.set(2, UKismetSystemLibrary::SphereTraceSingle(
-                       GetWorld(), end + (FVector::UpVector * m_capsuleComponent->GetUnscaledCapsuleHalfHeight() * .5),
-                       end + (FVector::UpVector * m_capsuleComponent->GetUnscaledCapsuleHalfHeight() * 2),
-                       m_capsuleComponent->GetUnscaledCapsuleRadius(),
-                       UEngineTypes::ConvertToTraceType(ECC_Visibility),
-                       false,
-                       actorResults,
-                       EDrawDebugTrace::ForOneFrame, OutHitResult, true));
-
-      if (flagChecks[2]) {
-        flagChecks.set(3, UKismetSystemLibrary::CapsuleTraceSingle(GetWorld(),
-                                                                   start,
-                                                                   end,
-                                                                   m_capsuleComponent->GetUnscaledCapsuleRadius(),
-                                                                   m_capsuleComponent->GetUnscaledCapsuleHalfHeight(),
-                                                                   ETraceTypeQuery::TraceTypeQuery1, false,
-                                                                   actorResults,
-                                                                   EDrawDebugTrace::ForOneFrame, hitResult, true));
-        end = hitResult.Location; // this still works cause order of operation
-      }
-    }
-    endLocation = end;
+#if ENABLE_CHARACTER_STATS
+void APlayerCharacter::NoteShiftWarmedUp() {
+  if (m_shiftAllocWarmup == MAX_uint64) {
+    m_shiftAllocWarmup = FShiftAllocationCounter::GetCount();
   }
-  
-  if (flagChecks.all()) {
+}
+
+uint64 APlayerCharacter::RunShiftAllocationBench(int32 resolves) {
+  if (!FShiftAllocationCounter::IsInstalled()) {
+    UE_LOG(LogPlayerCharacter, Warning, TEXT("Shift allocations can't be counted, start with -ShiftAllocLimit=<n>"));
+    return 0;
+  }
+  // every resolve goes through the whole solve, a cache hit would prove nothing. The first few may
+  // still grow the scratch stack and the scene query buffers
+  for (int32 i = 0; i < 4; i++) {
+    m_shiftTargetCache.Invalidate();
+    ResolveShiftTarget();
+  }
+  const uint64 start = FShiftAllocationCounter::GetCount();
+  for (int32 i = 0; i < resolves; i++) {
+    m_shiftTargetCache.Invalidate();
+    ResolveShiftTarget();
+  }
+  const uint64 allocations = FShiftAllocationCounter::GetCount() - start;
+  UE_LOG(LogPlayerCharacter, Display, TEXT("%d shift resolves after warming up: %llu heap allocations, %.2f each"),
+         resolves, allocations, static_cast<double>(allocations) / resolves);
+  return allocations;
+}
+#endif
+
+bool APlayerCharacter::SolveFromLandingIndex(IShiftCollisionQuery& query, const FShiftQueryParams& params,
+                                             FShiftSolution& outSolution) const {
+  if (!m_useShiftLandingIndex) return false;
+  const UShiftLandingIndexSubsystem* indexSubsystem = GetWorld()->GetSubsystem<UShiftLandingIndexSubsystem>();
+  const FShiftLandingIndex* index = indexSubsystem != nullptr ? indexSubsystem->GetIndex() : nullptr;
+  if (index == nullptr || !index->Query(params, outSolution)) return false;
+
+  // the bake only saw static collision, one sweep along the way for whatever moved in since
+  FShiftHit hit;
+  outSolution.queryCount = 1;
+  return !query.CapsuleSweep(params.start, outSolution.location, params.capsuleRadius, params.capsuleHalfHeight,
+                             hit);
+}
+
+void APlayerCharacter::InvalidateShiftCache() {
+  m_shiftTargetCache.Invalidate();
+}
+
+FShiftQueryParams APlayerCharacter::MakeShiftQueryParams() const {
+  FShiftQueryParams params;
+  const FVector start = m_cameraComponent->GetComponentLocation();
+  params.start = ToShiftVec(start);
+  params.end = ToShiftVec(start + m_cameraComponent->GetForwardVector() * 800);
+  params.forward = ToShiftVec(GetActorForwardVector());
+  params.capsuleRadius = m_capsuleComponent->GetUnscaledCapsuleRadius();
+  params.capsuleHalfHeight = m_capsuleComponent->GetUnscaledCapsuleHalfHeight();
+  return params;
+}
+
+void APlayerCharacter::ApplyShiftSolution(const FShiftSolution& solution) {
+  CHARACTER_DEBUG_SPHERE(m_debugOverlay, ToFVector(solution.aimLocation), 10,
+                         (solution.flags & 1) ? FColor::Yellow : FColor::Red);
+  m_lastShiftBranch = solution.branch;
+  m_lastShiftFlags = solution.flags;
+  if (!solution.canShift) {
     //UE_LOG(LogTemp, Error, TEXT("No valid location")); // AKA the last valid option
     m_canShift = false; // for now
   }
   else {
     m_canShift = true;
-    m_shiftLocation = endLocation;
-    DrawDebugSphere(GetWorld(), m_shiftLocation, m_capsuleComponent->GetUnscaledCapsuleRadius(), 20, FColor::Emerald);
+    m_shiftLocation = ToFVector(solution.location);
+    CHARACTER_DEBUG_SPHERE(m_debugOverlay, m_shiftLocation, m_capsuleComponent->GetUnscaledCapsuleRadius(),
+                           FColor::Emerald);
   }
+}
 
+// Async variant of ResolveShiftTarget, runs the same solver against async trace results (see
+// FAsyncShiftCollisionQuery). Each round issues every query it can reach speculatively, so the
+// chain usually settles in two or three frames.
+void APlayerCharacter::StartAbilityAsync() {
+  // keep the current chain going, the next one starts once this one lands
+  if (m_asyncShiftInFlight) return;
+  SHIFT_ALLOCATION_SCOPE();
+
+  m_asyncShiftParams = MakeShiftQueryParams();
+  FShiftSolution solution;
+  if (m_shiftTargetCache.Lookup(m_asyncShiftParams, kShiftSolveAsync, GetWorld()->GetTimeSeconds(), solution)) {
+    m_asyncShiftHasResult = true;
+    ApplyShiftSolution(solution);
+    return;
+  }
 
- 
+  m_asyncShiftInFlight = true;
+  m_asyncShiftQuery.Reset(GetWorld(), m_shiftTraceParams, &m_shiftTraceDelegate);
+  RunAsyncShiftSolve();
+}
+
+void APlayerCharacter::RunAsyncShiftSolve() {
+  SHIFT_ALLOCATION_SCOPE();
+  m_asyncShiftQuery.SetSpeculateBlocking(false);
+  [[maybe_unused]] const uint64 solveStart = FPlatformTime::Cycles64();
+  const FShiftSolution solution = FShiftLandingSolver::Solve(m_asyncShiftQuery, m_asyncShiftParams);
+  if (m_asyncShiftQuery.HasPending()) {
+    // walk the blocked side of the sweeps too so both get issued this round
+    m_asyncShiftQuery.SetSpeculateBlocking(true);
+    FShiftLandingSolver::Solve(m_asyncShiftQuery, m_asyncShiftParams);
+    return;
+  }
+
+  // nothing new was needed, every answer was real. Only the final pass is timed, the earlier rounds
+  // mostly wait on the trace results
+  CHARACTER_STAT_SHIFT_SOLVE(solution.branch, FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - solveStart));
+  m_asyncShiftInFlight = false;
+  m_asyncShiftHasResult = true;
+  m_shiftTargetCache.Store(m_asyncShiftParams, kShiftSolveAsync, GetWorld()->GetTimeSeconds(), solution,
+                           m_asyncShiftQuery.GetTouchedComponents());
+  ApplyShiftSolution(solution);
+#if ENABLE_CHARACTER_STATS
+  NoteShiftWarmedUp();
+#endif
+}
+
+void APlayerCharacter::OnShiftTraceDone(const FTraceHandle& handle, FTraceDatum& datum) {
+  if (m_asyncShiftInFlight && m_asyncShiftQuery.Receive(datum)) {
+    RunAsyncShiftSolve();
+  }
 }
 
 void APlayerCharacter::ExecuteAbility() {
+  CHARACTER_STAT_SCOPE(ExecuteAbility);
+  RecordInput(ECharacterInput::kExecuteAbility, FInputActionValue(true));
+  m_abilityHeld = false;
   if(VFX != nullptr) {
-    VFX->Destroy();
+    GetWorld()->GetSubsystem<UActorPoolSubsystem>()->Release(VFX);
     VFX = nullptr;
   }
+  // released before any chain landed, answer synchronously so the shift is never dropped
+  if (m_asyncShiftTrace && !m_shiftCandidateSearch) {
+    if (!m_asyncShiftHasResult && m_shiftAbility->IsReady(m_shiftAbilityHandle)) {
+      ResolveShiftTarget();
+    }
+    m_asyncShiftQuery.Cancel();
+    m_asyncShiftInFlight = false;
+    m_asyncShiftHasResult = false;
+  }
   m_testBool = true;
   m_cacheLocation = GetActorLocation();
   if (m_canShift) {
-    if(m_abilityMana - m_abilityCost  < 0) {
+    // spends the mana and starts the cooldown
+    if(!m_shiftAbility->TryActivate(m_shiftAbilityHandle)) {
+      RecordShiftTelemetry(m_shiftAbility->IsReady(m_shiftAbilityHandle) ? ETelemetryShiftOutcome::kNoMana
+                                                                          : ETelemetryShiftOutcome::kNotReady);
       return;
     }
-    
-    m_shiftToLocation = true;
-    m_abilityMana -= m_abilityCost;
+
+    // remote clients predict the shift and let the server confirm it
+    if (!HasAuthority()) {
+      FShiftRequest request;
+      request.target = m_shiftLocation;
+      request.shiftId = ++m_shiftSequence;
+      FShiftNetStats::Get().AddRequest(request);
+      ServerExecuteShift(request);
+    }
+
+    StartShift(m_shiftLocation);
+    RecordShiftTelemetry(ETelemetryShiftOutcome::kShifted);
     // SetActorLocation(m_shiftLocation);
     m_canShift = false;
-    m_coolDownTimer = 0;
+
+    if (HasAuthority()) {
+      UpdateShiftNetState(++m_shiftSequence);
+    }
+  }
+  else {
+    RecordShiftTelemetry(m_shiftAbility->IsReady(m_shiftAbilityHandle) ? ETelemetryShiftOutcome::kNoTarget
+                                                                        : ETelemetryShiftOutcome::kNotReady);
+  }
+  RefreshTickEnabled();
+}
+
+void APlayerCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const {
+  Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+  DOREPLIFETIME_CONDITION(APlayerCharacter, m_shiftNetState, COND_OwnerOnly);
+}
+
+FShiftNetState APlayerCharacter::MakeShiftNetState(uint8 shiftId) const {
+  FShiftNetState state;
+  state.shiftId = shiftId;
+  state.mana = FShiftNetState::QuantizeMana(m_shiftAbility->GetMana());
+  state.coolDown = FShiftNetState::QuantizeCoolDown(m_shiftAbility->GetCoolDownElapsed(m_shiftAbilityHandle));
+  return state;
+}
+
+void APlayerCharacter::UpdateShiftNetState(uint8 shiftId) {
+  m_shiftNetState = MakeShiftNetState(shiftId);
+  FShiftNetStats::Get().AddStateUpdate(m_shiftNetState);
+}
+
+bool APlayerCharacter::IsValidShiftRequest(const FShiftRequest& request) const {
+  if (!m_shiftAbility->CanActivate(m_shiftAbilityHandle)) return false;
+
+  // the aim ray is 800 long and the landing spot can sit up to a capsule height off it, plus
+  // whatever the client moved since the server last heard from it
+  const float radius = m_capsuleComponent->GetUnscaledCapsuleRadius();
+  const float halfHeight = m_capsuleComponent->GetUnscaledCapsuleHalfHeight();
+  const float reach = 800 + halfHeight * 2 + BaseEyeHeight + m_maxSprintSpeed * .25f;
+  if (FVector::DistSquared(GetActorLocation(), request.target) > FMath::Square(reach)) return false;
+
+  // shrunk a little, landing spots from the sweeps sit right against geometry
+  const FCollisionQueryParams params(SCENE_QUERY_STAT(ShiftValidate), false, this);
+  return !GetWorld()->OverlapBlockingTestByChannel(request.target, FQuat::Identity, ECC_Visibility,
+                                                   FCollisionShape::MakeCapsule(radius * .8f, halfHeight * .8f),
+                                                   params);
+}
+
+void APlayerCharacter::ServerExecuteShift_Implementation(const FShiftRequest& request) {
+  if (!IsValidShiftRequest(request)) {
+    FShiftNetStats::Get().rejected++;
+    // the client already spent the mana and moved, it gets both back: the resources with the answer, the
+    // position as a regular movement correction on its next move
+    m_characterMovementComponent->ForceClientCorrection();
+    ClientRejectShift(MakeShiftNetState(request.shiftId));
+    return;
+  }
+  FShiftNetStats::Get().accepted++;
+
+  m_shiftAbility->TryActivate(m_shiftAbilityHandle);
+  m_canShift = false;
+  // the server runs the same root motion, the client's moves are checked against it like any other
+  StartShift(request.target);
+  UpdateShiftNetState(request.shiftId);
+}
+
+void APlayerCharacter::ClientRejectShift_Implementation(const FShiftNetState& state) {
+  // a newer prediction is already on its way, the server will answer that one too
+  if (state.shiftId != m_shiftSequence) return;
+  FShiftNetStats::Get().corrections++;
+  // the position comes back through the movement component's correction, which also replays the moves
+  // made since without the shift's root motion
+  m_characterMovementComponent->RemoveRootMotionSourceByID(m_shiftRootMotionId);
+  if (m_shiftToLocation) {
+    EndShift();
+  }
+  // the server never spent anything for this one
+  ApplyShiftNetState(state);
+  RefreshTickEnabled();
+}
+
+void APlayerCharacter::OnRep_ShiftNetState() {
+  // only take the server's resources once it caught up with our latest prediction
+  if (IsLocallyControlled() && m_shiftNetState.shiftId != m_shiftSequence) return;
+  ApplyShiftNetState(m_shiftNetState);
+}
+
+void APlayerCharacter::ApplyShiftNetState(const FShiftNetState& state) {
+  // the first update can arrive before BeginPlay registered the ability
+  if (m_shiftAbilityHandle == INDEX_NONE) return;
+
+  const float mana = FShiftNetState::DequantizeMana(state.mana);
+  const float localCoolDown = m_shiftAbility->GetCoolDownElapsed(m_shiftAbilityHandle);
+  float coolDown = FShiftNetState::DequantizeCoolDown(state.coolDown);
+  // past the top of the range the local time is as good as any
+  if (FShiftNetState::IsCoolDownSaturated(state.coolDown) && localCoolDown > coolDown) {
+    coolDown = localCoolDown;
+  }
+  if (FMath::Abs(mana - m_shiftAbility->GetMana()) > 1.f || FMath::Abs(coolDown - localCoolDown) > GetShiftDuration()) {
+    m_shiftAbility->SyncState(m_shiftAbilityHandle, mana, coolDown);
   }
 }
@@ -6,43 +6,86 @@
 #include "InputMappingContext.h"
 #include "Camera/CameraComponent.h"
 #include "GameFramework/Character.h"
+#include "CharacterDebug.h"
+#include "CharacterSignificance.h"
+#include "CharacterInputRecorder.h"
+#include "CharacterTelemetry.h"
+#include "FixedStepClock.h"
+#include "LookLatch.h"
+#include "ShiftCollisionQuery.h"
+#include "ShiftNetState.h"
+#include "ShiftTargetCache.h"
+#include "TimerWheel.h"
+#include "TimeLoopRecorder.h"
 #include "ShiftAbilityComponent.h"
 #include "PlayerCharacter.generated.h"
 
 class UInputMappingContext;
 class UInputAction;
+class UPlayerMovementComponent;
 
 UCLASS()
 class FPS_CONTROLLER_API APlayerCharacter : public ACharacter {
   GENERATED_BODY()
+  // load test bots press the same private handlers a player's input reaches
+  friend class ALoadTestBotController;
+  // the automation tests drive and check the same private state, see PlayerCharacterTests.cpp
+  friend class FPlayerCharacterTestWorld;
 
 public:
   // Sets default values for this character's properties
-  APlayerCharacter();
+  explicit APlayerCharacter(const FObjectInitializer& objectInitializer);
   // Called every frame
   virtual void Tick(float DeltaTime) override;
   // Called to bind functionality to input
   virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
+  virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+  // the pawn someone is looking through, only that one needs camera work
+  bool IsLocalViewer() const { return IsLocallyControlled() && IsPlayerControlled(); }
+  // set by UCharacterSignificanceSubsystem, scales tick rate and blend work
+  void SetSignificance(ECharacterSignificance significance);
+  ECharacterSignificance GetSignificance() const { return m_significance; }
+  // only on the local viewer
+  FLookLatch* GetLookLatch() const { return m_lookLatch.Get(); }
+  // what UCharacterTelemetrySubsystem samples every frame, and the tuning it writes once
+  void FillTelemetry(FTelemetryFrame& row) const;
+  void FillTelemetry(FTelemetryCharacter& row) const;
 
 
 
-  UPROPERTY(EditAnywhere, BlueprintReadWrite, Category="ShiftAB")
-  float m_abilityMana = 100;
-  
   UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="ShiftAB")
   FVector m_shiftLocation;
 
+  // call when collision near the character changed in a way the shift cache can't see
+  // (e.g. a door closing that the last target did not touch)
+  UFUNCTION(BlueprintCallable, Category="ShiftAB")
+  void InvalidateShiftCache();
+
+  // puts the character back where it was seconds ago (clamped to what the loop still holds), for the
+  // local player only. A slide comes back as the crouch it ends in, a shift in progress is dropped.
+  UFUNCTION(BlueprintCallable, Category="Player Params")
+  bool RewindTimeLoop(float seconds);
+
+#if ENABLE_CHARACTER_STATS
+  // runs full shift resolves from the current view and logs the heap allocations they made after warming up,
+  // which it also returns. Needs the counter, see FShiftAllocationCounter
+  uint64 RunShiftAllocationBench(int32 resolves);
+#endif
+
   
 
 protected:
   // Called when the game starts or when spawned
   virtual void BeginPlay() override;
+  virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+  virtual void NotifyControllerChanged() override;
 
 
 
 private:
   APlayerController* m_playerController;
-  UCharacterMovementComponent* m_characterMovementComponent;
+  UPlayerMovementComponent* m_characterMovementComponent;
   UCapsuleComponent* m_capsuleComponent;
 
   UPROPERTY(EditDefaultsOnly)
@@ -51,6 +94,11 @@ private:
   UPROPERTY(EditAnywhere)
   UShiftAbilityComponent* m_shiftAbility;
 
+  // cost, cooldown and recharge delay of the shift
+  UPROPERTY(EditAnywhere, Category="ShiftAB")
+  UAbilityData* m_shiftAbilityData;
+  int32 m_shiftAbilityHandle;
+
 
 
 
@@ -59,20 +107,64 @@ private:
   void LookMovement(const FInputActionValue& value);
   void Sprint(const FInputActionValue& value);
   void SetCrouch(const FInputActionValue& value);
-  void HandleCrouch();
-  void HandleSpeed();
-  void RechargeMana(float t);
+  void UpdateMovementState();
+  void StartCrouchBlend();
+  float GetTargetCrouchHeight() const;
+  void HandleCrouch(float deltaTime);
+  void SimulateStep(float deltaTime);
+  void UpdateShiftFov();
+  void PresentSimulation(float alpha);
+  bool NeedsTick() const;
+  void RefreshTickEnabled();
   // void SmoothCrouchHandler(float targetHeight);
   void StartSlide();
   void EndSlide();
   virtual void Jump() override;
+  virtual bool CanJumpInternal_Implementation() const override;
+  virtual void OnStartCrouch(float HalfHeightAdjust, float ScaledHalfHeightAdjust) override;
+  virtual void OnEndCrouch(float HalfHeightAdjust, float ScaledHalfHeightAdjust) override;
+  void FollowCrouch();
   void Thrust();
 
+  void TickCharacter(float deltaTime);
+
+  // Input capture/replay for the local viewer, see -InputRecord= and -InputReplay= in UpdateInputCapture
+  void UpdateInputCapture();
+  // saves the recording, drops the replay
+  void StopInputCapture();
+  void RecordInput(ECharacterInput channel, const FInputActionValue& value);
+  void DispatchInput(ECharacterInput channel, const FInputActionValue& value);
+  void TickInputReplay();
+  // traces the state and wraps up a finished loop, after the Tick scope
+  void EndInputReplayFrame();
+  TUniquePtr<FCharacterInputRecorder> m_inputRecorder;
+  TUniquePtr<FCharacterInputPlayer> m_inputPlayer;
+  FReplayFrameStats m_replayStats;
+  FReplayStateTrace m_replayStates;
+  bool m_replayPassed;
+  FString m_replayStatesPath;
+  FString m_replayExpectPath;
+  FString m_inputRecordPath;
+  uint64 m_inputStartFrame;
+  int32 m_replayLoops;
+
   // Ability Interaction
   void StartAbility();
   void ExecuteAbility();
+  void ResolveShiftTarget();
+  bool SolveFromLandingIndex(IShiftCollisionQuery& query, const FShiftQueryParams& params,
+                             FShiftSolution& outSolution) const;
+  FShiftQueryParams MakeShiftQueryParams() const;
+  void ApplyShiftSolution(const FShiftSolution& solution);
+  void StartAbilityAsync();
+  void RunAsyncShiftSolve();
+  void OnShiftTraceDone(const FTraceHandle& handle, FTraceDatum& datum);
+  // soft so it can be streamed in at BeginPlay and pre-warmed in the actor pool
   UPROPERTY(EditAnywhere)
-  TSubclassOf<class UObject> ShiftVFX;
+  TSoftClassPtr<AActor> ShiftVFX;
+  UPROPERTY(EditAnywhere, Category="ShiftAB")
+  int32 m_shiftVFXPoolSize = 2;
+  void OnShiftVFXLoaded();
 
   AActor* VFX;
   
@@ -86,14 +178,78 @@ private:
   FVector m_cacheLocation;
   float m_fovOffset;
   float m_cacheFOV;
-  float m_elapsedTime;
-  float m_desiredTime = .25f;
-  float m_abilityCost = 25.f;
-  float m_rechargeRate = 10.f;
-
-  float m_coolDownTimer;
-  float m_coolDownTimeAbility = .75f;
-  float m_coolDownTimeRecharge = 4.f;
+  // the ability's active time, the cooldown starts counting when it is over so the shift has to end there too
+  float GetShiftDuration() const;
+
+  // Shift and camera return end on the world's timer wheel instead of counting in Tick
+  enum class ECharacterTimer : uint64 { kShiftEnd, kFovReturn, kLoopSample };
+  static constexpr uint64 kCharacterTimerMask = 3;
+  FWheelTimerHandle AddCharacterTimer(ECharacterTimer timer, float delay);
+  static void OnWheelTimers(TConstArrayView<uint64> payloads);
+  void OnCharacterTimer(ECharacterTimer timer);
+  void StartShift(const FVector& target);
+  void EndShift();
+  class UTimerWheelSubsystem* m_timerWheel;
+  int32 m_timerChannel;
+  FWheelTimerHandle m_shiftEndTimer;
+  FWheelTimerHandle m_fovReturnTimer;
+  FWheelTimerHandle m_loopSampleTimer;
+
+  // the movement component's step while shifting, the shift covers up to 800 cm in GetShiftDuration()
+  UPROPERTY(EditAnywhere, Category="ShiftAB")
+  float m_shiftSubStepTime = 1.f / 120.f;
+  float m_cachedSimulationTimeStep;
+  uint16 m_shiftRootMotionId;
+
+  // resolves the shift target with async traces spread over frames instead of
+  // running the whole cascade on the game thread every frame the key is held
+  UPROPERTY(EditAnywhere, Category="ShiftAB")
+  bool m_asyncShiftTrace;
+
+  // scores a fixed set of candidates around the aim point instead of walking the cascade, always on the
+  // game thread with its queries batched in parallel, so it takes precedence over m_asyncShiftTrace
+  UPROPERTY(EditAnywhere, Category="ShiftAB")
+  bool m_shiftCandidateSearch;
+
+  // answers from the level's baked landing index when there is one, see UShiftLandingIndexSubsystem
+  UPROPERTY(EditAnywhere, Category="ShiftAB")
+  bool m_useShiftLandingIndex;
+
+  FAsyncShiftCollisionQuery m_asyncShiftQuery;
+  FShiftQueryParams m_asyncShiftParams;
+  bool m_asyncShiftInFlight;
+  bool m_asyncShiftHasResult; // a full chain finished since the key was pressed
+  FTraceDelegate m_shiftTraceDelegate;
+  FShiftTargetCache m_shiftTargetCache;
+  // built once in BeginPlay, shared by the sync and async queries
+  FShiftTraceParams m_shiftTraceParams;
+  // the last solve, what a release is filed under in the telemetry
+  EShiftBranch m_lastShiftBranch = EShiftBranch::kSurface;
+  uint8 m_lastShiftFlags = 0;
+  uint16 m_telemetryId = MAX_uint16;
+  void RecordShiftTelemetry(ETelemetryShiftOutcome outcome) const;
+#if ENABLE_CHARACTER_STATS
+  // allocation count once the first shift was resolved, -ShiftAllocLimit= only counts what comes after
+  uint64 m_shiftAllocWarmup = MAX_uint64;
+  void NoteShiftWarmedUp();
+#endif
+
+  // Networked shift: the owning client predicts, the server validates and replicates the result
+  UFUNCTION(Server, Reliable)
+  void ServerExecuteShift(const FShiftRequest& request);
+  UFUNCTION(Client, Reliable)
+  void ClientRejectShift(const FShiftNetState& state);
+  UFUNCTION()
+  void OnRep_ShiftNetState();
+  bool IsValidShiftRequest(const FShiftRequest& request) const;
+  void UpdateShiftNetState(uint8 shiftId);
+  FShiftNetState MakeShiftNetState(uint8 shiftId) const;
+  // takes the server's mana and cooldown where they are off by more than quantizing explains
+  void ApplyShiftNetState(const FShiftNetState& state);
+
+  UPROPERTY(ReplicatedUsing=OnRep_ShiftNetState)
+  FShiftNetState m_shiftNetState;
+  uint8 m_shiftSequence;
   
 
 
@@ -102,9 +258,17 @@ private:
 
   EMovementState m_movementState;
 
+  void TransitionTo(EMovementState state);
+
 
   UPROPERTY(EditAnywhere, Category="Input")
   float m_mouseSensitivity;
+  // look input is applied while the camera is finalized and topped up on the render thread instead of
+  // going through the controller right away, see FLookLatch. -LateLatchedLook=true/false overrides it
+  UPROPERTY(EditAnywhere, Category="Input")
+  bool m_lateLatchedLook;
+  TSharedPtr<FLookLatch, ESPMode::ThreadSafe> m_lookLatch;
+  TSharedPtr<FLookLatchViewExtension, ESPMode::ThreadSafe> m_lookLatchExtension;
 
   UPROPERTY(EditAnywhere, Category="Player Params")
   float m_movementMeterPerSec;
@@ -121,6 +285,34 @@ private:
   UPROPERTY(EditAnywhere, Category="Player Params")
   bool m_crouchToggle;
 
+  // keeps the local player's state over the loop for rewinds, sampled off the timer wheel so it costs
+  // nothing while the character is idle
+  UPROPERTY(EditAnywhere, Category="Player Params")
+  bool m_recordTimeLoop;
+  UPROPERTY(EditAnywhere, Category="Player Params", meta=(EditCondition="m_recordTimeLoop"))
+  int32 m_timeLoopBudgetKB = 512;
+  TUniquePtr<FTimeLoopRecorder> m_timeLoop;
+  // starts or stops recording as the pawn becomes or stops being the local player's
+  void UpdateTimeLoopRecording();
+  void SampleTimeLoop();
+
+  // runs the crouch/slide blends at a fixed rate and interpolates what is shown,
+  // so they behave the same at any frame rate
+  UPROPERTY(EditAnywhere, Category="Player Params")
+  bool m_fixedStepSimulation;
+  UPROPERTY(EditAnywhere, Category="Player Params", meta=(EditCondition="m_fixedStepSimulation"))
+  float m_fixedStepRate = 60.f;
+  UPROPERTY(EditAnywhere, Category="Player Params", meta=(EditCondition="m_fixedStepSimulation"))
+  int32 m_maxSubSteps = 4;
+
+  FFixedStepClock m_fixedStepClock;
+  ECharacterSignificance m_significance = ECharacterSignificance::kNear;
+  float m_crouchHeight;
+  float m_prevCrouchHeight;
+  float m_fov;
+  float m_prevFov;
+  bool m_presentPending;
+
 
 
   // bool state
@@ -134,6 +326,8 @@ private:
   
   
   bool m_slideOverride;
+  bool m_crouchBlendActive;
+  bool m_abilityHeld;
   
 
   float m_baseSpeed;
@@ -143,6 +337,22 @@ private:
   float m_boostSpeed;
 
   float m_cachedStandingHeight;
+  // the eye is blended from here, the engine's BaseEyeHeight jumps to CrouchedEyeHeight with the capsule
+  float m_standingEyeHeight;
+
+#if ENABLE_CHARACTER_DEBUG
+  enum EDebugSlot : int32 {
+    kDebugMovementState,
+    kDebugSprinting,
+    kDebugCrouching,
+    kDebugSliding,
+    kDebugHalfHeight,
+    kDebugWantsToCrouch,
+    kDebugCrouchSpeed,
+  };
+
+  FCharacterDebugOverlay m_debugOverlay;
+#endif
 
   // Enhanced Input 
   UPROPERTY(EditDefaultsOnly, Category="Input")
@@ -0,0 +1,418 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CharacterStats.h"
+#include "PlayerCharacter.h"
+#include "PlayerMovementComponent.h"
+#include "ShiftAllocationCounter.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/CommandLine.h"
+
+// A generated map for APlayerCharacter: a floor, optional boxes, and a player controller possessing a character
+// with fixed tuning. Inputs go through DispatchInput like a replay and the world ticks at a fixed step, so what
+// the tests see doesn't depend on the machine.
+class FPlayerCharacterTestWorld {
+public:
+  using EState = APlayerCharacter::EMovementState;
+
+  explicit FPlayerCharacterTestWorld(float frameRate);
+  ~FPlayerCharacterTestWorld();
+
+  // a box of the engine's cube mesh, centered on center
+  void AddBox(const FVector& center, const FVector& size);
+
+  void Input(ECharacterInput channel, const FInputActionValue& value) { m_character->DispatchInput(channel, value); }
+  void Press(ECharacterInput channel, bool pressed) { Input(channel, FInputActionValue(pressed)); }
+  // movement input is used up every frame, this one is sent again before each tick until changed
+  void SetMove(const FVector2D& move) { m_move = move; }
+  void Tick();
+  // ticks until done() holds or maxSeconds went by, false on timeout
+  bool TickUntil(float maxSeconds, TFunctionRef<bool()> done);
+  void TickFor(float seconds);
+
+  EState GetState() const { return m_character->m_movementState; }
+  bool IsSliding() const { return m_character->m_isSliding; }
+  bool IsCrouching() const { return m_character->m_isCrouching; }
+  bool CanShift() const { return m_character->m_canShift; }
+  float GetMana() const { return m_character->m_shiftAbility->GetMana(); }
+  float GetMaxMana() const { return m_character->m_shiftAbility->GetMaxMana(); }
+  float GetCoolDownElapsed() const {
+    return m_character->m_shiftAbility->GetCoolDownElapsed(m_character->m_shiftAbilityHandle);
+  }
+  bool IsShiftReady() const { return m_character->m_shiftAbility->IsReady(m_character->m_shiftAbilityHandle); }
+  const UAbilityData* GetShiftAbility() const {
+    return m_character->m_shiftAbility->GetAbility(m_character->m_shiftAbilityHandle);
+  }
+  float GetCrouchedSpeed() const { return m_character->m_characterMovementComponent->MaxWalkSpeedCrouched; }
+  float GetSprintSpeed() const { return m_character->m_maxSprintSpeed; }
+  UPlayerMovementComponent* GetMovement() const { return m_character->m_characterMovementComponent; }
+  APlayerCharacter* GetCharacter() const { return m_character; }
+
+private:
+  UWorld* m_world = nullptr;
+  APlayerController* m_controller = nullptr;
+  APlayerCharacter* m_character = nullptr;
+  FVector2D m_move = FVector2D::ZeroVector;
+  float m_step;
+};
+
+FPlayerCharacterTestWorld::FPlayerCharacterTestWorld(float frameRate)
+  : m_step(1.f / FMath::Max(frameRate, 1.f)) {
+  m_world = UWorld::CreateWorld(EWorldType::Game, false, TEXT("PlayerCharacterTest"));
+  FWorldContext& context = GEngine->CreateNewWorldContext(EWorldType::Game);
+  context.SetCurrentWorld(m_world);
+
+  const FURL url;
+  m_world->SetGameMode(url);
+  m_world->InitializeActorsForPlay(url);
+  m_world->BeginPlay();
+
+  // the top of the floor at z = 0
+  AddBox(FVector(0, 0, -50), FVector(20000, 20000, 100));
+
+  m_controller = m_world->SpawnActor<APlayerController>();
+  const FTransform spawn(FVector(0, 0, 100));
+  m_character = m_world->SpawnActorDeferred<APlayerCharacter>(APlayerCharacter::StaticClass(), spawn);
+  // what the blueprint sets, the C++ class leaves its tuning to it
+  m_character->m_movementMeterPerSec = 6.f;
+  m_character->m_speedMultiplier = 50.f;
+  m_character->m_crouchSmoothValue = 10.f;
+  m_character->m_slideBoost = 6.f;
+  m_character->m_slideTime = 800.f;
+  m_character->m_mouseSensitivity = 1.f;
+  m_character->m_sprintToggle = false;
+  m_character->m_crouchToggle = false;
+  // one synchronous resolve per shift, a generated map has no baked index
+  m_character->m_asyncShiftTrace = false;
+  m_character->m_useShiftLandingIndex = false;
+  m_character->m_recordTimeLoop = false;
+  m_character->FinishSpawning(spawn);
+  m_controller->Possess(m_character);
+}
+
+FPlayerCharacterTestWorld::~FPlayerCharacterTestWorld() {
+  GEngine->DestroyWorldContext(m_world);
+  m_world->DestroyWorld(false);
+}
+
+void FPlayerCharacterTestWorld::AddBox(const FVector& center, const FVector& size) {
+  UStaticMesh* cube = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+  AStaticMeshActor* box = m_world->SpawnActor<AStaticMeshActor>(center, FRotator::ZeroRotator);
+  // spawned at runtime, a static component won't take the mesh
+  box->GetStaticMeshComponent()->SetMobility(EComponentMobility::Movable);
+  box->GetStaticMeshComponent()->SetStaticMesh(cube);
+  // the cube is 100 cm with its pivot in the middle
+  box->SetActorScale3D(size / 100.f);
+}
+
+void FPlayerCharacterTestWorld::Tick() {
+  if (!m_move.IsZero()) {
+    Input(ECharacterInput::kMovement, FInputActionValue(m_move));
+  }
+  m_world->Tick(LEVELTICK_All, m_step);
+}
+
+bool FPlayerCharacterTestWorld::TickUntil(float maxSeconds, TFunctionRef<bool()> done) {
+  for (float elapsed = 0.f; elapsed < maxSeconds; elapsed += m_step) {
+    if (done()) return true;
+    Tick();
+  }
+  return done();
+}
+
+void FPlayerCharacterTestWorld::TickFor(float seconds) {
+  for (float elapsed = 0.f; elapsed < seconds; elapsed += m_step) {
+    Tick();
+  }
+}
+
+namespace {
+  // Longest each step may take before the test fails, in game time, and what the character may cost per frame
+  // in real time. They are the tests' parameters, so the same sequence is checked at several frame rates and a
+  // tuning change only has to touch GetTests.
+  struct FMovementTestTimings {
+    float frameRate = 60.f;
+    // crouch/stand blends and getting up to sprint speed
+    float settleSeconds = 1.f;
+    // sprint speed plus the boost, slowed down to the crouched speed
+    float slideSeconds = 3.f;
+    // a jump up and back down
+    float airSeconds = 1.5f;
+    // the shift's active time plus the cooldown, until it is ready again
+    float shiftSeconds = 1.5f;
+    // average cost per call of the character scopes over the sequence, in us. Loose enough for an editor
+    // build on a loaded machine, a per frame trace or solve that crept in goes past them
+    float tickUs = 100.f;
+    float movementUs = 250.f;
+    float startAbilityUs = 1000.f;
+
+    explicit FMovementTestTimings(const FString& parameters) {
+      FParse::Value(*parameters, TEXT("FrameRate="), frameRate);
+      FParse::Value(*parameters, TEXT("SettleSeconds="), settleSeconds);
+      FParse::Value(*parameters, TEXT("SlideSeconds="), slideSeconds);
+      FParse::Value(*parameters, TEXT("AirSeconds="), airSeconds);
+      FParse::Value(*parameters, TEXT("ShiftSeconds="), shiftSeconds);
+      FParse::Value(*parameters, TEXT("TickUs="), tickUs);
+      FParse::Value(*parameters, TEXT("MovementUs="), movementUs);
+      FParse::Value(*parameters, TEXT("StartAbilityUs="), startAbilityUs);
+    }
+  };
+
+  // the character stats are process wide, a test resets them once the world settled and checks what its
+  // own frames recorded
+  void ResetScopeTimings() {
+#if ENABLE_CHARACTER_STATS
+    FCharacterStats::Get().Reset();
+#endif
+  }
+
+  void TestScopeAverage(FAutomationTestBase& test, ECharacterScope scope, const TCHAR* name, float limitUs) {
+#if ENABLE_CHARACTER_STATS
+    const FCharacterStats& stats = FCharacterStats::Get();
+    const uint64 count = stats.GetScopeCount(scope);
+    if (!test.TestTrue(FString::Printf(TEXT("%s was timed"), name), count > 0)) return;
+    const double averageUs = stats.GetScopeSeconds(scope) * 1e6 / count;
+    test.TestTrue(FString::Printf(TEXT("%s averaged %.2f us over %llu calls, the limit is %.2f us"), name,
+                                  averageUs, count, limitUs),
+                  averageUs <= limitUs);
+#endif
+  }
+
+  void GetFrameRateTests(TArray<FString>& outBeautifiedNames, TArray<FString>& outTestCommands) {
+    static const TCHAR* const kFrameRates[] = {TEXT("30"), TEXT("60"), TEXT("144")};
+    for (const TCHAR* frameRate : kFrameRates) {
+      outBeautifiedNames.Add(FString::Printf(TEXT("%sFps"), frameRate));
+      outTestCommands.Add(FString::Printf(
+        TEXT("FrameRate=%s SettleSeconds=1 SlideSeconds=3 AirSeconds=1.5 ShiftSeconds=1.5 TickUs=100 ")
+        TEXT("MovementUs=250 StartAbilityUs=1000"), frameRate));
+    }
+  }
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FPlayerCharacterMovementTest, "FPS_Controller.PlayerCharacter.Movement",
+                                  EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+                                  EAutomationTestFlags::ProductFilter)
+
+void FPlayerCharacterMovementTest::GetTests(TArray<FString>& OutBeautifiedNames,
+                                            TArray<FString>& OutTestCommands) const {
+  GetFrameRateTests(OutBeautifiedNames, OutTestCommands);
+}
+
+// sprint -> slide -> crouch -> jump -> shift, the way a player chains them
+bool FPlayerCharacterMovementTest::RunTest(const FString& Parameters) {
+  using EState = FPlayerCharacterTestWorld::EState;
+  const FMovementTestTimings timings(Parameters);
+  FPlayerCharacterTestWorld world(timings.frameRate);
+  UPlayerMovementComponent* movement = world.GetMovement();
+
+  if (!TestTrue(TEXT("Lands on the floor"),
+                world.TickUntil(timings.airSeconds, [movement] { return movement->IsMovingOnGround(); }))) {
+    return false;
+  }
+  TestTrue(TEXT("Walks after landing"), world.GetState() == EState::kWalking);
+  ResetScopeTimings();
+
+  // sprint
+  world.SetMove(FVector2D(0, 1));
+  world.Press(ECharacterInput::kSprint, true);
+  TestTrue(TEXT("Runs while sprint is held"), world.GetState() == EState::kRunning);
+  const float sprintSpeed = world.GetSprintSpeed();
+  TestTrue(TEXT("Reaches sprint speed"), world.TickUntil(timings.settleSeconds, [movement, sprintSpeed] {
+    return movement->Velocity.Size2D() >= sprintSpeed - 1.f;
+  }));
+
+  // slide
+  world.Press(ECharacterInput::kCrouch, true);
+  TestTrue(TEXT("Crouching at sprint speed slides"), world.GetState() == EState::kSliding);
+  TestTrue(TEXT("Slide flag is set"), world.IsSliding());
+  world.Tick();
+  TestTrue(TEXT("Slide boosts past sprint speed"), movement->Velocity.Size2D() > sprintSpeed);
+  TestTrue(TEXT("Capsule crouches for the slide"), movement->IsCrouching());
+
+  // crouch, the slide ends in one while the key is held
+  TestTrue(TEXT("Slide slows down and ends"),
+           world.TickUntil(timings.slideSeconds, [&world] { return !world.IsSliding(); }));
+  TestTrue(TEXT("Slide ends crouched"), world.GetState() == EState::kCrouching);
+  TestTrue(TEXT("Crouch blend settles"),
+           world.TickUntil(timings.settleSeconds, [&world] { return world.IsCrouching(); }));
+  TestTrue(TEXT("Crouched speed after the slide"),
+           movement->Velocity.Size2D() <= world.GetCrouchedSpeed() + 1.f);
+
+  // jump, straight out of the crouch
+  world.Press(ECharacterInput::kSprint, false);
+  world.Input(ECharacterInput::kJump, FInputActionValue(true));
+  TestTrue(TEXT("Leaves the ground from a crouch"),
+           world.TickUntil(timings.settleSeconds, [movement] { return movement->IsFalling(); }));
+  // the capsule stands up on the move that jumps
+  TestFalse(TEXT("Jumping lets go of the crouch"), movement->IsCrouching());
+  TestTrue(TEXT("Walks once the capsule stood up"), world.GetState() == EState::kWalking);
+  TestTrue(TEXT("Lands again"),
+           world.TickUntil(timings.airSeconds, [movement] { return movement->IsMovingOnGround(); }));
+  world.Press(ECharacterInput::kCrouch, false);
+  TestTrue(TEXT("Stands up"), world.TickUntil(timings.settleSeconds, [&world, movement] {
+    return !movement->IsCrouching() && !world.IsCrouching();
+  }));
+  TestTrue(TEXT("Walks after the jump"), world.GetState() == EState::kWalking);
+
+  // shift, aimed at open air straight ahead
+  world.SetMove(FVector2D::ZeroVector);
+  const UAbilityData* ability = world.GetShiftAbility();
+  TestTrue(TEXT("Shift is ready"), world.IsShiftReady());
+  world.Input(ECharacterInput::kStartAbility, FInputActionValue(true));
+  TestTrue(TEXT("Shift target found"), world.CanShift());
+  const FVector start = world.GetCharacter()->GetActorLocation();
+  world.Input(ECharacterInput::kExecuteAbility, FInputActionValue(true));
+  TestFalse(TEXT("Shift target used up"), world.CanShift());
+  TestEqual(TEXT("Shift spends its mana"), world.GetMana(), world.GetMaxMana() - ability->m_manaCost, 0.01f);
+  TestTrue(TEXT("Cooldown waits for the active time"), world.GetCoolDownElapsed() < 0.f);
+  TestFalse(TEXT("Shift not ready while active"), world.IsShiftReady());
+
+  TestTrue(TEXT("Shift becomes ready again"),
+           world.TickUntil(timings.shiftSeconds, [&world] { return world.IsShiftReady(); }));
+  TestTrue(TEXT("Cooldown elapsed"), world.GetCoolDownElapsed() >= ability->m_coolDown);
+  TestTrue(TEXT("Shift moved the character forward"),
+           world.GetCharacter()->GetActorLocation().X - start.X > 100.f);
+  // recharging only starts m_rechargeDelay after the active time
+  TestEqual(TEXT("No mana back during the cooldown"), world.GetMana(), world.GetMaxMana() - ability->m_manaCost,
+            0.01f);
+
+  TestScopeAverage(*this, ECharacterScope::kTick, TEXT("Tick"), timings.tickUs);
+  TestScopeAverage(*this, ECharacterScope::kMovement, TEXT("Movement"), timings.movementUs);
+  TestScopeAverage(*this, ECharacterScope::kStartAbility, TEXT("StartAbility"), timings.startAbilityUs);
+  return true;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FPlayerCharacterBlockedStandTest, "FPS_Controller.PlayerCharacter.BlockedStand",
+                                  EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+                                  EAutomationTestFlags::ProductFilter)
+
+void FPlayerCharacterBlockedStandTest::GetTests(TArray<FString>& OutBeautifiedNames,
+                                                TArray<FString>& OutTestCommands) const {
+  GetFrameRateTests(OutBeautifiedNames, OutTestCommands);
+}
+
+// a crouch under something low stays a crouch until there is room, sprinting included
+bool FPlayerCharacterBlockedStandTest::RunTest(const FString& Parameters) {
+  using EState = FPlayerCharacterTestWorld::EState;
+  const FMovementTestTimings timings(Parameters);
+  FPlayerCharacterTestWorld world(timings.frameRate);
+  UPlayerMovementComponent* movement = world.GetMovement();
+  APlayerCharacter* character = world.GetCharacter();
+
+  // underside at 120 cm, above the crouched capsule and below the standing one
+  world.AddBox(FVector(600, 0, 170), FVector(400, 2000, 100));
+  if (!TestTrue(TEXT("Lands on the floor"),
+                world.TickUntil(timings.airSeconds, [movement] { return movement->IsMovingOnGround(); }))) {
+    return false;
+  }
+  ResetScopeTimings();
+
+  world.Press(ECharacterInput::kCrouch, true);
+  TestTrue(TEXT("Crouches"), world.GetState() == EState::kCrouching);
+  world.SetMove(FVector2D(0, 1));
+  const float walkSeconds = 600.f / world.GetCrouchedSpeed() + timings.settleSeconds;
+  TestTrue(TEXT("Crouch walks under the ceiling"),
+           world.TickUntil(walkSeconds, [character] { return character->GetActorLocation().X > 600.f; }));
+
+  world.SetMove(FVector2D::ZeroVector);
+  world.Press(ECharacterInput::kCrouch, false);
+  world.TickFor(timings.settleSeconds);
+  TestTrue(TEXT("Capsule stays crouched under the ceiling"), movement->IsCrouching());
+  TestTrue(TEXT("Stays in the crouch state"), world.GetState() == EState::kCrouching);
+
+  world.Press(ECharacterInput::kSprint, true);
+  world.TickFor(timings.settleSeconds);
+  TestTrue(TEXT("Sprint doesn't stand up under the ceiling"), world.GetState() == EState::kCrouching);
+  TestFalse(TEXT("No slide under the ceiling"), world.IsSliding());
+  world.Press(ECharacterInput::kSprint, false);
+
+  world.SetMove(FVector2D(0, -1));
+  TestTrue(TEXT("Stands up once out from under"), world.TickUntil(walkSeconds, [&world, movement] {
+    return !movement->IsCrouching() && world.GetState() == EState::kWalking;
+  }));
+  TestTrue(TEXT("Out from under the ceiling"), character->GetActorLocation().X < 400.f);
+
+  TestScopeAverage(*this, ECharacterScope::kTick, TEXT("Tick"), timings.tickUs);
+  TestScopeAverage(*this, ECharacterScope::kMovement, TEXT("Movement"), timings.movementUs);
+  return true;
+}
+
+#if ENABLE_CHARACTER_STATS
+namespace {
+  // the counter can only be installed at startup, see FShiftAllocationCounter
+  bool IsCountingShiftAllocations(FAutomationTestBase& test) {
+    if (FShiftAllocationCounter::IsInstalled()) return true;
+    test.AddWarning(TEXT("Shift allocations aren't counted, run the tests with -ShiftAllocLimit=<n> in a build ")
+      TEXT("that loads the game module before the engine starts its threads"));
+    return false;
+  }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FShiftAllocationCounterTest, "FPS_Controller.ShiftAllocations.Counter",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+                                 EAutomationTestFlags::ProductFilter)
+
+// what counts inside a scope, nothing is tested before the counts are taken since failures allocate
+bool FShiftAllocationCounterTest::RunTest(const FString& Parameters) {
+  if (!IsCountingShiftAllocations(*this)) return true;
+
+  uint64 start = FShiftAllocationCounter::GetCount();
+  void* block = FMemory::Malloc(256);
+  const uint64 outside = FShiftAllocationCounter::GetCount() - start;
+
+  void* resized = nullptr;
+  uint64 reallocs = 0;
+  uint64 mallocs = 0;
+  {
+    SHIFT_ALLOCATION_SCOPE();
+    start = FShiftAllocationCounter::GetCount();
+    resized = FMemory::Realloc(block, 64);
+    reallocs = FShiftAllocationCounter::GetCount() - start;
+
+    start = FShiftAllocationCounter::GetCount();
+    void* other = FMemory::Malloc(64);
+    mallocs = FShiftAllocationCounter::GetCount() - start;
+    FMemory::Free(other);
+  }
+  const bool moved = resized != block;
+  FMemory::Free(resized);
+
+  TestEqual(TEXT("Nothing counted outside a scope"), static_cast<int64>(outside), 0ll);
+  TestEqual(TEXT("A realloc only counts when it moved"), static_cast<int64>(reallocs), moved ? 1ll : 0ll);
+  TestEqual(TEXT("A malloc counts"), static_cast<int64>(mallocs), 1ll);
+  return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FShiftAllocationPathTest, "FPS_Controller.ShiftAllocations.ShiftPath",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext |
+                                 EAutomationTestFlags::ProductFilter)
+
+// full shift resolves once warmed up stay within -ShiftAllocLimit=, the same limit the replay gate checks
+bool FShiftAllocationPathTest::RunTest(const FString& Parameters) {
+  if (!IsCountingShiftAllocations(*this)) return true;
+  uint64 limit = 0;
+  FParse::Value(FCommandLine::Get(), TEXT("ShiftAllocLimit="), limit);
+
+  FPlayerCharacterTestWorld world(60.f);
+  UPlayerMovementComponent* movement = world.GetMovement();
+  if (!TestTrue(TEXT("Lands on the floor"),
+                world.TickUntil(2.f, [movement] { return movement->IsMovingOnGround(); }))) {
+    return false;
+  }
+  const uint64 allocations = world.GetCharacter()->RunShiftAllocationBench(200);
+  TestTrue(FString::Printf(TEXT("%llu allocations over 200 resolves, the limit is %llu"), allocations, limit),
+           allocations <= limit);
+  return true;
+}
+#endif
+
+#endif
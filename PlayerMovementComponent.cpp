@@ -0,0 +1,255 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PlayerMovementComponent.h"
+
+#include "CharacterStats.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPlayerMovement, Log, All);
+
+static TAutoConsoleVariable<bool> CVarPredictMovementStates(
+  TEXT("fps.Move.PredictStates"),
+  true,
+  TEXT("Sends sprint and slide with every move. 0 keeps them on the owning client only, so the server ")
+  TEXT("runs its moves without them and corrects the difference, for comparing corrections and bandwidth."));
+
+namespace {
+  FMovementNetStats GMovementNetStats;
+
+  // totals over the server's client connections, or the client's one connection to the server
+  void GetConnectionBytes(const UWorld* world, int64& outIn, int64& outOut) {
+    outIn = outOut = 0;
+    const UNetDriver* driver = world ? world->GetNetDriver() : nullptr;
+    if (driver == nullptr) return;
+    for (const UNetConnection* connection : driver->ClientConnections) {
+      outIn += connection->InTotalBytes;
+      outOut += connection->OutTotalBytes;
+    }
+    if (driver->ServerConnection != nullptr) {
+      outIn += driver->ServerConnection->InTotalBytes;
+      outOut += driver->ServerConnection->OutTotalBytes;
+    }
+  }
+
+  FAutoConsoleCommandWithWorldAndArgs CmdMoveNetStats(
+    TEXT("fps.Move.NetStats"),
+    TEXT("Prints the client moves the server ran, the corrections it sent and the connection bandwidth since ")
+    TEXT("the last reset, pass reset to clear them."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& args, UWorld* world) {
+      if (world == nullptr) return;
+      FMovementNetStats& stats = FMovementNetStats::Get();
+      int64 inBytes;
+      int64 outBytes;
+      GetConnectionBytes(world, inBytes, outBytes);
+      if (args.Num() > 0 && args[0] == TEXT("reset")) {
+        stats = FMovementNetStats();
+        stats.inBytes = inBytes;
+        stats.outBytes = outBytes;
+        stats.resetTime = world->GetRealTimeSeconds();
+        return;
+      }
+      const double seconds = FMath::Max(world->GetRealTimeSeconds() - stats.resetTime, 1e-3);
+      UE_LOG(LogPlayerMovement, Display,
+             TEXT("Movement net over %.1f s: %llu moves, %llu corrections (%.2f per 1000 moves), ")
+             TEXT("in %.2f KB/s, out %.2f KB/s, states %s"),
+             seconds, stats.moves, stats.corrections, stats.corrections * 1000.0 / FMath::Max<uint64>(stats.moves, 1),
+             (inBytes - stats.inBytes) / 1024.0 / seconds, (outBytes - stats.outBytes) / 1024.0 / seconds,
+             CVarPredictMovementStates.GetValueOnGameThread() ? TEXT("predicted") : TEXT("client only"));
+    }));
+}
+
+// The movement states a move started with, restored when the client replays it after a correction. Crouch
+// rides in the engine's FLAG_WantsToCrouch.
+class FSavedMove_Player : public FSavedMove_Character {
+public:
+  typedef FSavedMove_Character Super;
+
+  virtual void Clear() override {
+    Super::Clear();
+    m_wantsToSprint = m_isSliding = m_startSlide = false;
+  }
+
+  virtual uint8 GetCompressedFlags() const override {
+    uint8 flags = Super::GetCompressedFlags();
+    if (!CVarPredictMovementStates.GetValueOnGameThread()) return flags;
+    if (m_wantsToSprint) flags |= FLAG_Custom_0;
+    if (m_isSliding) flags |= FLAG_Custom_1;
+    if (m_startSlide) flags |= FLAG_Custom_2;
+    return flags;
+  }
+
+  // moves with different states stay apart, the server has to see each change on the move it happened
+  virtual bool CanCombineWith(const FSavedMovePtr& newMove, ACharacter* character, float maxDelta) const override {
+    const FSavedMove_Player* other = static_cast<const FSavedMove_Player*>(newMove.Get());
+    if (m_wantsToSprint != other->m_wantsToSprint || m_isSliding != other->m_isSliding ||
+      m_startSlide != other->m_startSlide) {
+      return false;
+    }
+    return Super::CanCombineWith(newMove, character, maxDelta);
+  }
+
+  virtual void SetMoveFor(ACharacter* character, float deltaTime, FVector const& newAccel,
+                          FNetworkPredictionData_Client_Character& clientData) override {
+    Super::SetMoveFor(character, deltaTime, newAccel, clientData);
+    const UPlayerMovementComponent* movement = CastChecked<UPlayerMovementComponent>(character->GetCharacterMovement());
+    m_wantsToSprint = movement->m_wantsToSprint;
+    m_isSliding = movement->m_isSliding;
+    m_startSlide = movement->m_startSlide;
+  }
+
+  virtual void PrepMoveFor(ACharacter* character) override {
+    Super::PrepMoveFor(character);
+    UPlayerMovementComponent* movement = CastChecked<UPlayerMovementComponent>(character->GetCharacterMovement());
+    movement->m_wantsToSprint = m_wantsToSprint;
+    movement->m_isSliding = m_isSliding;
+    movement->m_startSlide = m_startSlide;
+  }
+
+private:
+  bool m_wantsToSprint = false;
+  bool m_isSliding = false;
+  bool m_startSlide = false;
+};
+
+class FNetworkPredictionData_Client_Player : public FNetworkPredictionData_Client_Character {
+public:
+  typedef FNetworkPredictionData_Client_Character Super;
+
+  explicit FNetworkPredictionData_Client_Player(const UCharacterMovementComponent& movement) : Super(movement) {}
+
+  virtual FSavedMovePtr AllocateNewMove() override {
+    return FSavedMovePtr(new FSavedMove_Player());
+  }
+};
+
+FMovementNetStats& FMovementNetStats::Get() {
+  return GMovementNetStats;
+}
+
+void UPlayerMovementComponent::RequestSlide() {
+  m_startSlide = true;
+}
+
+void UPlayerMovementComponent::StopSlide() {
+  m_startSlide = false;
+  m_isSliding = false;
+}
+
+void UPlayerMovementComponent::SetStateSpeeds(float maxSprintSpeed, float slideBoost, float slideDeceleration) {
+  m_maxSprintSpeed = maxSprintSpeed;
+  m_slideBoost = slideBoost;
+  m_slideDeceleration = slideDeceleration;
+}
+
+float UPlayerMovementComponent::GetMaxSpeed() const {
+  // falling keeps the ground speed for air control, like MaxWalkSpeed did. A crouch the capsule is still
+  // stuck in under something low wins over the sprint
+  if (MovementMode == MOVE_Walking || MovementMode == MOVE_NavWalking || MovementMode == MOVE_Falling) {
+    if (IsCrouching()) return MaxWalkSpeedCrouched;
+    if (m_wantsToSprint) return m_maxSprintSpeed;
+  }
+  return Super::GetMaxSpeed();
+}
+
+// PhysWalking asks this for the velocity of every iteration. The slide replaces friction, braking and
+// acceleration: the speed only goes down, input only turns it. Everything else (step ups, floors, walls
+// taking the speed out, walking off a ledge) stays PhysWalking's.
+void UPlayerMovementComponent::CalcVelocity(float DeltaTime, float Friction, bool bFluid, float BrakingDeceleration) {
+  if (!m_isSliding || MovementMode != MOVE_Walking || DeltaTime < MIN_TICK_TIME) {
+    Super::CalcVelocity(DeltaTime, Friction, bFluid, BrakingDeceleration);
+    return;
+  }
+  CHARACTER_STAT_SCOPE(HandleSpeed);
+  const float speed = Velocity.Size2D() - m_slideDeceleration * DeltaTime;
+  if (speed < MaxWalkSpeedCrouched) {
+    m_isSliding = false;
+    Super::CalcVelocity(DeltaTime, Friction, bFluid, BrakingDeceleration);
+    return;
+  }
+  FVector direction = Velocity.GetSafeNormal2D();
+  if (direction.IsNearlyZero()) {
+    direction = UpdatedComponent->GetForwardVector().GetSafeNormal2D();
+  }
+  direction = (direction + Acceleration.GetSafeNormal2D() * (m_slideSteering * DeltaTime)).GetSafeNormal2D();
+  Velocity = direction * speed;
+}
+
+FNetworkPredictionData_Client* UPlayerMovementComponent::GetPredictionData_Client() const {
+  if (ClientPredictionData == nullptr) {
+    UPlayerMovementComponent* mutableThis = const_cast<UPlayerMovementComponent*>(this);
+    mutableThis->ClientPredictionData = new FNetworkPredictionData_Client_Player(*this);
+  }
+  return ClientPredictionData;
+}
+
+void UPlayerMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType,
+                                             FActorComponentTickFunction* ThisTickFunction) {
+  // what moving a character costs on top of its Tick, the load test reports both per bot
+  CHARACTER_STAT_SCOPE(Movement);
+  Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+}
+
+void UPlayerMovementComponent::UpdateFromCompressedFlags(uint8 Flags) {
+  Super::UpdateFromCompressedFlags(Flags);
+  m_wantsToSprint = (Flags & FSavedMove_Character::FLAG_Custom_0) != 0;
+  // the client can end a slide early (a shift, a rewind), only the boost move starts one
+  m_isSliding &= (Flags & FSavedMove_Character::FLAG_Custom_1) != 0;
+  m_startSlide = (Flags & FSavedMove_Character::FLAG_Custom_2) != 0;
+}
+
+void UPlayerMovementComponent::UpdateCharacterStateBeforeMovement(float DeltaSeconds) {
+  // crouches or stands up first, the slide starts with the crouched capsule
+  Super::UpdateCharacterStateBeforeMovement(DeltaSeconds);
+  if (!m_startSlide) return;
+  // one shot, the move that carries the request is the one that starts the slide
+  m_startSlide = false;
+  if (MovementMode != MOVE_Walking) return;
+
+  FVector velocity = Velocity;
+  velocity.Z = 0;
+  Velocity = velocity + UpdatedComponent->GetForwardVector() * m_slideBoost;
+  m_isSliding = true;
+}
+
+void UPlayerMovementComponent::OnMovementModeChanged(EMovementMode PreviousMovementMode, uint8 PreviousCustomMode) {
+  Super::OnMovementModeChanged(PreviousMovementMode, PreviousCustomMode);
+  // off the floor, a jump or a shift all end the slide
+  if (MovementMode != MOVE_Walking) {
+    m_isSliding = false;
+  }
+}
+
+bool UPlayerMovementComponent::ClientUpdatePositionAfterServerUpdate() {
+  // the replay leaves the input of the last saved move behind, the input may have moved on since. The
+  // slide itself is simulation state, whatever the replay ends in is right (the engine does the same for
+  // bWantsToCrouch)
+  const bool wantsToSprint = m_wantsToSprint;
+  const bool startSlide = m_startSlide;
+  const bool result = Super::ClientUpdatePositionAfterServerUpdate();
+  m_wantsToSprint = wantsToSprint;
+  m_startSlide = startSlide;
+  return result;
+}
+
+void UPlayerMovementComponent::ServerMove_PerformMovement(const FCharacterNetworkMoveData& MoveData) {
+  GMovementNetStats.moves++;
+  Super::ServerMove_PerformMovement(MoveData);
+}
+
+bool UPlayerMovementComponent::ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel,
+                                                      const FVector& ClientWorldLocation,
+                                                      const FVector& RelativeClientLocation,
+                                                      UPrimitiveComponent* ClientMovementBase,
+                                                      FName ClientBaseBoneName, uint8 ClientMovementMode) {
+  const bool error = Super::ServerCheckClientError(ClientTimeStamp, DeltaTime, Accel, ClientWorldLocation,
+                                                   RelativeClientLocation, ClientMovementBase, ClientBaseBoneName,
+                                                   ClientMovementMode) || m_forceCorrection;
+  m_forceCorrection = false;
+  GMovementNetStats.corrections += error ? 1 : 0;
+  return error;
+}
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "PlayerMovementComponent.generated.h"
+
+// Sprint and the slide as part of the movement simulation instead of values the character writes from
+// outside. They go out with every saved move as compressed flags (FLAG_Custom_0..2), so the server runs the
+// same speeds and the same slide as the owning client and only corrects real drift. Crouching is the
+// engine's own (bWantsToCrouch, CrouchedHalfHeight): every role resizes the capsule inside the move.
+// The slide is walking with its own velocity: the boost is added once on entry, then it bleeds off at
+// m_slideDeceleration without friction or acceleration and ends below the crouch speed or off the floor.
+// Floors, step ups and walls are PhysWalking's. fps.Move.NetStats [reset] prints moves, corrections and
+// connection bandwidth, fps.Move.PredictStates 0 keeps sprint and slide on the client the way they were
+// before for the comparison.
+UCLASS()
+class FPS_CONTROLLER_API UPlayerMovementComponent : public UCharacterMovementComponent {
+  GENERATED_BODY()
+
+public:
+  // what the character's movement state asks for, crouch goes through bWantsToCrouch and the slide
+  // through RequestSlide
+  void SetWantsToSprint(bool sprint) { m_wantsToSprint = sprint; }
+  // picked up by the next move, dropped if the character is not on the floor by then
+  void RequestSlide();
+  void StopSlide();
+  bool IsSliding() const { return m_isSliding; }
+  bool IsSlidePending() const { return m_startSlide; }
+  // from the character's tuning, the same on every machine
+  void SetStateSpeeds(float maxSprintSpeed, float slideBoost, float slideDeceleration);
+  // server, the client's next move gets a correction whatever its error. For a prediction the server turned
+  // down (a rejected shift), the client is put back and replays its moves since through the usual path
+  void ForceClientCorrection() { m_forceCorrection = true; }
+
+  virtual float GetMaxSpeed() const override;
+  virtual void CalcVelocity(float DeltaTime, float Friction, bool bFluid, float BrakingDeceleration) override;
+  virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+  virtual void TickComponent(float DeltaTime, ELevelTick TickType,
+                             FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+  virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+  virtual void UpdateCharacterStateBeforeMovement(float DeltaSeconds) override;
+  virtual void OnMovementModeChanged(EMovementMode PreviousMovementMode, uint8 PreviousCustomMode) override;
+  virtual bool ClientUpdatePositionAfterServerUpdate() override;
+  virtual void ServerMove_PerformMovement(const FCharacterNetworkMoveData& MoveData) override;
+  virtual bool ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel,
+                                      const FVector& ClientWorldLocation, const FVector& RelativeClientLocation,
+                                      UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName,
+                                      uint8 ClientMovementMode) override;
+
+  // how fast input turns the slide, in radians per second roughly
+  UPROPERTY(EditAnywhere, Category="Player Params")
+  float m_slideSteering = 2.f;
+
+private:
+  friend class FSavedMove_Player;
+
+  bool m_wantsToSprint = false;
+  bool m_isSliding = false;
+  bool m_startSlide = false; // one shot, the move that carries it adds the boost
+  bool m_forceCorrection = false;
+
+  float m_maxSprintSpeed = 0.f;
+  float m_slideBoost = 0.f;        // cm/s added along the facing on entry
+  float m_slideDeceleration = 0.f; // cm/s per second
+};
+
+// Process wide counters, for comparing corrections and bandwidth between runs (fps.Move.NetStats)
+struct FMovementNetStats {
+  uint64 moves = 0;       // client moves the server ran
+  uint64 corrections = 0; // the ones it had to correct
+  // connection totals and world real time at the last reset
+  int64 inBytes = 0;
+  int64 outBytes = 0;
+  double resetTime = 0;
+
+  static FMovementNetStats& Get();
+};
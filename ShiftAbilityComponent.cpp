@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShiftAbilityComponent.h"
+
+#include "Engine/World.h"
+
+namespace {
+  // far enough in the past that every cooldown is over and the pool is full
+  constexpr double kLongAgo = -1e9;
+}
+
+UShiftAbilityComponent::UShiftAbilityComponent() {
+  PrimaryComponentTick.bCanEverTick = false;
+  m_manaBase = m_maxMana;
+  m_rechargeStart = kLongAgo;
+}
+
+double UShiftAbilityComponent::GetTime() const {
+  const UWorld* world = GetWorld();
+  return world ? world->GetTimeSeconds() : 0;
+}
+
+void UShiftAbilityComponent::BeginPlay() {
+  Super::BeginPlay();
+  m_abilities.Remove(nullptr);
+  m_coolDownStart.Init(kLongAgo, m_abilities.Num());
+  m_manaBase = m_maxMana;
+  m_rechargeStart = kLongAgo;
+}
+
+// the owner registers after its Super::BeginPlay, so m_abilities is already set up here
+int32 UShiftAbilityComponent::AddAbility(UAbilityData* ability) {
+  check(ability != nullptr);
+  const int32 handle = m_abilities.Find(ability);
+  if (handle != INDEX_NONE) return handle;
+
+  m_coolDownStart.Add(kLongAgo);
+  return m_abilities.Add(ability);
+}
+
+bool UShiftAbilityComponent::IsReady(int32 handle) const {
+  return GetCoolDownElapsed(handle) >= m_abilities[handle]->m_coolDown;
+}
+
+bool UShiftAbilityComponent::CanActivate(int32 handle) const {
+  return IsReady(handle) && GetMana() - m_abilities[handle]->m_manaCost >= 0;
+}
+
+bool UShiftAbilityComponent::TryActivate(int32 handle) {
+  if (!CanActivate(handle)) return false;
+
+  const UAbilityData* ability = m_abilities[handle];
+  const double now = GetTime();
+  m_manaBase = GetMana() - ability->m_manaCost;
+  m_coolDownStart[handle] = now + ability->m_activeTime;
+  m_rechargeStart = m_coolDownStart[handle] + ability->m_rechargeDelay;
+  return true;
+}
+
+float UShiftAbilityComponent::GetCoolDownElapsed(int32 handle) const {
+  return static_cast<float>(GetTime() - m_coolDownStart[handle]);
+}
+
+void UShiftAbilityComponent::SyncState(int32 handle, float mana, float coolDownElapsed) {
+  const double now = GetTime();
+  m_coolDownStart[handle] = now - coolDownElapsed;
+  m_rechargeStart = m_coolDownStart[handle] + m_abilities[handle]->m_rechargeDelay;
+  // back out what the pool held when the recharge started so GetMana hands out mana right now
+  m_manaBase = mana - FMath::Max(now - m_rechargeStart, 0.0) * m_rechargeRate;
+}
+
+float UShiftAbilityComponent::GetMana() const {
+  const double recharging = FMath::Max(GetTime() - m_rechargeStart, 0.0);
+  return FMath::Min(static_cast<float>(m_manaBase + recharging * m_rechargeRate), m_maxMana);
+}
@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "AbilityData.h"
+#include "ShiftAbilityComponent.generated.h"
+
+// Mana pool and cooldowns of a character's abilities. Nothing is accumulated per frame, each ability
+// keeps the time its cooldown started and the pool the time its recharge started, every query works
+// the current value out from those. The component never ticks, adding abilities adds no frame cost.
+UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
+class FPS_CONTROLLER_API UShiftAbilityComponent : public UActorComponent {
+  GENERATED_BODY()
+
+public:
+  UShiftAbilityComponent();
+
+  // returns the handle used by every other call, abilities from m_abilities are already registered
+  int32 AddAbility(UAbilityData* ability);
+  const UAbilityData* GetAbility(int32 handle) const { return m_abilities[handle]; }
+
+  // cooldown only, what StartAbility checks before aiming
+  bool IsReady(int32 handle) const;
+  // cooldown and mana
+  bool CanActivate(int32 handle) const;
+  // spends the mana and starts the cooldown, false if CanActivate is
+  bool TryActivate(int32 handle);
+
+  // seconds since the cooldown started, negative while the ability is still active
+  float GetCoolDownElapsed(int32 handle) const;
+  // takes over mana and cooldown from the server
+  void SyncState(int32 handle, float mana, float coolDownElapsed);
+
+  UFUNCTION(BlueprintPure, Category="ShiftAB")
+  float GetMana() const;
+  UFUNCTION(BlueprintPure, Category="ShiftAB")
+  float GetMaxMana() const { return m_maxMana; }
+  float GetRechargeRate() const { return m_rechargeRate; }
+
+protected:
+  virtual void BeginPlay() override;
+
+  UPROPERTY(EditAnywhere, Category="ShiftAB")
+  TArray<UAbilityData*> m_abilities;
+
+  UPROPERTY(EditAnywhere, Category="ShiftAB")
+  float m_maxMana = 100.f;
+
+  // mana per second once the recharge started
+  UPROPERTY(EditAnywhere, Category="ShiftAB")
+  float m_rechargeRate = 10.f;
+
+private:
+  double GetTime() const;
+
+  // parallel to m_abilities
+  TArray<double> m_coolDownStart;
+
+  // mana was m_manaBase at m_rechargeStart and goes up from there
+  float m_manaBase;
+  double m_rechargeStart;
+};
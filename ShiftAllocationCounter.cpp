@@ -0,0 +1,121 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShiftAllocationCounter.h"
+
+#if ENABLE_CHARACTER_STATS
+
+#include "Async/TaskGraphInterfaces.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DelayedAutoRegister.h"
+#include <atomic>
+
+DEFINE_LOG_CATEGORY_STATIC(LogShiftAllocations, Log, All);
+
+namespace {
+  thread_local int32 GShiftAllocationDepth = 0;
+  std::atomic<uint64> GShiftAllocations{0};
+
+  // forwards everything, allocations on a thread inside a scope are counted on the way
+  class FShiftCountingMalloc final : public FMalloc {
+  public:
+    explicit FShiftCountingMalloc(FMalloc* inner) : m_inner(inner) {}
+
+    virtual void* Malloc(SIZE_T count, uint32 alignment) override {
+      Count();
+      return m_inner->Malloc(count, alignment);
+    }
+
+    // only a new block counts, growing or shrinking in place doesn't touch the heap
+    virtual void* Realloc(void* original, SIZE_T count, uint32 alignment) override {
+      void* result = m_inner->Realloc(original, count, alignment);
+      if (count > 0 && result != original) {
+        Count();
+      }
+      return result;
+    }
+
+    virtual void Free(void* original) override { m_inner->Free(original); }
+
+    virtual bool GetAllocationSize(void* original, SIZE_T& outSize) override {
+      return m_inner->GetAllocationSize(original, outSize);
+    }
+
+    virtual SIZE_T QuantizeSize(SIZE_T count, uint32 alignment) override {
+      return m_inner->QuantizeSize(count, alignment);
+    }
+
+    virtual void Trim(bool trimThreadCaches) override { m_inner->Trim(trimThreadCaches); }
+    virtual void SetupTLSCachesOnCurrentThread() override { m_inner->SetupTLSCachesOnCurrentThread(); }
+    virtual void ClearAndDisableTLSCachesOnCurrentThread() override {
+      m_inner->ClearAndDisableTLSCachesOnCurrentThread();
+    }
+    virtual void UpdateStats() override { m_inner->UpdateStats(); }
+    virtual void GetAllocatorStats(FGenericMemoryStats& outStats) override { m_inner->GetAllocatorStats(outStats); }
+    virtual void DumpAllocatorStats(FOutputDevice& ar) override { m_inner->DumpAllocatorStats(ar); }
+    virtual bool IsInternallyThreadSafe() const override { return m_inner->IsInternallyThreadSafe(); }
+    virtual bool ValidateHeap() override { return m_inner->ValidateHeap(); }
+    virtual const TCHAR* GetDescriptiveName() override { return m_inner->GetDescriptiveName(); }
+
+  private:
+    static void Count() {
+      if (GShiftAllocationDepth > 0) {
+        GShiftAllocations.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    FMalloc* m_inner;
+  };
+
+  FShiftCountingMalloc* GShiftCountingMalloc = nullptr;
+
+  // Swapping GMalloc is only safe while nothing else can be allocating, once the task graph runs it is left alone
+  FDelayedAutoRegisterHelper GShiftCountingMallocInstall(EDelayedRegisterRunPhase::StartOfEnginePreInit, [] {
+    uint64 limit = 0;
+    if (!FParse::Value(FCommandLine::Get(), TEXT("ShiftAllocLimit="), limit)) return;
+#if defined(FMEMORY_INLINE_GMalloc)
+    // FMemory calls the platform's allocator class directly, a swapped GMalloc would never be asked
+    UE_LOG(LogShiftAllocations, Warning, TEXT("-ShiftAllocLimit= can't count on this platform, its allocator is fixed"));
+#else
+    if (FTaskGraphInterface::IsRunning()) {
+      UE_LOG(LogShiftAllocations, Warning,
+             TEXT("-ShiftAllocLimit= can't count, the module was loaded after the engine started its threads"));
+      return;
+    }
+    // never removed, whatever it handed out is the inner one's anyway
+    GShiftCountingMalloc = new FShiftCountingMalloc(GMalloc);
+    GMalloc = GShiftCountingMalloc;
+#endif
+  });
+}
+
+bool FShiftAllocationCounter::IsInstalled() {
+  return GShiftCountingMalloc != nullptr;
+}
+
+uint64 FShiftAllocationCounter::GetCount() {
+  return GShiftAllocations.load(std::memory_order_relaxed);
+}
+
+bool FShiftAllocationCounter::CheckLimit(uint64 since) {
+  uint64 limit = 0;
+  if (!FParse::Value(FCommandLine::Get(), TEXT("ShiftAllocLimit="), limit)) return true;
+  const uint64 allocations = GetCount() - FMath::Min(since, GetCount());
+  if (!IsInstalled()) {
+    UE_LOG(LogShiftAllocations, Warning, TEXT("Shift allocations were not counted, the counter is not installed"));
+  }
+  if (allocations <= limit) return true;
+  UE_LOG(LogShiftAllocations, Error,
+         TEXT("Shift query path made %llu heap allocations after warming up, the limit is %llu"), allocations, limit);
+  return false;
+}
+
+FShiftAllocationScope::FShiftAllocationScope() {
+  GShiftAllocationDepth++;
+}
+
+FShiftAllocationScope::~FShiftAllocationScope() {
+  GShiftAllocationDepth--;
+}
+
+#endif
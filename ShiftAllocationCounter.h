@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CharacterStats.h"
+
+#if ENABLE_CHARACTER_STATS
+
+// Counts heap allocations made inside an FShiftAllocationScope, on the thread that opened it. With
+// -ShiftAllocLimit=<n> on the command line GMalloc is wrapped in a counting proxy once, at the start of engine
+// pre-init before any other thread runs, and stays for the rest of the process. A module loaded after that
+// (game modules in the editor) and platforms with a fixed allocator class go without, scopes then only bump a
+// thread local. Used by fps.Shift.AllocBench, the -ShiftAllocLimit= replay gate and the automation tests to
+// hold the shift query path to zero allocations once it has warmed up. Work the batched queries hand to
+// other threads is not counted.
+class FPS_CONTROLLER_API FShiftAllocationCounter {
+public:
+  static bool IsInstalled();
+  static uint64 GetCount();
+  // false when more than -ShiftAllocLimit=<n> were counted after since
+  static bool CheckLimit(uint64 since);
+};
+
+class FPS_CONTROLLER_API FShiftAllocationScope {
+public:
+  FShiftAllocationScope();
+  ~FShiftAllocationScope();
+};
+
+#define SHIFT_ALLOCATION_SCOPE() FShiftAllocationScope ShiftAllocationScope
+
+#else
+
+#define SHIFT_ALLOCATION_SCOPE()
+
+#endif
@@ -0,0 +1,241 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShiftCollisionQuery.h"
+
+#include "Async/ParallelFor.h"
+#include "CharacterDebug.h"
+#include "CharacterStats.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarShiftParallelQueries(
+  TEXT("fps.Shift.ParallelQueries"),
+  true,
+  TEXT("Runs the batched queries of the shift candidate search in parallel under the physics scene read lock."));
+
+namespace {
+  FShiftHit ToShiftHit(const FHitResult& hit) {
+    FShiftHit result;
+    if (hit.bBlockingHit) {
+      result.location = ToShiftVec(hit.Location);
+      result.impactPoint = ToShiftVec(hit.ImpactPoint);
+      result.normal = ToShiftVec(hit.Normal);
+      result.blocking = true;
+    }
+    return result;
+  }
+}
+
+FShiftTraceParams::FShiftTraceParams(const AActor* owner)
+  : line(SCENE_QUERY_STAT(ShiftTrace), false),
+    sweep(SCENE_QUERY_STAT(ShiftTrace), false, owner) {}
+
+FWorldShiftCollisionQuery::FWorldShiftCollisionQuery(UWorld* world, const FShiftTraceParams& params,
+                                                     FCharacterDebugOverlay* debug)
+  : m_world(world),
+    m_params(params),
+    m_debug(debug) {}
+
+FShiftHit FWorldShiftCollisionQuery::Touch(const FHitResult& hit) {
+  const UPrimitiveComponent* component = hit.GetComponent();
+  if (hit.bBlockingHit && component != nullptr && !m_touched.Contains(component)) {
+    // the inline slots are meant to cover a whole solve, count how often they don't
+    if (m_touched.Num() == m_touched.Max()) {
+      CHARACTER_STAT_CALL(ShiftScratchSpill);
+    }
+    m_touched.Add(component);
+  }
+  return ToShiftHit(hit);
+}
+
+bool FWorldShiftCollisionQuery::LineTrace(const FShiftVec& start, const FShiftVec& end, FShiftHit& outHit) {
+  FHitResult hit;
+  const bool blocked = m_world->LineTraceSingleByChannel(hit, ToFVector(start), ToFVector(end), ECC_Visibility,
+                                                         m_params.line);
+#if ENABLE_CHARACTER_DEBUG
+  if (m_debug != nullptr) {
+    CHARACTER_DEBUG_LINE(*m_debug, ToFVector(start), ToFVector(end), blocked ? FColor::Green : FColor::Red);
+  }
+#endif
+  outHit = Touch(hit);
+  return blocked;
+}
+
+bool FWorldShiftCollisionQuery::SphereSweep(const FShiftVec& start, const FShiftVec& end, float radius,
+                                            FShiftHit& outHit) {
+  FHitResult hit;
+  const bool blocked = m_world->SweepSingleByChannel(hit, ToFVector(start), ToFVector(end), FQuat::Identity,
+                                                     ECC_Visibility, FCollisionShape::MakeSphere(radius),
+                                                     m_params.sweep);
+#if ENABLE_CHARACTER_DEBUG
+  if (m_debug != nullptr) {
+    CHARACTER_DEBUG_SPHERE(*m_debug, ToFVector(end), radius, blocked ? FColor::Green : FColor::Red);
+  }
+#endif
+  outHit = Touch(hit);
+  return blocked;
+}
+
+bool FWorldShiftCollisionQuery::CapsuleSweep(const FShiftVec& start, const FShiftVec& end, float radius,
+                                             float halfHeight, FShiftHit& outHit) {
+  FHitResult hit;
+  const bool blocked = m_world->SweepSingleByChannel(hit, ToFVector(start), ToFVector(end), FQuat::Identity,
+                                                     ECC_Visibility,
+                                                     FCollisionShape::MakeCapsule(radius, halfHeight),
+                                                     m_params.sweep);
+#if ENABLE_CHARACTER_DEBUG
+  if (m_debug != nullptr && FCharacterDebugOverlay::IsEnabled(ECharacterDebug::kShift)) {
+    m_debug->Capsule(ToFVector(end), radius, halfHeight, blocked ? FColor::Green : FColor::Red);
+  }
+#endif
+  outHit = Touch(hit);
+  return blocked;
+}
+
+void FWorldShiftCollisionQuery::RunBatch(int count, TFunctionRef<void(int32, FHitResult&)> query,
+                                         FHitResult* outHits) const {
+  const EParallelForFlags flags = CVarShiftParallelQueries.GetValueOnGameThread()
+                                    ? EParallelForFlags::None
+                                    : EParallelForFlags::ForceSingleThread;
+  // each scene query takes the read lock itself. Holding it across the ParallelFor would have the workers
+  // lock again from other threads, which can deadlock behind a waiting writer
+  ParallelFor(count, [&](int32 i) { query(i, outHits[i]); }, flags);
+}
+
+void FWorldShiftCollisionQuery::LineTraceBatch(const FShiftVec* starts, const FShiftVec* ends, int count,
+                                               FShiftHit* outHits) {
+  TArray<FHitResult, TMemStackAllocator<>> hits;
+  hits.SetNum(count);
+  RunBatch(count, [&](int32 i, FHitResult& hit) {
+    m_world->LineTraceSingleByChannel(hit, ToFVector(starts[i]), ToFVector(ends[i]), ECC_Visibility,
+                                      m_params.sweep);
+  }, hits.GetData());
+
+  for (int32 i = 0; i < count; i++) {
+#if ENABLE_CHARACTER_DEBUG
+    if (m_debug != nullptr) {
+      CHARACTER_DEBUG_LINE(*m_debug, ToFVector(starts[i]), ToFVector(ends[i]),
+                           hits[i].bBlockingHit ? FColor::Green : FColor::Red);
+    }
+#endif
+    outHits[i] = Touch(hits[i]);
+  }
+}
+
+void FWorldShiftCollisionQuery::OverlapBatch(const FShiftVec* centers, int count, float radius, float halfHeight,
+                                             FShiftHit* outHits) {
+  // zero length sweeps instead of overlap tests, same as CapsuleSweep, so the blocking component comes back
+  const FCollisionShape shape = FCollisionShape::MakeCapsule(radius, halfHeight);
+  TArray<FHitResult, TMemStackAllocator<>> hits;
+  hits.SetNum(count);
+  RunBatch(count, [&](int32 i, FHitResult& hit) {
+    const FVector center = ToFVector(centers[i]);
+    m_world->SweepSingleByChannel(hit, center, center, FQuat::Identity, ECC_Visibility, shape, m_params.sweep);
+  }, hits.GetData());
+
+  for (int32 i = 0; i < count; i++) {
+#if ENABLE_CHARACTER_DEBUG
+    if (m_debug != nullptr && FCharacterDebugOverlay::IsEnabled(ECharacterDebug::kShift)) {
+      m_debug->Capsule(ToFVector(centers[i]), radius, halfHeight, hits[i].bBlockingHit ? FColor::Green : FColor::Red);
+    }
+#endif
+    outHits[i] = Touch(hits[i]);
+  }
+}
+
+void FAsyncShiftCollisionQuery::Reset(UWorld* world, const FShiftTraceParams& params,
+                                      const FTraceDelegate* delegate) {
+  Cancel();
+  m_world = world;
+  m_params = &params;
+  m_delegate = delegate;
+}
+
+void FAsyncShiftCollisionQuery::Cancel() {
+  // anything still in flight comes back with an old generation and is ignored
+  m_generation++;
+  m_entries.Reset();
+  m_touched.Reset();
+  m_pending = 0;
+}
+
+bool FAsyncShiftCollisionQuery::Receive(const FTraceDatum& datum) {
+  const uint32 index = datum.UserData & 0xF;
+  if ((datum.UserData >> 4) != (m_generation & 0x0FFFFFFF) || !m_entries.IsValidIndex(index)) return false;
+
+  FEntry& entry = m_entries[index];
+  if (entry.received) return false;
+  entry.hit = datum.OutHits.Num() > 0 ? ToShiftHit(datum.OutHits[0]) : FShiftHit();
+  if (entry.hit.blocking && datum.OutHits[0].GetComponent() != nullptr) {
+    m_touched.AddUnique(datum.OutHits[0].GetComponent());
+  }
+  entry.received = true;
+  m_pending--;
+  return m_pending == 0;
+}
+
+bool FAsyncShiftCollisionQuery::LineTrace(const FShiftVec& start, const FShiftVec& end, FShiftHit& outHit) {
+  FEntry key;
+  key.start = start;
+  key.end = end;
+  return Query(key, outHit);
+}
+
+bool FAsyncShiftCollisionQuery::SphereSweep(const FShiftVec& start, const FShiftVec& end, float radius,
+                                            FShiftHit& outHit) {
+  FEntry key;
+  key.start = start;
+  key.end = end;
+  key.radius = radius;
+  key.shape = ECollisionShape::Sphere;
+  return Query(key, outHit);
+}
+
+bool FAsyncShiftCollisionQuery::CapsuleSweep(const FShiftVec& start, const FShiftVec& end, float radius,
+                                             float halfHeight, FShiftHit& outHit) {
+  FEntry key;
+  key.start = start;
+  key.end = end;
+  key.radius = radius;
+  key.halfHeight = halfHeight;
+  key.shape = ECollisionShape::Capsule;
+  return Query(key, outHit);
+}
+
+bool FAsyncShiftCollisionQuery::Query(const FEntry& key, FShiftHit& outHit) {
+  // the solver is deterministic, so the same inputs always rebuild the exact same query
+  for (const FEntry& entry : m_entries) {
+    if (entry.shape == key.shape && entry.start == key.start && entry.end == key.end &&
+      entry.radius == key.radius && entry.halfHeight == key.halfHeight) {
+      outHit = entry.hit;
+      return entry.hit.blocking;
+    }
+  }
+
+  outHit = FShiftHit();
+  outHit.blocking = m_speculateBlocking && key.shape != ECollisionShape::Line;
+  // 4 bits of user data for the index, the cascade never gets near that
+  if (m_entries.Num() >= 16) return outHit.blocking;
+
+  const uint32 userData = ((m_generation & 0x0FFFFFFF) << 4) | m_entries.Num();
+  m_entries.Add(key);
+  m_pending++;
+
+  const FVector start = ToFVector(key.start);
+  const FVector end = ToFVector(key.end);
+  if (key.shape == ECollisionShape::Line) {
+    m_world->AsyncLineTraceByChannel(EAsyncTraceType::Single, start, end, ECC_Visibility,
+                                     m_params->line,
+                                     FCollisionResponseParams::DefaultResponseParam, m_delegate, userData);
+  }
+  else {
+    const FCollisionShape shape = key.shape == ECollisionShape::Sphere
+                                    ? FCollisionShape::MakeSphere(key.radius)
+                                    : FCollisionShape::MakeCapsule(key.radius, key.halfHeight);
+    m_world->AsyncSweepByChannel(EAsyncTraceType::Single, start, end, FQuat::Identity, ECC_Visibility, shape,
+                                 m_params->sweep,
+                                 FCollisionResponseParams::DefaultResponseParam, m_delegate, userData);
+  }
+  return outHit.blocking;
+}
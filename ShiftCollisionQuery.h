@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/MemStack.h"
+#include "WorldCollision.h"
+#include "ShiftLandingSolver.h"
+
+class AActor;
+class UPrimitiveComponent;
+class UWorld;
+class FCharacterDebugOverlay;
+
+// every component a query hit, so cached answers can tell when the collision under them changed
+using FShiftTouchedComponents = TArray<TWeakObjectPtr<const UPrimitiveComponent>, TInlineAllocator<8>>;
+// same for a query that lives inside an FMemMark, past the inline slots it goes to the frame's scratch stack
+using FShiftScratchTouchedComponents =
+  TArray<TWeakObjectPtr<const UPrimitiveComponent>, TInlineAllocator<8, TMemStackAllocator<>>>;
+
+// Query params of one owner, built once and reused by every query: building them walks the owner's
+// components and fills the ignore lists
+struct FPS_CONTROLLER_API FShiftTraceParams {
+  FCollisionQueryParams line;
+  FCollisionQueryParams sweep; // ignores the owner
+
+  explicit FShiftTraceParams(const AActor* owner = nullptr);
+};
+
+inline FShiftVec ToShiftVec(const FVector& v) {
+  return {static_cast<float>(v.X), static_cast<float>(v.Y), static_cast<float>(v.Z)};
+}
+
+inline FVector ToFVector(const FShiftVec& v) { return FVector(v.x, v.y, v.z); }
+
+// Answers the solver straight from the world, on the game thread. Batch hit buffers and touched components
+// past the inline slots come from the thread's FMemStack, keep an FMemMark open for the query's lifetime.
+// Nothing in here touches the heap once the physics scene has warmed up.
+class FWorldShiftCollisionQuery : public IShiftCollisionQuery {
+public:
+  // debug may be null, only used in builds with ENABLE_CHARACTER_DEBUG. params has to outlive the query
+  FWorldShiftCollisionQuery(UWorld* world, const FShiftTraceParams& params, FCharacterDebugOverlay* debug);
+
+  virtual bool LineTrace(const FShiftVec& start, const FShiftVec& end, FShiftHit& outHit) override;
+  virtual bool SphereSweep(const FShiftVec& start, const FShiftVec& end, float radius, FShiftHit& outHit) override;
+  virtual bool CapsuleSweep(const FShiftVec& start, const FShiftVec& end, float radius, float halfHeight,
+                            FShiftHit& outHit) override;
+  // fanned out over the task graph under the scene read lock (fps.Shift.ParallelQueries), touched
+  // components and debug draws are collected on the game thread afterwards
+  virtual void LineTraceBatch(const FShiftVec* starts, const FShiftVec* ends, int count,
+                              FShiftHit* outHits) override;
+  virtual void OverlapBatch(const FShiftVec* centers, int count, float radius, float halfHeight,
+                            FShiftHit* outHits) override;
+
+  TConstArrayView<TWeakObjectPtr<const UPrimitiveComponent>> GetTouchedComponents() const { return m_touched; }
+
+private:
+  FShiftHit Touch(const FHitResult& hit);
+  // runs query(i, hit) for every index, in parallel when allowed
+  void RunBatch(int count, TFunctionRef<void(int32, FHitResult&)> query, FHitResult* outHits) const;
+
+  UWorld* m_world;
+  FShiftScratchTouchedComponents m_touched;
+  const FShiftTraceParams& m_params;
+  FCharacterDebugOverlay* m_debug;
+};
+
+// Answers the solver from async trace results. Every query it has no result for yet is issued as an async
+// trace and answered speculatively for now, so a solver run fires off everything it can in one batch.
+// Run the solver again whenever Receive reports the batch is complete; once a run issues nothing new the
+// solution is final. Only the queries along the branch actually taken end up waiting on each other.
+class FAsyncShiftCollisionQuery : public IShiftCollisionQuery {
+public:
+  // drops everything in flight and starts a fresh chain, params has to outlive it
+  void Reset(UWorld* world, const FShiftTraceParams& params, const FTraceDelegate* delegate);
+  void Cancel();
+  // unknown sweeps answer as blocking instead of a miss, so a second run walks the other side of the
+  // cascade. Line traces always answer as a miss, their hit locations feed later queries.
+  void SetSpeculateBlocking(bool speculate) { m_speculateBlocking = speculate; }
+  // true when the datum belonged to this chain and nothing else is outstanding
+  bool Receive(const FTraceDatum& datum);
+  bool HasPending() const { return m_pending > 0; }
+  const FShiftTouchedComponents& GetTouchedComponents() const { return m_touched; }
+
+  virtual bool LineTrace(const FShiftVec& start, const FShiftVec& end, FShiftHit& outHit) override;
+  virtual bool SphereSweep(const FShiftVec& start, const FShiftVec& end, float radius, FShiftHit& outHit) override;
+  virtual bool CapsuleSweep(const FShiftVec& start, const FShiftVec& end, float radius, float halfHeight,
+                            FShiftHit& outHit) override;
+
+private:
+  struct FEntry {
+    FShiftVec start;
+    FShiftVec end;
+    float radius = 0.f;
+    float halfHeight = 0.f;
+    ECollisionShape::Type shape = ECollisionShape::Line;
+    FShiftHit hit;
+    bool received = false;
+  };
+
+  bool Query(const FEntry& key, FShiftHit& outHit);
+
+  TArray<FEntry, TInlineAllocator<8>> m_entries;
+  FShiftTouchedComponents m_touched;
+  UWorld* m_world = nullptr;
+  const FShiftTraceParams* m_params = nullptr;
+  const FTraceDelegate* m_delegate = nullptr;
+  uint32 m_generation = 0;
+  int32 m_pending = 0;
+  bool m_speculateBlocking = false;
+};
@@ -0,0 +1,50 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShiftLandingBakeCommandlet.h"
+
+#include "Engine/World.h"
+#include "ShiftLandingIndexSubsystem.h"
+#include "UObject/Package.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogShiftLandingBake, Log, All);
+
+int32 UShiftLandingBakeCommandlet::Main(const FString& params) {
+  FString maps;
+  if (!FParse::Value(*params, TEXT("Maps="), maps, false)) {
+    UE_LOG(LogShiftLandingBake, Error, TEXT("Usage: -run=ShiftLandingBake -Maps=/Game/Maps/A+/Game/Maps/B"));
+    return 1;
+  }
+  float cellSize = 100.f;
+  FParse::Value(*params, TEXT("CellSize="), cellSize);
+  const FShiftIndexBakeSettings settings = UShiftLandingIndexSubsystem::MakeBakeSettings(cellSize);
+
+  TArray<FString> mapNames;
+  maps.ParseIntoArray(mapNames, TEXT("+"));
+  int32 failed = 0;
+  for (const FString& mapName : mapNames) {
+    UPackage* package = LoadPackage(nullptr, *mapName, LOAD_None);
+    UWorld* world = package ? UWorld::FindWorldInPackage(package) : nullptr;
+    if (world == nullptr) {
+      UE_LOG(LogShiftLandingBake, Error, TEXT("Could not load %s"), *mapName);
+      failed++;
+      continue;
+    }
+
+    // a loaded map has no physics scene yet, the bake only needs collision registered
+    world->WorldType = EWorldType::Editor;
+    world->AddToRoot();
+    if (!world->bIsWorldInitialized) {
+      world->InitWorld(UWorld::InitializationValues().AllowAudioPlayback(false).CreatePhysicsScene(true));
+    }
+    world->UpdateWorldComponents(true, false);
+
+    TArray<uint8> blob;
+    failed += UShiftLandingIndexSubsystem::BakeToFile(world, settings, blob) ? 0 : 1;
+
+    world->RemoveFromRoot();
+    world->DestroyWorld(false);
+    CollectGarbage(RF_NoFlags);
+  }
+  return failed > 0 ? 1 : 0;
+}
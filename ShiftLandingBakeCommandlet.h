@@ -0,0 +1,18 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ShiftLandingBakeCommandlet.generated.h"
+
+// Bakes the shift landing index of maps without opening them in the editor:
+//   UnrealEditor-Cmd <project> -run=ShiftLandingBake -Maps=/Game/Maps/A+/Game/Maps/B [-CellSize=100]
+// Writes <map>.shiftindex next to every map, logs bake time and index size. Returns non zero if any failed.
+UCLASS()
+class FPS_CONTROLLER_API UShiftLandingBakeCommandlet : public UCommandlet {
+  GENERATED_BODY()
+
+public:
+  virtual int32 Main(const FString& params) override;
+};
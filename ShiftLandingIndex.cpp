@@ -0,0 +1,350 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShiftLandingIndex.h"
+
+#include "Async/MappedFileHandle.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "ShiftCollisionQuery.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogShiftIndex, Log, All);
+
+namespace {
+  // a bake of a whole open world at 1m cells would run for hours, past this the cell size has to go up
+  constexpr int64 kMaxBakeCells = 1 << 26;
+  constexpr int32 kMaxSurfacesPerColumn = 32;
+
+  struct FBakePoint {
+    FVector feet;
+    bool ledge = false;
+  };
+
+  struct FBakeCell {
+    uint8 flags = 0;
+    TArray<FBakePoint, TInlineAllocator<4>> points;
+  };
+
+  FIntVector ToCell(const FVector& location, float cellSize) {
+    return FIntVector(FMath::FloorToInt32(location.X / cellSize), FMath::FloorToInt32(location.Y / cellSize),
+                      FMath::FloorToInt32(location.Z / cellSize));
+  }
+
+  bool IsInCellRange(const FIntVector& cell) {
+    return cell.GetMin() >= MIN_int16 && cell.GetMax() <= MAX_int16;
+  }
+
+  uint16 Quantize(double unit) {
+    return static_cast<uint16>(FMath::Clamp(FMath::RoundToInt32(unit * MAX_uint16), 0, MAX_uint16));
+  }
+}
+
+FShiftLandingIndex::FShiftLandingIndex() = default;
+
+FShiftLandingIndex::~FShiftLandingIndex() {
+  Unload();
+}
+
+// part of the file format, changing it needs a kVersion bump
+uint32 FShiftLandingIndex::HashCell(const FIntVector& cell) {
+  return static_cast<uint32>(cell.X) * 73856093u ^ static_cast<uint32>(cell.Y) * 19349663u ^
+    static_cast<uint32>(cell.Z) * 83492791u;
+}
+
+bool FShiftLandingIndex::Bake(UWorld* world, const FShiftIndexBakeSettings& settings, TArray<uint8>& outBlob,
+                              FShiftIndexBakeReport& outReport) {
+  const double bakeStart = FPlatformTime::Seconds();
+  const float cellSize = settings.cellSize;
+  const float halfHeight = settings.capsuleHalfHeight;
+  const FVector up = FVector::UpVector;
+
+  // only static collision goes in, anything that can move is ignored by every query of the bake
+  FCollisionQueryParams params(SCENE_QUERY_STAT(ShiftIndexBake), false);
+  FBox bounds(ForceInit);
+  for (TActorIterator<AActor> it(world); it; ++it) {
+    it->ForEachComponent<UPrimitiveComponent>(false, [&](UPrimitiveComponent* component) {
+      if (!component->IsCollisionEnabled()) return;
+      if (component->Mobility != EComponentMobility::Static) {
+        params.AddIgnoredComponent(component);
+        return;
+      }
+      bounds += component->Bounds.GetBox();
+    });
+  }
+  if (!bounds.IsValid) {
+    UE_LOG(LogShiftIndex, Error, TEXT("%s has no static collision to bake"), *world->GetName());
+    return false;
+  }
+
+  const FIntVector minCell = ToCell(bounds.Min, cellSize);
+  const FIntVector maxCell = ToCell(bounds.Max, cellSize);
+  const FIntVector dims = maxCell - minCell + FIntVector(1);
+  const int64 cellCount = static_cast<int64>(dims.X) * dims.Y * dims.Z;
+  if (!IsInCellRange(minCell) || !IsInCellRange(maxCell) || cellCount > kMaxBakeCells) {
+    UE_LOG(LogShiftIndex, Error, TEXT("%s is too big to bake at %.0f cm cells (%lld cells)"), *world->GetName(),
+           cellSize, cellCount);
+    return false;
+  }
+
+  TMap<FIntVector, FBakeCell> cells;
+
+  // solid cells, where the ray march stops
+  const FCollisionShape cellShape = FCollisionShape::MakeBox(FVector(cellSize * .5f));
+  for (int32 z = minCell.Z; z <= maxCell.Z; z++) {
+    for (int32 y = minCell.Y; y <= maxCell.Y; y++) {
+      for (int32 x = minCell.X; x <= maxCell.X; x++) {
+        const FVector center = (FVector(x, y, z) + FVector(.5f)) * cellSize;
+        if (world->OverlapBlockingTestByChannel(center, FQuat::Identity, ECC_Visibility, cellShape, params)) {
+          cells.FindOrAdd(FIntVector(x, y, z)).flags |= kCellSolid;
+        }
+      }
+    }
+  }
+
+  // landing spots, every walkable surface down each column with room for the capsule on top of it
+  const float step = cellSize * .5f;
+  const FCollisionShape capsule = FCollisionShape::MakeCapsule(settings.capsuleRadius, halfHeight);
+  const FVector sides[] = {FVector::ForwardVector, FVector::BackwardVector, FVector::RightVector, FVector::LeftVector};
+  int32 pointCount = 0;
+  for (double y = minCell.Y * cellSize + step * .5f; y < (maxCell.Y + 1) * cellSize; y += step) {
+    for (double x = minCell.X * cellSize + step * .5f; x < (maxCell.X + 1) * cellSize; x += step) {
+      double top = bounds.Max.Z + 1;
+      for (int32 surface = 0; surface < kMaxSurfacesPerColumn; surface++) {
+        FHitResult hit;
+        if (!world->LineTraceSingleByChannel(hit, FVector(x, y, top), FVector(x, y, bounds.Min.Z - 1),
+                                             ECC_Visibility, params)) {
+          break;
+        }
+        // line traces pass out of the back of a surface, just below the hit is enough to find the next one
+        top = hit.ImpactPoint.Z - (hit.bStartPenetrating ? step : 1.f);
+        if (hit.bStartPenetrating || hit.ImpactNormal.Z < settings.walkableNormalZ) continue;
+
+        const FVector feet = hit.ImpactPoint;
+        if (world->OverlapBlockingTestByChannel(feet + up * (halfHeight + 1), FQuat::Identity, ECC_Visibility,
+                                                capsule, params)) {
+          continue;
+        }
+        FBakePoint point{feet, false};
+        for (const FVector& side : sides) {
+          const FVector probe = feet + side * (settings.capsuleRadius * 2) + up;
+          FHitResult below;
+          point.ledge |= !world->LineTraceSingleByChannel(below, probe, probe - up * halfHeight, ECC_Visibility,
+                                                          params);
+        }
+
+        FBakeCell& cell = cells.FindOrAdd(ToCell(feet, cellSize));
+        if (cell.points.Num() < MAX_uint8) {
+          cell.points.Add(point);
+          pointCount++;
+          outReport.ledges += point.ledge ? 1 : 0;
+        }
+      }
+    }
+  }
+
+  // half full at most, so every probe sequence ends on an empty slot
+  const uint32 tableSize = FMath::RoundUpToPowerOfTwo(FMath::Max(cells.Num() * 2, 16));
+  outBlob.SetNumZeroed(sizeof(FHeader) + tableSize * sizeof(FCell) + pointCount * sizeof(FPoint));
+  FHeader* header = reinterpret_cast<FHeader*>(outBlob.GetData());
+  header->magic = kMagic;
+  header->version = kVersion;
+  header->cellSize = cellSize;
+  header->capsuleRadius = settings.capsuleRadius;
+  header->capsuleHalfHeight = halfHeight;
+  header->tableSize = tableSize;
+  header->pointCount = pointCount;
+
+  FCell* table = reinterpret_cast<FCell*>(header + 1);
+  FPoint* points = reinterpret_cast<FPoint*>(table + tableSize);
+  uint32 nextPoint = 0;
+  for (const TPair<FIntVector, FBakeCell>& pair : cells) {
+    uint32 slot = HashCell(pair.Key) & (tableSize - 1);
+    while (table[slot].flags & kCellUsed) {
+      slot = (slot + 1) & (tableSize - 1);
+    }
+    FCell& cell = table[slot];
+    cell.x = static_cast<int16>(pair.Key.X);
+    cell.y = static_cast<int16>(pair.Key.Y);
+    cell.z = static_cast<int16>(pair.Key.Z);
+    cell.flags = kCellUsed | pair.Value.flags;
+    cell.pointCount = static_cast<uint8>(pair.Value.points.Num());
+    cell.firstPoint = nextPoint;
+    for (const FBakePoint& point : pair.Value.points) {
+      const FVector local = point.feet / cellSize - FVector(pair.Key);
+      points[nextPoint++] = {Quantize(local.X), Quantize(local.Y), Quantize(local.Z),
+                             static_cast<uint16>(point.ledge ? kPointLedge : 0)};
+    }
+    outReport.solidCells += (pair.Value.flags & kCellSolid) ? 1 : 0;
+  }
+
+  outReport.cells = cells.Num();
+  outReport.points = pointCount;
+  outReport.bytes = outBlob.Num();
+  outReport.seconds = FPlatformTime::Seconds() - bakeStart;
+  return true;
+}
+
+FString FShiftLandingIndex::GetIndexPath(const UWorld* world) {
+  const FString packageName = UWorld::RemovePIEPrefix(world->GetOutermost()->GetName());
+  return FPackageName::LongPackageNameToFilename(packageName, TEXT(".shiftindex"));
+}
+
+bool FShiftLandingIndex::Load(const FString& path) {
+  Unload();
+  IPlatformFile& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+  m_mappedFile.Reset(platformFile.OpenMapped(*path));
+  if (m_mappedFile.IsValid()) {
+    m_mappedRegion.Reset(m_mappedFile->MapRegion());
+    if (m_mappedRegion.IsValid()) return Attach(m_mappedRegion->GetMappedPtr(), m_mappedRegion->GetMappedSize());
+    m_mappedFile.Reset();
+  }
+
+  TArray<uint8> blob;
+  if (!FFileHelper::LoadFileToArray(blob, *path, FILEREAD_Silent)) return false;
+  return Load(MoveTemp(blob));
+}
+
+bool FShiftLandingIndex::Load(TArray<uint8>&& blob) {
+  Unload();
+  m_ownedData = MoveTemp(blob);
+  return Attach(m_ownedData.GetData(), m_ownedData.Num());
+}
+
+void FShiftLandingIndex::Unload() {
+  m_header = nullptr;
+  m_cells = nullptr;
+  m_points = nullptr;
+  m_size = 0;
+  m_mappedRegion.Reset();
+  m_mappedFile.Reset();
+  m_ownedData.Empty();
+}
+
+bool FShiftLandingIndex::Attach(const uint8* data, int64 size) {
+  const FHeader* header = reinterpret_cast<const FHeader*>(data);
+  bool valid = size >= static_cast<int64>(sizeof(FHeader)) && header->magic == kMagic &&
+    header->version == kVersion && FMath::IsPowerOfTwo(header->tableSize) &&
+    size == static_cast<int64>(sizeof(FHeader) + static_cast<uint64>(header->tableSize) * sizeof(FCell) +
+      static_cast<uint64>(header->pointCount) * sizeof(FPoint));
+  if (valid) {
+    // every probe needs an empty slot to end on and every cell's points inside the point array, the
+    // lookups trust both from here on
+    const FCell* cells = reinterpret_cast<const FCell*>(header + 1);
+    uint32 used = 0;
+    for (uint32 slot = 0; slot < header->tableSize && valid; slot++) {
+      const FCell& cell = cells[slot];
+      if (!(cell.flags & kCellUsed)) continue;
+      used++;
+      valid = static_cast<uint64>(cell.firstPoint) + cell.pointCount <= header->pointCount;
+    }
+    valid &= used < header->tableSize;
+  }
+  if (!valid) {
+    UE_LOG(LogShiftIndex, Warning, TEXT("Shift index is stale or damaged, rebake it"));
+    Unload();
+    return false;
+  }
+
+  m_header = header;
+  m_cells = reinterpret_cast<const FCell*>(header + 1);
+  m_points = reinterpret_cast<const FPoint*>(m_cells + header->tableSize);
+  m_size = size;
+  return true;
+}
+
+const FShiftLandingIndex::FCell* FShiftLandingIndex::FindCell(const FIntVector& cell) const {
+  if (!IsInCellRange(cell)) return nullptr;
+  const uint32 mask = m_header->tableSize - 1;
+  uint32 slot = HashCell(cell) & mask;
+  // Attach made sure there is an empty slot, the bound only keeps a table that changed under the mapping
+  // from spinning
+  for (uint32 probe = 0; probe < m_header->tableSize; probe++, slot = (slot + 1) & mask) {
+    const FCell& entry = m_cells[slot];
+    if (!(entry.flags & kCellUsed)) return nullptr;
+    if (entry.x == cell.X && entry.y == cell.Y && entry.z == cell.Z) return &entry;
+  }
+  return nullptr;
+}
+
+FVector FShiftLandingIndex::GetPointLocation(const FCell& cell, const FPoint& point) const {
+  const FVector local = FVector(point.x, point.y, point.z) / MAX_uint16;
+  return (FVector(cell.x, cell.y, cell.z) + local) * m_header->cellSize;
+}
+
+bool FShiftLandingIndex::Query(const FShiftQueryParams& params, FShiftSolution& outSolution) const {
+  if (!IsLoaded() || params.capsuleRadius > m_header->capsuleRadius + 1.f ||
+    params.capsuleHalfHeight > m_header->capsuleHalfHeight + 1.f) {
+    return false;
+  }
+
+  const float cellSize = m_header->cellSize;
+  const FVector start = ToFVector(params.start);
+  const FVector delta = ToFVector(params.end) - start;
+
+  // Amanatides & Woo over the cells along the ray, the camera's own cell never stops it
+  FIntVector cell = ToCell(start, cellSize);
+  FIntVector lastFree = cell;
+  FIntVector step;
+  FVector tMax;
+  FVector tDelta;
+  for (int32 axis = 0; axis < 3; axis++) {
+    const double d = delta[axis];
+    step[axis] = d > 0 ? 1 : (d < 0 ? -1 : 0);
+    const double boundary = (cell[axis] + (d > 0 ? 1 : 0)) * cellSize;
+    tMax[axis] = d != 0 ? (boundary - start[axis]) / d : BIG_NUMBER;
+    tDelta[axis] = d != 0 ? cellSize / FMath::Abs(d) : BIG_NUMBER;
+  }
+  double tStop = 1;
+  bool hitSolid = false;
+  while (true) {
+    const int32 axis = tMax.X < tMax.Y ? (tMax.X < tMax.Z ? 0 : 2) : (tMax.Y < tMax.Z ? 1 : 2);
+    if (tMax[axis] > 1) break;
+    const double tEnter = tMax[axis];
+    cell[axis] += step[axis];
+    tMax[axis] += tDelta[axis];
+    const FCell* entry = FindCell(cell);
+    if (entry != nullptr && (entry->flags & kCellSolid)) {
+      tStop = tEnter;
+      hitSolid = true;
+      break;
+    }
+    lastFree = cell;
+  }
+
+  // closest spot around the last free cell, two cells down so floors under it are found too
+  const FVector stop = start + delta * tStop;
+  const FVector centerOffset = FVector::UpVector * (params.capsuleHalfHeight + 1);
+  double bestDistSq = FMath::Square(cellSize * 1.5f + params.capsuleHalfHeight);
+  const FPoint* best = nullptr;
+  FVector bestCenter;
+  for (int32 z = -2; z <= 1; z++) {
+    for (int32 y = -1; y <= 1; y++) {
+      for (int32 x = -1; x <= 1; x++) {
+        const FCell* entry = FindCell(lastFree + FIntVector(x, y, z));
+        if (entry == nullptr) continue;
+        for (uint32 i = entry->firstPoint; i < entry->firstPoint + entry->pointCount; i++) {
+          const FVector center = GetPointLocation(*entry, m_points[i]) + centerOffset;
+          const double distSq = FVector::DistSquared(center, stop);
+          if (distSq < bestDistSq) {
+            bestDistSq = distSq;
+            best = &m_points[i];
+            bestCenter = center;
+          }
+        }
+      }
+    }
+  }
+  if (best == nullptr) return false;
+
+  outSolution.location = ToShiftVec(bestCenter);
+  outSolution.aimLocation = ToShiftVec(stop);
+  outSolution.flags = static_cast<uint8_t>((hitSolid ? 1 : 0) | 2 | ((best->flags & kPointLedge) ? 4 : 0));
+  outSolution.queryCount = 0;
+  outSolution.branch = EShiftBranch::kIndexed;
+  outSolution.canShift = true;
+  return true;
+}
@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShiftLandingSolver.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+class UWorld;
+
+struct FShiftIndexBakeSettings {
+  float cellSize = 100.f;
+  float capsuleRadius = 34.f;
+  float capsuleHalfHeight = 88.f;
+  float walkableNormalZ = .7f;
+};
+
+struct FShiftIndexBakeReport {
+  double seconds = 0;
+  int32 cells = 0;
+  int32 solidCells = 0;
+  int32 points = 0;
+  int32 ledges = 0;
+  int64 bytes = 0;
+};
+
+// Landing spots of a level baked from its static collision, so a shift can be answered without tracing the
+// whole cascade. A sparse voxel grid: only cells that touch geometry or hold a spot are stored, in an open
+// addressing hash. The blob is the exact in-memory layout (native endian) so it is mapped straight from disk.
+// Movable components are not baked, a hit from the index still needs one sweep against the live world.
+class FPS_CONTROLLER_API FShiftLandingIndex {
+public:
+  FShiftLandingIndex();
+  ~FShiftLandingIndex();
+
+  // samples the world on a grid, slow, meant for the editor (see UShiftLandingBakeCommandlet)
+  static bool Bake(UWorld* world, const FShiftIndexBakeSettings& settings, TArray<uint8>& outBlob,
+                   FShiftIndexBakeReport& outReport);
+  // <map>.shiftindex next to the map package
+  static FString GetIndexPath(const UWorld* world);
+
+  // maps the file when the platform can, reads it into memory otherwise
+  bool Load(const FString& path);
+  bool Load(TArray<uint8>&& blob);
+  void Unload();
+  bool IsLoaded() const { return m_header != nullptr; }
+  int64 GetSize() const { return m_size; }
+
+  // Marches the aim ray through the grid up to the first solid cell and picks the closest baked spot around
+  // where it stopped. False when the capsule is bigger than the baked one or there is no spot close enough,
+  // the caller falls back to the solver then.
+  bool Query(const FShiftQueryParams& params, FShiftSolution& outSolution) const;
+
+private:
+  static constexpr uint32 kMagic = 0x58494C53; // SLIX
+  static constexpr uint32 kVersion = 1;
+  static constexpr uint8 kCellUsed = 1 << 0;
+  static constexpr uint8 kCellSolid = 1 << 1;
+  static constexpr uint16 kPointLedge = 1 << 0;
+
+  struct FHeader {
+    uint32 magic;
+    uint32 version;
+    float cellSize;
+    float capsuleRadius;
+    float capsuleHalfHeight;
+    uint32 tableSize; // power of two
+    uint32 pointCount;
+  };
+
+  struct FCell {
+    int16 x;
+    int16 y;
+    int16 z;
+    uint8 flags;
+    uint8 pointCount;
+    uint32 firstPoint;
+  };
+
+  // feet location quantized inside its cell
+  struct FPoint {
+    uint16 x;
+    uint16 y;
+    uint16 z;
+    uint16 flags;
+  };
+
+  bool Attach(const uint8* data, int64 size);
+  const FCell* FindCell(const FIntVector& cell) const;
+  FVector GetPointLocation(const FCell& cell, const FPoint& point) const;
+  static uint32 HashCell(const FIntVector& cell);
+
+  TUniquePtr<IMappedFileHandle> m_mappedFile;
+  TUniquePtr<IMappedFileRegion> m_mappedRegion; // released before the handle
+  TArray<uint8> m_ownedData;
+  const FHeader* m_header = nullptr;
+  const FCell* m_cells = nullptr;
+  const FPoint* m_points = nullptr;
+  int64 m_size = 0;
+};
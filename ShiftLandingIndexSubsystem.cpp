@@ -0,0 +1,145 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShiftLandingIndexSubsystem.h"
+
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "PlayerCharacter.h"
+#include "ShiftCollisionQuery.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogShiftIndexSubsystem, Log, All);
+
+namespace {
+  FAutoConsoleCommandWithWorldAndArgs CmdBakeIndex(
+    TEXT("fps.Shift.BakeIndex"),
+    TEXT("Bakes the shift landing index of the current world next to its map and uses it right away. ")
+    TEXT("Argument: cell size in cm (default 100)."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& args, UWorld* world) {
+      UShiftLandingIndexSubsystem* index = world ? world->GetSubsystem<UShiftLandingIndexSubsystem>() : nullptr;
+      if (index == nullptr) return;
+      index->Rebake(args.Num() > 0 ? FCString::Atof(*args[0]) : 100.f);
+    }));
+
+  FAutoConsoleCommandWithWorldAndArgs CmdBenchIndex(
+    TEXT("fps.Shift.IndexBench"),
+    TEXT("Times N shift lookups from the local player's view, landing index against the trace cascade. ")
+    TEXT("Argument: lookup count (default 1000)."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& args, UWorld* world) {
+      const UShiftLandingIndexSubsystem* index =
+        world ? world->GetSubsystem<UShiftLandingIndexSubsystem>() : nullptr;
+      if (index == nullptr) return;
+      index->RunBenchmark(FMath::Max(args.Num() > 0 ? FCString::Atoi(*args[0]) : 1000, 1));
+    }));
+}
+
+FShiftIndexBakeSettings UShiftLandingIndexSubsystem::MakeBakeSettings(float cellSize) {
+  FShiftIndexBakeSettings settings;
+  settings.cellSize = FMath::Max(cellSize, 10.f);
+  const UCapsuleComponent* capsule = GetDefault<APlayerCharacter>()->GetCapsuleComponent();
+  settings.capsuleRadius = capsule->GetUnscaledCapsuleRadius();
+  settings.capsuleHalfHeight = capsule->GetUnscaledCapsuleHalfHeight();
+  return settings;
+}
+
+bool UShiftLandingIndexSubsystem::BakeToFile(UWorld* world, const FShiftIndexBakeSettings& settings,
+                                             TArray<uint8>& outBlob) {
+  FShiftIndexBakeReport report;
+  if (!FShiftLandingIndex::Bake(world, settings, outBlob, report)) return false;
+
+  const FString path = FShiftLandingIndex::GetIndexPath(world);
+  if (!FFileHelper::SaveArrayToFile(outBlob, *path)) {
+    UE_LOG(LogShiftIndexSubsystem, Error, TEXT("Could not write the shift index to %s"), *path);
+    return false;
+  }
+  UE_LOG(LogShiftIndexSubsystem, Display,
+         TEXT("Baked %s in %.2f s: %d cells (%d solid), %d landing spots (%d ledges), %.1f KB at %.0f cm cells"),
+         *FPaths::GetCleanFilename(path), report.seconds, report.cells, report.solidCells, report.points,
+         report.ledges, report.bytes / 1024.0, settings.cellSize);
+  return true;
+}
+
+bool UShiftLandingIndexSubsystem::Rebake(float cellSize) {
+  TArray<uint8> blob;
+  if (!BakeToFile(GetWorld(), MakeBakeSettings(cellSize), blob)) return false;
+  return m_index.Load(MoveTemp(blob));
+}
+
+void UShiftLandingIndexSubsystem::RunBenchmark(int32 count) const {
+  UWorld* world = GetWorld();
+  const APlayerController* controller = world->GetFirstPlayerController();
+  const APlayerCharacter* character = controller ? Cast<APlayerCharacter>(controller->GetPawn()) : nullptr;
+  if (character == nullptr) {
+    UE_LOG(LogShiftIndexSubsystem, Warning, TEXT("fps.Shift.IndexBench needs a local player character"));
+    return;
+  }
+  if (!m_index.IsLoaded()) {
+    UE_LOG(LogShiftIndexSubsystem, Warning, TEXT("No shift index loaded, bake one with fps.Shift.BakeIndex"));
+    return;
+  }
+
+  FVector viewLocation;
+  FRotator viewRotation;
+  controller->GetPlayerViewPoint(viewLocation, viewRotation);
+  FShiftQueryParams params;
+  params.start = ToShiftVec(viewLocation);
+  params.forward = ToShiftVec(character->GetActorForwardVector());
+  params.capsuleRadius = character->GetCapsuleComponent()->GetUnscaledCapsuleRadius();
+  params.capsuleHalfHeight = character->GetCapsuleComponent()->GetUnscaledCapsuleHalfHeight();
+
+  // the same aims for both, spread over a cone around the view
+  const FShiftTraceParams traceParams(character);
+  FRandomStream random(1234);
+  double indexSeconds = 0;
+  double cascadeSeconds = 0;
+  double distance = 0;
+  int32 found = 0;
+  int32 confirmed = 0;
+  for (int32 i = 0; i < count; i++) {
+    const FVector direction = random.VRandCone(viewRotation.Vector(), FMath::DegreesToRadians(30.f));
+    params.end = ToShiftVec(viewLocation + direction * 800);
+    FMemMark scratch(FMemStack::Get());
+    FWorldShiftCollisionQuery query(world, traceParams, nullptr);
+
+    // lookup plus the confirmation sweep, what a shift pays when the index answers
+    uint64 start = FPlatformTime::Cycles64();
+    FShiftSolution indexed;
+    FShiftHit hit;
+    const bool hasSpot = m_index.Query(params, indexed);
+    const bool clear = hasSpot && !query.CapsuleSweep(params.start, indexed.location, params.capsuleRadius,
+                                                      params.capsuleHalfHeight, hit);
+    indexSeconds += FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - start);
+
+    start = FPlatformTime::Cycles64();
+    const FShiftSolution solved = FShiftLandingSolver::Solve(query, params);
+    cascadeSeconds += FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - start);
+
+    found += hasSpot ? 1 : 0;
+    if (clear) {
+      confirmed++;
+      distance += FVector::Dist(ToFVector(indexed.location), ToFVector(solved.location));
+    }
+  }
+
+  UE_LOG(LogShiftIndexSubsystem, Display,
+         TEXT("Shift lookups over %d aims: index %.2f us avg, cascade %.2f us avg. Index answered %d, %d confirmed, ")
+         TEXT("%.1f cm from the cascade's spot on average. Index is %.1f KB"),
+         count, indexSeconds * 1e6 / count, cascadeSeconds * 1e6 / count, found, confirmed,
+         distance / FMath::Max(confirmed, 1), m_index.GetSize() / 1024.0);
+}
+
+void UShiftLandingIndexSubsystem::OnWorldBeginPlay(UWorld& world) {
+  Super::OnWorldBeginPlay(world);
+  const FString path = FShiftLandingIndex::GetIndexPath(&world);
+  if (FPaths::FileExists(path) && m_index.Load(path)) {
+    UE_LOG(LogShiftIndexSubsystem, Log, TEXT("Loaded shift index %s, %.1f KB"), *path, m_index.GetSize() / 1024.0);
+  }
+}
+
+void UShiftLandingIndexSubsystem::Deinitialize() {
+  m_index.Unload();
+  Super::Deinitialize();
+}
@@ -0,0 +1,35 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShiftLandingIndex.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShiftLandingIndexSubsystem.generated.h"
+
+// Loads the level's baked shift index (<map>.shiftindex) when play begins. Without one GetIndex returns
+// null and the characters keep solving live.
+// fps.Shift.BakeIndex [cellSize] bakes the current world and swaps the result in,
+// fps.Shift.IndexBench [N] times index lookups against the trace cascade from the local player's view.
+UCLASS()
+class FPS_CONTROLLER_API UShiftLandingIndexSubsystem : public UWorldSubsystem {
+  GENERATED_BODY()
+
+public:
+  const FShiftLandingIndex* GetIndex() const { return m_index.IsLoaded() ? &m_index : nullptr; }
+
+  // bakes the current world, writes the file and uses it right away
+  bool Rebake(float cellSize);
+  void RunBenchmark(int32 count) const;
+
+  // the capsule the player character spawns with, what the index has to fit
+  static FShiftIndexBakeSettings MakeBakeSettings(float cellSize);
+  // bakes and writes <map>.shiftindex, logs bake time and size
+  static bool BakeToFile(UWorld* world, const FShiftIndexBakeSettings& settings, TArray<uint8>& outBlob);
+
+  virtual void OnWorldBeginPlay(UWorld& world) override;
+  virtual void Deinitialize() override;
+
+private:
+  FShiftLandingIndex m_index;
+};
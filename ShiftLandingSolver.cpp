@@ -0,0 +1,277 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShiftLandingSolver.h"
+
+#include <bitset>
+#include <cmath>
+#include <limits>
+
+static_assert(1 + 3 * FShiftLandingSolver::kCandidates <= UINT8_MAX, "queryCount is a uint8_t");
+
+namespace {
+  // counts every query the cascade makes
+  class FCountingQuery : public IShiftCollisionQuery {
+  public:
+    explicit FCountingQuery(IShiftCollisionQuery& inner) : m_inner(inner) {}
+
+    virtual bool LineTrace(const FShiftVec& start, const FShiftVec& end, FShiftHit& outHit) override {
+      m_count++;
+      return m_inner.LineTrace(start, end, outHit);
+    }
+
+    virtual bool SphereSweep(const FShiftVec& start, const FShiftVec& end, float radius, FShiftHit& outHit) override {
+      m_count++;
+      return m_inner.SphereSweep(start, end, radius, outHit);
+    }
+
+    virtual bool CapsuleSweep(const FShiftVec& start, const FShiftVec& end, float radius, float halfHeight,
+                              FShiftHit& outHit) override {
+      m_count++;
+      return m_inner.CapsuleSweep(start, end, radius, halfHeight, outHit);
+    }
+
+    virtual void LineTraceBatch(const FShiftVec* starts, const FShiftVec* ends, int count,
+                                FShiftHit* outHits) override {
+      m_count += static_cast<uint8_t>(count);
+      m_inner.LineTraceBatch(starts, ends, count, outHits);
+    }
+
+    virtual void OverlapBatch(const FShiftVec* centers, int count, float radius, float halfHeight,
+                              FShiftHit* outHits) override {
+      m_count += static_cast<uint8_t>(count);
+      m_inner.OverlapBatch(centers, count, radius, halfHeight, outHits);
+    }
+
+    uint8_t m_count = 0;
+
+  private:
+    IShiftCollisionQuery& m_inner;
+  };
+
+  // candidate layout, the order is also the tie break when two score the same
+  constexpr int kLedgeCandidates = 2;
+  constexpr int kRingCandidates = 10;
+  constexpr int kPullbackCandidates = 3;
+  constexpr int kFirstLedge = 1;
+  constexpr int kFirstRing = kFirstLedge + kLedgeCandidates;
+  constexpr int kFirstPullback = kFirstRing + kRingCandidates;
+  static_assert(kFirstPullback + kPullbackCandidates == FShiftLandingSolver::kCandidates);
+
+  constexpr float kPi = 3.14159265f;
+  constexpr float kWalkableNormalZ = .7f;
+  constexpr float kRejected = -1e30f;
+
+  EShiftBranch GetCandidateBranch(int index) {
+    if (index < kFirstLedge) return EShiftBranch::kCandidateAim;
+    if (index < kFirstRing) return EShiftBranch::kCandidateLedge;
+    if (index < kFirstPullback) return EShiftBranch::kCandidateRing;
+    return EShiftBranch::kCandidatePullback;
+  }
+
+  float Length(const FShiftVec& v) {
+    return std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+  }
+
+  const char* const GBranchNames[] = {
+    "Surface", "Ledge", "SurfaceSweep", "OpenAir", "OpenAirOverlap", "OpenAirSweep", "CandidateAim",
+    "CandidateLedge", "CandidateRing", "CandidatePullback", "Indexed",
+  };
+  static_assert(sizeof(GBranchNames) / sizeof(GBranchNames[0]) == static_cast<size_t>(EShiftBranch::kCount),
+                "one name per branch");
+}
+
+const char* GetShiftBranchName(EShiftBranch branch) {
+  const size_t index = static_cast<size_t>(branch);
+  return index < static_cast<size_t>(EShiftBranch::kCount) ? GBranchNames[index] : "Unknown";
+}
+
+FShiftSolution FShiftLandingSolver::Solve(IShiftCollisionQuery& inQuery, const FShiftQueryParams& params) {
+  constexpr float kEpsilon = std::numeric_limits<float>::epsilon();
+  const FShiftVec up{0.f, 0.f, 1.f};
+  const float radius = params.capsuleRadius;
+  const float halfHeight = params.capsuleHalfHeight;
+
+  FCountingQuery query(inQuery);
+  FShiftSolution solution;
+  std::bitset<8> flagChecks{0b0000'0000};
+  FShiftHit hitResult;
+  FShiftHit outHitResult;
+  FShiftVec end = params.end;
+  FShiftVec endLocation;
+  bool overrideLocation = false; // quick hack
+
+  flagChecks.set(0, query.LineTrace(params.start, end, hitResult));
+
+  // first contact with something
+  if (flagChecks[0]) {
+    solution.aimLocation = hitResult.location;
+    const bool isSurfaceNormalZ = (std::fabs(hitResult.normal.x) < kEpsilon && std::fabs(hitResult.normal.y) <
+      kEpsilon);
+
+    // handling the wall/climbable check
+    FShiftHit surfaceResult;
+    const float scaleWallThreshold = halfHeight / 2;
+    const FShiftVec lineStart = hitResult.impactPoint + params.forward * radius;
+    const FShiftVec lineEnd = lineStart + up * scaleWallThreshold;
+    if (!isSurfaceNormalZ && query.LineTrace(lineEnd, lineStart, surfaceResult)) {
+      const FShiftVec sphereStart = surfaceResult.location + up * halfHeight;
+      const FShiftVec sphereEnd = surfaceResult.location + up * halfHeight * 2;
+
+      // Checks if clipping with object from mental location
+      flagChecks.set(1, query.SphereSweep(sphereStart, sphereEnd, radius, outHitResult));
+      if (!flagChecks[1]) {
+        endLocation = sphereStart;
+        overrideLocation = true;
+        solution.branch = EShiftBranch::kLedge;
+      }
+    }
+
+    const FShiftVec capsulePositionOffset = hitResult.location + (hitResult.normal * halfHeight / (
+      (isSurfaceNormalZ) ? 1 : 2) + up);
+
+    // location sweep
+    flagChecks.set(2, query.CapsuleSweep(capsulePositionOffset, capsulePositionOffset, radius, halfHeight,
+                                         hitResult));
+
+    // mainly checks if contact with the wall and the capsule clips with the floor, is it still valid by check
+    // the area above.
+    if (flagChecks[2]) {
+      flagChecks.set(3, query.SphereSweep(capsulePositionOffset + up * halfHeight * .25f,
+                                          capsulePositionOffset + up * halfHeight * 1.75f, radius,
+                                          outHitResult));
+    }
+
+    // between the player and the desired location sweep
+    if (flagChecks[2] && (flagChecks[1] || flagChecks[3])) {
+      query.CapsuleSweep(params.start, end, radius, halfHeight, hitResult);
+      overrideLocation = true;
+      endLocation = hitResult.location;
+      solution.branch = EShiftBranch::kSurfaceSweep;
+    }
+    if (!overrideLocation) {
+      endLocation = capsulePositionOffset;
+      solution.branch = EShiftBranch::kSurface;
+    }
+  }
+  else {
+    solution.aimLocation = end;
+    solution.branch = EShiftBranch::kOpenAir;
+    flagChecks.set(1, query.CapsuleSweep(end, end, radius, halfHeight, hitResult));
+
+    if (flagChecks[1]) {
+      solution.branch = EShiftBranch::kOpenAirOverlap;
+      flagChecks.set(2, query.SphereSweep(end + up * halfHeight * .5f, end + up * halfHeight * 2, radius,
+                                          outHitResult));
+
+      if (flagChecks[2]) {
+        flagChecks.set(3, query.CapsuleSweep(params.start, end, radius, halfHeight, hitResult));
+        end = hitResult.location; // this still works cause order of operation
+        solution.branch = EShiftBranch::kOpenAirSweep;
+      }
+    }
+    endLocation = end;
+  }
+
+  solution.flags = static_cast<uint8_t>(flagChecks.to_ulong());
+  solution.queryCount = query.m_count;
+  // AKA the last valid option
+  solution.canShift = !flagChecks.all();
+  solution.location = endLocation;
+  return solution;
+}
+
+FShiftSolution FShiftLandingSolver::SolveCandidates(IShiftCollisionQuery& inQuery, const FShiftQueryParams& params) {
+  constexpr int kCount = kCandidates;
+  const FShiftVec up{0.f, 0.f, 1.f};
+  const float radius = params.capsuleRadius;
+  const float halfHeight = params.capsuleHalfHeight;
+
+  FCountingQuery query(inQuery);
+  FShiftSolution solution;
+  FShiftHit aimHit;
+  const bool aimBlocked = query.LineTrace(params.start, params.end, aimHit);
+
+  // on a hit the aim point is pushed off the surface by the radius, the ledge probes start on the far side of
+  // the wall, above the impact
+  const FShiftVec aimPoint = aimBlocked ? aimHit.impactPoint + aimHit.normal * (radius + 1.f) : params.end;
+  solution.aimLocation = aimBlocked ? aimHit.location : params.end;
+
+  FShiftVec probes[kCount];
+  float valid[kCount];
+  for (int i = 0; i < kCount; i++) {
+    valid[i] = 1.f;
+  }
+  probes[0] = aimPoint;
+  for (int i = 0; i < kLedgeCandidates; i++) {
+    // without a wall there is no ledge, the probes still go out so the batches keep their size
+    valid[kFirstLedge + i] = aimBlocked ? 1.f : 0.f;
+    probes[kFirstLedge + i] = aimHit.impactPoint + params.forward * (radius * 2) + up * (halfHeight * (i + 1));
+  }
+  const float ringRadius = radius * 3;
+  for (int i = 0; i < kRingCandidates; i++) {
+    const float angle = 2 * kPi * i / kRingCandidates;
+    probes[kFirstRing + i] = aimPoint + FShiftVec{std::cos(angle), std::sin(angle), 0.f} * ringRadius;
+  }
+  for (int i = 0; i < kPullbackCandidates; i++) {
+    const float along = 1.f - .25f * (i + 1);
+    probes[kFirstPullback + i] = params.start + (aimPoint - params.start) * along;
+  }
+
+  // floor projection, a probe with nothing under it stays where it is and lands in the air like the open air
+  // branch of the cascade does
+  FShiftVec traceStarts[kCount];
+  FShiftVec traceEnds[kCount];
+  FShiftHit floorHits[kCount];
+  for (int i = 0; i < kCount; i++) {
+    traceStarts[i] = probes[i] + up * (halfHeight * 2);
+    traceEnds[i] = probes[i] - up * (halfHeight * 3);
+  }
+  query.LineTraceBatch(traceStarts, traceEnds, kCount, floorHits);
+
+  FShiftVec centers[kCount];
+  for (int i = 0; i < kCount; i++) {
+    centers[i] = floorHits[i].blocking ? floorHits[i].impactPoint + up * (halfHeight + 1.f) : probes[i];
+  }
+
+  FShiftHit overlapHits[kCount];
+  query.OverlapBatch(centers, kCount, radius, halfHeight, overlapHits);
+
+  // has to be reachable from the camera, otherwise the ring happily picks the other side of a wall
+  FShiftVec sightStarts[kCount];
+  FShiftHit sightHits[kCount];
+  for (int i = 0; i < kCount; i++) {
+    sightStarts[i] = params.start;
+  }
+  query.LineTraceBatch(sightStarts, centers, kCount, sightHits);
+
+  // scoring runs over flat arrays without branches so it vectorizes, lower distance to the aim point wins,
+  // standing on a walkable floor and being the aim candidate itself break ties
+  float grounded[kCount];
+  float distance[kCount];
+  float score[kCount];
+  for (int i = 0; i < kCount; i++) {
+    const float walkable = floorHits[i].normal.z >= kWalkableNormalZ ? 1.f : 0.f;
+    grounded[i] = floorHits[i].blocking ? walkable : 0.f;
+    const bool blocked = overlapHits[i].blocking || sightHits[i].blocking || (floorHits[i].blocking && walkable == 0.f);
+    valid[i] *= blocked ? 0.f : 1.f;
+    distance[i] = Length(centers[i] - aimPoint);
+  }
+  const float invRing = 1.f / (ringRadius > 0.f ? ringRadius : 1.f);
+  for (int i = 0; i < kCount; i++) {
+    const float candidate = 1.f - distance[i] * invRing + grounded[i] * .5f + (i == 0 ? .25f : 0.f);
+    score[i] = candidate * valid[i] + kRejected * (1.f - valid[i]);
+  }
+
+  int best = 0;
+  for (int i = 1; i < kCount; i++) {
+    best = score[i] > score[best] ? i : best;
+  }
+
+  solution.canShift = valid[best] != 0.f;
+  solution.location = solution.canShift ? centers[best] : aimPoint;
+  solution.branch = GetCandidateBranch(best);
+  solution.flags = static_cast<uint8_t>((aimBlocked ? 1 : 0) | (grounded[best] != 0.f ? 2 : 0));
+  solution.queryCount = query.m_count;
+  return solution;
+}
@@ -0,0 +1,102 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <cstdint>
+
+// The shift landing cascade without any engine types, so it can be built and profiled outside of the editor.
+// The engine side only has to provide an IShiftCollisionQuery (see ShiftCollisionQuery.h), the bench built by
+// CMakeLists.txt runs it against the in-memory one in Bench/ShiftSyntheticWorld.h.
+
+struct FShiftVec {
+  float x = 0.f;
+  float y = 0.f;
+  float z = 0.f;
+
+  FShiftVec operator+(const FShiftVec& o) const { return {x + o.x, y + o.y, z + o.z}; }
+  FShiftVec operator-(const FShiftVec& o) const { return {x - o.x, y - o.y, z - o.z}; }
+  FShiftVec operator*(float s) const { return {x * s, y * s, z * s}; }
+  FShiftVec operator/(float s) const { return {x / s, y / s, z / s}; }
+  bool operator==(const FShiftVec& o) const { return x == o.x && y == o.y && z == o.z; }
+};
+
+struct FShiftHit {
+  FShiftVec location;
+  FShiftVec impactPoint;
+  FShiftVec normal;
+  bool blocking = false;
+};
+
+// Line traces see the owner, sweeps ignore it (same as the original Kismet calls).
+// Implementations must always write outHit, a miss leaves it default constructed.
+class IShiftCollisionQuery {
+public:
+  virtual ~IShiftCollisionQuery() = default;
+  virtual bool LineTrace(const FShiftVec& start, const FShiftVec& end, FShiftHit& outHit) = 0;
+  virtual bool SphereSweep(const FShiftVec& start, const FShiftVec& end, float radius, FShiftHit& outHit) = 0;
+  virtual bool CapsuleSweep(const FShiftVec& start, const FShiftVec& end, float radius, float halfHeight,
+                            FShiftHit& outHit) = 0;
+
+  // Batched forms for the candidate search, results land at the same index as their inputs. These ignore
+  // the owner, they probe the space around it. Implementations may run them in parallel, the defaults just
+  // loop over the single queries.
+  virtual void LineTraceBatch(const FShiftVec* starts, const FShiftVec* ends, int count, FShiftHit* outHits) {
+    for (int i = 0; i < count; i++) {
+      LineTrace(starts[i], ends[i], outHits[i]);
+    }
+  }
+
+  virtual void OverlapBatch(const FShiftVec* centers, int count, float radius, float halfHeight,
+                            FShiftHit* outHits) {
+    for (int i = 0; i < count; i++) {
+      CapsuleSweep(centers[i], centers[i], radius, halfHeight, outHits[i]);
+    }
+  }
+};
+
+struct FShiftQueryParams {
+  FShiftVec start; // aim ray, camera location
+  FShiftVec end;
+  FShiftVec forward; // actor forward, used to step onto ledges
+  float capsuleRadius = 0.f;
+  float capsuleHalfHeight = 0.f;
+};
+
+// Which way the cascade went, mostly for profiling each path on its own
+enum class EShiftBranch : uint8_t {
+  kSurface,       // landed next to the aim hit
+  kLedge,         // stepped up onto the wall top
+  kSurfaceSweep,  // landing spot blocked, pulled back along the aim ray
+  kOpenAir,       // aim missed, nothing at the end of the ray
+  kOpenAirOverlap,// aim missed, end overlaps but there is room above
+  kOpenAirSweep,  // aim missed, end blocked, pulled back along the aim ray
+  kCandidateAim,      // search mode, right at the aim point
+  kCandidateLedge,    // search mode, on top of the wall that was hit
+  kCandidateRing,     // search mode, somewhere around the aim point
+  kCandidatePullback, // search mode, along the aim ray towards the player
+  kIndexed,           // baked spot from the landing index, not the solver (ShiftLandingIndex.h)
+  kCount
+};
+
+// "Surface", "Ledge", ... the one name table, the stats, the telemetry reader and the bench all print these
+const char* GetShiftBranchName(EShiftBranch branch);
+
+struct FShiftSolution {
+  FShiftVec location;
+  FShiftVec aimLocation; // aim hit, or end of the ray on a miss
+  uint8_t flags = 0;     // the flagChecks bits, aim hit | grounded (| ledge from the index) otherwise
+  uint8_t queryCount = 0;
+  EShiftBranch branch = EShiftBranch::kSurface;
+  bool canShift = false;
+};
+
+class FShiftLandingSolver {
+public:
+  static FShiftSolution Solve(IShiftCollisionQuery& query, const FShiftQueryParams& params);
+
+  // Search mode: one aim trace, then a fixed set of candidates around the aim point projected onto the
+  // floor, overlap tested and line of sight checked in three batches, and scored in one pass. Always
+  // costs 1 + 3 * kCandidates queries whichever way it goes.
+  static constexpr int kCandidates = 16;
+  static FShiftSolution SolveCandidates(IShiftCollisionQuery& query, const FShiftQueryParams& params);
+};
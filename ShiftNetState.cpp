@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShiftNetState.h"
+
+#include "UObject/CoreNet.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogShiftNet, Log, All);
+
+namespace {
+  FShiftNetStats GShiftNetStats;
+
+  FAutoConsoleCommand CmdShiftNetStats(
+    TEXT("fps.Shift.NetStats"),
+    TEXT("Prints shift requests, corrections and bits sent per shift, pass reset to clear them."),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args) {
+      FShiftNetStats& stats = FShiftNetStats::Get();
+      if (args.Num() > 0 && args[0] == TEXT("reset")) {
+        stats = FShiftNetStats();
+        return;
+      }
+      const double shifts = FMath::Max<uint64>(stats.requests, 1);
+      UE_LOG(LogShiftNet, Display,
+             TEXT("Shift net: %llu requests, %llu accepted, %llu rejected, %llu corrections (%.1f%%), ")
+             TEXT("%.1f request bits/shift, %.1f state bits/update"),
+             stats.requests, stats.accepted, stats.rejected, stats.corrections, stats.corrections * 100.0 / shifts,
+             stats.requestBits / shifts, stats.stateBits / FMath::Max<double>(stats.stateUpdates, 1));
+    }));
+
+  template <typename T>
+  uint64 MeasureNetBits(T value) {
+    FNetBitWriter writer(nullptr, 256);
+    bool success = false;
+    value.NetSerialize(writer, nullptr, success);
+    return writer.GetNumBits();
+  }
+}
+
+FShiftNetStats& FShiftNetStats::Get() {
+  return GShiftNetStats;
+}
+
+void FShiftNetStats::AddRequest(const FShiftRequest& request) {
+  requests++;
+  requestBits += MeasureNetBits(request);
+}
+
+void FShiftNetStats::AddStateUpdate(const FShiftNetState& state) {
+  stateUpdates++;
+  stateBits += MeasureNetBits(state);
+}
+
+bool FShiftRequest::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess) {
+  bOutSuccess = SerializePackedVector<1, 20>(target, Ar);
+  Ar << shiftId;
+  return true;
+}
+
+uint8 FShiftNetState::QuantizeMana(float value) {
+  return static_cast<uint8>(FMath::RoundToInt(FMath::Clamp(value, 0.f, 100.f) * 2.55f));
+}
+
+float FShiftNetState::DequantizeMana(uint8 value) {
+  return value / 2.55f;
+}
+
+uint8 FShiftNetState::QuantizeCoolDown(float seconds) {
+  // sent right after the activation too, when the active time still runs and elapsed is below zero
+  return static_cast<uint8>(FMath::Clamp(FMath::RoundToInt(seconds * 25.f) + 128, 0, 255));
+}
+
+float FShiftNetState::DequantizeCoolDown(uint8 value) {
+  return (static_cast<int32>(value) - 128) / 25.f;
+}
+
+bool FShiftNetState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess) {
+  Ar << shiftId;
+  Ar << mana;
+  Ar << coolDown;
+  bOutSuccess = true;
+  return true;
+}
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "ShiftNetState.generated.h"
+
+// Client -> server shift request, the predicted landing spot at whole cm precision
+USTRUCT()
+struct FShiftRequest {
+  GENERATED_BODY()
+
+  FVector target = FVector::ZeroVector;
+  uint8 shiftId = 0;
+
+  bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template <>
+struct TStructOpsTypeTraits<FShiftRequest> : public TStructOpsTypeTraitsBase2<FShiftRequest> {
+  enum { WithNetSerializer = true };
+};
+
+// Server authoritative shift state, owner only. Mana and cooldown ride along as a byte each instead of
+// floats, the landing spot is not sent back since the root motion already carries the character there.
+USTRUCT()
+struct FShiftNetState {
+  GENERATED_BODY()
+
+  uint8 shiftId = 0;
+  uint8 mana = 0;     // 0..100 mapped to 0..255
+  uint8 coolDown = 0; // elapsed seconds in 1/25 steps offset by 128, negative while active, -5.12..5.08
+
+  static uint8 QuantizeMana(float value);
+  static float DequantizeMana(uint8 value);
+  static uint8 QuantizeCoolDown(float seconds);
+  static float DequantizeCoolDown(uint8 value);
+  // at the top of the range the real elapsed time is that or longer
+  static bool IsCoolDownSaturated(uint8 value) { return value == MAX_uint8; }
+
+  bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+  bool operator==(const FShiftNetState& o) const {
+    return shiftId == o.shiftId && mana == o.mana && coolDown == o.coolDown;
+  }
+};
+
+template <>
+struct TStructOpsTypeTraits<FShiftNetState> : public TStructOpsTypeTraitsBase2<FShiftNetState> {
+  // no UPROPERTY members, replication has to compare through operator==
+  enum { WithNetSerializer = true, WithIdenticalViaEquality = true };
+};
+
+// Process wide counters, for comparing bandwidth and corrections between runs (fps.Shift.NetStats)
+struct FShiftNetStats {
+  uint64 requests = 0;
+  uint64 accepted = 0;
+  uint64 rejected = 0;
+  uint64 corrections = 0; // client had to snap back to where the server put it
+  uint64 stateUpdates = 0;
+  uint64 requestBits = 0;
+  uint64 stateBits = 0;
+
+  // measured by serializing a copy into a scratch net writer, NetSerialize itself can't know its archive
+  void AddRequest(const FShiftRequest& request);
+  void AddStateUpdate(const FShiftNetState& state);
+
+  static FShiftNetStats& Get();
+};
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShiftRootMotionSource.h"
+
+#include "Engine/NetSerialization.h"
+#include "GameFramework/Character.h"
+
+FRootMotionSource_Shift::FRootMotionSource_Shift() {
+  // above montages and the usual gameplay forces, the shift owns the character while it runs
+  Priority = 500;
+  AccumulateMode = ERootMotionAccumulateMode::Override;
+}
+
+FRootMotionSource* FRootMotionSource_Shift::Clone() const {
+  return new FRootMotionSource_Shift(*this);
+}
+
+bool FRootMotionSource_Shift::Matches(const FRootMotionSource* Other) const {
+  if (!FRootMotionSource::Matches(Other)) return false;
+
+  // same script struct is checked by the base, the ends only have to agree to the quantization
+  const FRootMotionSource_Shift* other = static_cast<const FRootMotionSource_Shift*>(Other);
+  return startLocation.Equals(other->startLocation, 1.f) && targetLocation.Equals(other->targetLocation, 1.f);
+}
+
+// same straight line the old per frame SetActorLocation lerp followed, handed over as the velocity that
+// gets there by the end of this move
+void FRootMotionSource_Shift::PrepareRootMotion(float SimulationTime, float MovementTickTime,
+                                                const ACharacter& Character,
+                                                const UCharacterMovementComponent& MoveComponent) {
+  RootMotionParams.Clear();
+  if (Duration > UE_SMALL_NUMBER && MovementTickTime > UE_SMALL_NUMBER) {
+    const float alpha = FMath::Min((GetTime() + SimulationTime) / Duration, 1.f);
+    const FVector location = FMath::Lerp(startLocation, targetLocation, alpha);
+    const FVector velocity = (location - Character.GetActorLocation()) / MovementTickTime;
+    RootMotionParams.Set(FTransform(velocity));
+  }
+  SetTime(GetTime() + SimulationTime);
+}
+
+bool FRootMotionSource_Shift::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess) {
+  if (!FRootMotionSource::NetSerialize(Ar, Map, bOutSuccess)) return false;
+
+  // whole cm, the same precision the shift request goes to the server with
+  bOutSuccess &= SerializePackedVector<1, 24>(startLocation, Ar);
+  bOutSuccess &= SerializePackedVector<1, 24>(targetLocation, Ar);
+  return true;
+}
+
+UScriptStruct* FRootMotionSource_Shift::GetScriptStruct() const {
+  return StaticStruct();
+}
+
+FString FRootMotionSource_Shift::ToSimpleString() const {
+  return FString::Printf(TEXT("[ID:%u]FRootMotionSource_Shift %s %s -> %s"), LocalID, *InstanceName.GetPlainNameString(),
+                         *startLocation.ToCompactString(), *targetLocation.ToCompactString());
+}
@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/RootMotionSource.h"
+#include "ShiftRootMotionSource.generated.h"
+
+// Moves the character from startLocation to targetLocation over Duration. The movement component
+// integrates it like any other velocity: swept, split into sub-steps by MaxSimulationTimeStep while
+// falling, recorded in saved moves and replayed on corrections and on simulated proxies.
+USTRUCT()
+struct FPS_CONTROLLER_API FRootMotionSource_Shift : public FRootMotionSource {
+  GENERATED_BODY()
+
+  FRootMotionSource_Shift();
+
+  UPROPERTY()
+  FVector startLocation = FVector::ZeroVector;
+
+  UPROPERTY()
+  FVector targetLocation = FVector::ZeroVector;
+
+  // 0..1 along the shift, what the camera FOV follows as well
+  float GetAlpha() const { return Duration > 0 ? FMath::Min(GetTime() / Duration, 1.f) : 1.f; }
+
+  virtual FRootMotionSource* Clone() const override;
+  virtual bool Matches(const FRootMotionSource* Other) const override;
+  virtual void PrepareRootMotion(float SimulationTime, float MovementTickTime, const ACharacter& Character,
+                                 const UCharacterMovementComponent& MoveComponent) override;
+  virtual bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess) override;
+  virtual UScriptStruct* GetScriptStruct() const override;
+  virtual FString ToSimpleString() const override;
+};
+
+template <>
+struct TStructOpsTypeTraits<FRootMotionSource_Shift> : public TStructOpsTypeTraitsBase2<FRootMotionSource_Shift> {
+  enum {
+    WithNetSerializer = true,
+    WithCopy = true
+  };
+};
@@ -0,0 +1,128 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ShiftTargetCache.h"
+
+#include "Components/PrimitiveComponent.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogShiftTargetCache, Log, All);
+
+static TAutoConsoleVariable<bool> CVarShiftCache(
+  TEXT("fps.Shift.Cache"),
+  true,
+  TEXT("Reuse the last shift target while the aim barely moves."));
+
+static TAutoConsoleVariable<float> CVarShiftCacheCell(
+  TEXT("fps.Shift.CacheCell"),
+  4.f,
+  TEXT("Camera movement (cm) that still reuses the cached shift target."));
+
+static TAutoConsoleVariable<float> CVarShiftCacheAngle(
+  TEXT("fps.Shift.CacheAngle"),
+  .5f,
+  TEXT("Camera rotation (degrees) that still reuses the cached shift target."));
+
+static TAutoConsoleVariable<float> CVarShiftCacheMaxAge(
+  TEXT("fps.Shift.CacheMaxAge"),
+  .25f,
+  TEXT("Seconds a cached shift target is trusted before it is traced again."));
+
+namespace {
+  FShiftCacheStats GShiftCacheStats;
+
+  FAutoConsoleCommand CmdShiftCacheStats(
+    TEXT("fps.Shift.CacheStats"),
+    TEXT("Prints the shift target cache counters, pass reset to clear them."),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args) {
+      if (args.Num() > 0 && args[0] == TEXT("reset")) {
+        GShiftCacheStats = FShiftCacheStats();
+        return;
+      }
+      UE_LOG(LogShiftTargetCache, Display,
+             TEXT("Shift cache: %llu hits, %llu misses, %llu invalidations, %llu expirations (%.1f%% hit rate)"),
+             GShiftCacheStats.hits, GShiftCacheStats.misses, GShiftCacheStats.invalidations,
+             GShiftCacheStats.expirations, GShiftCacheStats.GetHitRate() * 100.f);
+    }));
+}
+
+float FShiftCacheStats::GetHitRate() const {
+  const uint64 total = hits + misses + invalidations + expirations;
+  return total > 0 ? static_cast<float>(hits) / total : 0.f;
+}
+
+const FShiftCacheStats& FShiftTargetCache::GetGlobalStats() {
+  return GShiftCacheStats;
+}
+
+FShiftTargetCache::FKey FShiftTargetCache::MakeKey(const FShiftQueryParams& params, uint8 solveMode) {
+  const float cell = FMath::Max(CVarShiftCacheCell.GetValueOnGameThread(), 0.01f);
+  const float angle = FMath::Max(CVarShiftCacheAngle.GetValueOnGameThread(), 0.01f);
+  const FVector start = ToFVector(params.start);
+  const FRotator rotation = (ToFVector(params.end) - start).Rotation();
+
+  FKey key;
+  key.origin = FIntVector(FMath::RoundToInt(start.X / cell), FMath::RoundToInt(start.Y / cell),
+                          FMath::RoundToInt(start.Z / cell));
+  key.yaw = FMath::RoundToInt(rotation.Yaw / angle);
+  key.pitch = FMath::RoundToInt(rotation.Pitch / angle);
+  key.halfHeight = FMath::RoundToInt(params.capsuleHalfHeight);
+  key.solveMode = solveMode;
+  return key;
+}
+
+bool FShiftTargetCache::HasCollisionChanged() const {
+  for (const FWatched& watched : m_watched) {
+    const UPrimitiveComponent* component = watched.component.Get();
+    if (component == nullptr || !component->IsCollisionEnabled()) return true;
+    if (component->Mobility != EComponentMobility::Static &&
+      !component->GetComponentTransform().Equals(watched.transform)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FShiftTargetCache::Lookup(const FShiftQueryParams& params, uint8 solveMode, double time,
+                               FShiftSolution& outSolution) {
+  if (!CVarShiftCache.GetValueOnGameThread()) return false;
+
+  uint64 FShiftCacheStats::* bucket = nullptr;
+  if (!m_valid || !(MakeKey(params, solveMode) == m_key)) {
+    bucket = &FShiftCacheStats::misses;
+  }
+  else if (time - m_storedTime > CVarShiftCacheMaxAge.GetValueOnGameThread()) {
+    bucket = &FShiftCacheStats::expirations;
+  }
+  else if (HasCollisionChanged()) {
+    bucket = &FShiftCacheStats::invalidations;
+  }
+  else {
+    bucket = &FShiftCacheStats::hits;
+    outSolution = m_solution;
+  }
+
+  m_stats.*bucket += 1;
+  GShiftCacheStats.*bucket += 1;
+  return bucket == &FShiftCacheStats::hits;
+}
+
+void FShiftTargetCache::Store(const FShiftQueryParams& params, uint8 solveMode, double time,
+                              const FShiftSolution& solution,
+                              TConstArrayView<TWeakObjectPtr<const UPrimitiveComponent>> touched) {
+  m_key = MakeKey(params, solveMode);
+  m_solution = solution;
+  m_storedTime = time;
+  m_valid = true;
+
+  m_watched.Reset();
+  for (const TWeakObjectPtr<const UPrimitiveComponent>& component : touched) {
+    if (const UPrimitiveComponent* resolved = component.Get()) {
+      m_watched.Add({component, resolved->GetComponentTransform()});
+    }
+  }
+}
+
+void FShiftTargetCache::Invalidate() {
+  m_valid = false;
+  m_watched.Reset();
+}
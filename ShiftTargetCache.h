@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ShiftCollisionQuery.h"
+
+class UPrimitiveComponent;
+
+struct FShiftCacheStats {
+  uint64 hits = 0;
+  uint64 misses = 0;       // aim moved to another cell/angle bucket, or nothing cached
+  uint64 invalidations = 0;// collision the answer depended on moved or went away
+  uint64 expirations = 0;  // answer got older than fps.Shift.CacheMaxAge
+
+  float GetHitRate() const;
+};
+
+// which solver setup an answer came from, part of the key so flipping the ShiftAB flags never hands back
+// another setup's answer
+enum EShiftSolveMode : uint8 {
+  kShiftSolveCascade = 0,
+  kShiftSolveAsync = 1 << 0,
+  kShiftSolveCandidates = 1 << 1,
+  kShiftSolveIndex = 1 << 2,
+};
+
+// Remembers the last shift solution and hands it back while the aim stays in the same bucket
+// (camera origin rounded to fps.Shift.CacheCell, direction to fps.Shift.CacheAngle, and the same
+// solve mode). Each value goes to its nearest bucket, so an aim resting on a whole multiple of the
+// cell or angle doesn't sit on a bucket edge the way it does with a floor. The answer
+// is dropped when anything it hit that can move has moved, or after fps.Shift.CacheMaxAge so
+// collision that showed up since still gets picked up.
+class FPS_CONTROLLER_API FShiftTargetCache {
+public:
+  // solveMode is a mask of EShiftSolveMode
+  bool Lookup(const FShiftQueryParams& params, uint8 solveMode, double time, FShiftSolution& outSolution);
+  void Store(const FShiftQueryParams& params, uint8 solveMode, double time, const FShiftSolution& solution,
+             TConstArrayView<TWeakObjectPtr<const UPrimitiveComponent>> touched);
+  void Invalidate();
+
+  const FShiftCacheStats& GetStats() const { return m_stats; }
+  // every cache in the process, for tuning the thresholds
+  static const FShiftCacheStats& GetGlobalStats();
+
+private:
+  struct FKey {
+    FIntVector origin;
+    int32 yaw = 0;
+    int32 pitch = 0;
+    int32 halfHeight = 0;
+    uint8 solveMode = 0;
+
+    bool operator==(const FKey& o) const {
+      return origin == o.origin && yaw == o.yaw && pitch == o.pitch && halfHeight == o.halfHeight &&
+        solveMode == o.solveMode;
+    }
+  };
+
+  struct FWatched {
+    TWeakObjectPtr<const UPrimitiveComponent> component;
+    FTransform transform;
+  };
+
+  static FKey MakeKey(const FShiftQueryParams& params, uint8 solveMode);
+  bool HasCollisionChanged() const;
+
+  FKey m_key;
+  FShiftSolution m_solution;
+  TArray<FWatched, TInlineAllocator<8>> m_watched;
+  double m_storedTime = 0;
+  bool m_valid = false;
+  FShiftCacheStats m_stats;
+};
@@ -0,0 +1,367 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TimeLoopRecorder.h"
+
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogTimeLoop, Log, All);
+
+namespace {
+  FAutoConsoleCommand CmdBenchTimeLoop(
+    TEXT("fps.Loop.Bench"),
+    TEXT("Records a synthetic run into a time loop recorder and reports bytes per second and seek latency. ")
+    TEXT("Optional argument: minutes to record (default 10)."),
+    FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args) {
+      RunTimeLoopBenchmark(args.Num() > 0 ? FCString::Atof(*args[0]) : 10.f);
+    }));
+
+  // mask plus a 5 byte varint for every field
+  constexpr int32 kMaxFrameBytes = 2 + 11 * 5;
+
+  // fixed point steps, small enough that a rewind can't be told apart from the original
+  constexpr float kLocationScale = 8.f;  // 1/8 cm
+  constexpr float kVelocityScale = 1.f;  // 1 cm/s
+  constexpr float kHalfHeightScale = 10.f;
+  constexpr float kFovScale = 100.f;
+  constexpr float kManaScale = 10.f;
+  constexpr float kCoolDownScale = 1000.f; // ms
+  // past this the cooldown is long over, clamping keeps the field from changing every sample
+  constexpr float kMaxCoolDown = 10.f;
+
+  void PutVarInt(TArray<uint8>& out, uint32 value) {
+    while (value >= 0x80) {
+      out.Add(static_cast<uint8>(value) | 0x80);
+      value >>= 7;
+    }
+    out.Add(static_cast<uint8>(value));
+  }
+
+  bool GetVarInt(const uint8*& data, const uint8* end, uint32& out) {
+    out = 0;
+    for (int32 shift = 0; shift < 35 && data < end; shift += 7) {
+      const uint8 byte = *data++;
+      out |= static_cast<uint32>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+  }
+
+  // wraps like uint32 arithmetic, so the decoder rebuilds exactly what was quantized
+  uint32 ZigZag(uint32 delta) {
+    return (delta << 1) ^ static_cast<uint32>(static_cast<int32>(delta) >> 31);
+  }
+
+  uint32 UnZigZag(uint32 value) {
+    return (value >> 1) ^ (0u - (value & 1));
+  }
+
+  int32 ToFixed(float value, float scale) {
+    return FMath::RoundToInt32(value * scale);
+  }
+
+  float Lerp(float a, float b, float alpha) {
+    return a + (b - a) * alpha;
+  }
+}
+
+double FTimeLoopStats::GetBytesPerSecond(float sampleRate) const {
+  return frames > 0 ? bytes * sampleRate / frames : 0.0;
+}
+
+FTimeLoopRecorder::FTimeLoopRecorder(int32 budgetBytes, float sampleRate, int32 keyframeInterval)
+  : m_budgetBytes(FMath::Max(budgetBytes, FMath::Max(keyframeInterval, 1) * kMaxFrameBytes)),
+    m_sampleRate(FMath::Max(sampleRate, 1.f)),
+    m_keyframeInterval(FMath::Max(keyframeInterval, 1)) {}
+
+void FTimeLoopRecorder::Reset() {
+  m_blocks.Reset();
+  m_writeOffset = 0;
+  m_pending.Reset();
+  m_pendingFirstFrame = 0;
+  m_pendingFrames = 0;
+  m_last = FQuantized();
+  m_startTime = 0;
+  m_frameCount = 0;
+  m_stats = FTimeLoopStats();
+}
+
+FTimeLoopRecorder::FQuantized FTimeLoopRecorder::Quantize(const FTimeLoopState& state) {
+  FQuantized quantized;
+  int32* values = quantized.values;
+  values[kLocationX] = ToFixed(state.location.X, kLocationScale);
+  values[kLocationY] = ToFixed(state.location.Y, kLocationScale);
+  values[kLocationZ] = ToFixed(state.location.Z, kLocationScale);
+  values[kVelocityX] = ToFixed(state.velocity.X, kVelocityScale);
+  values[kVelocityY] = ToFixed(state.velocity.Y, kVelocityScale);
+  values[kVelocityZ] = ToFixed(state.velocity.Z, kVelocityScale);
+  values[kHalfHeight] = ToFixed(state.capsuleHalfHeight, kHalfHeightScale);
+  values[kFov] = ToFixed(state.fov, kFovScale);
+  values[kMana] = ToFixed(state.mana, kManaScale);
+  values[kCoolDown] = ToFixed(FMath::Clamp(state.coolDownElapsed, -kMaxCoolDown, kMaxCoolDown), kCoolDownScale);
+  values[kMovementState] = state.movementState;
+  return quantized;
+}
+
+FTimeLoopState FTimeLoopRecorder::Dequantize(const FQuantized& quantized) {
+  const int32* values = quantized.values;
+  FTimeLoopState state;
+  state.location = FVector(values[kLocationX], values[kLocationY], values[kLocationZ]) / kLocationScale;
+  state.velocity = FVector(values[kVelocityX], values[kVelocityY], values[kVelocityZ]) / kVelocityScale;
+  state.capsuleHalfHeight = values[kHalfHeight] / kHalfHeightScale;
+  state.fov = values[kFov] / kFovScale;
+  state.mana = values[kMana] / kManaScale;
+  state.coolDownElapsed = values[kCoolDown] / kCoolDownScale;
+  state.movementState = static_cast<uint8>(values[kMovementState]);
+  return state;
+}
+
+void FTimeLoopRecorder::Record(double time, const FTimeLoopState& state) {
+  if (IsEmpty()) {
+    m_startTime = time;
+    if (m_ring.Num() == 0) {
+      m_ring.SetNumUninitialized(m_budgetBytes);
+    }
+  }
+
+  // the samples the caller missed (tick off, hitch) held the previous state, one byte each
+  // a hair of slack so a time landing on the grid is not taken for the end of the previous sample
+  const int64 due = FMath::FloorToInt64((time - m_startTime) * m_sampleRate + 1e-4) + 1;
+  while (m_frameCount > 0 && m_frameCount < due - 1) {
+    Append(m_last);
+  }
+  if (m_frameCount < due) {
+    Append(Quantize(state));
+  }
+}
+
+void FTimeLoopRecorder::Append(const FQuantized& state) {
+  // the first sample of a block is stored against zero, that makes it the keyframe
+  const FQuantized base = m_pendingFrames == 0 ? FQuantized() : m_last;
+  if (m_pendingFrames == 0) {
+    m_pendingFirstFrame = m_frameCount;
+  }
+
+  uint32 mask = 0;
+  for (int32 i = 0; i < kFieldCount; i++) {
+    mask |= (state.values[i] != base.values[i] ? 1u : 0u) << i;
+  }
+  const int32 before = m_pending.Num();
+  PutVarInt(m_pending, mask);
+  for (int32 i = 0; i < kFieldCount; i++) {
+    if (mask & (1u << i)) {
+      PutVarInt(m_pending, ZigZag(static_cast<uint32>(state.values[i]) - static_cast<uint32>(base.values[i])));
+    }
+  }
+
+  m_stats.frames++;
+  m_stats.bytes += m_pending.Num() - before;
+  m_last = state;
+  m_frameCount++;
+  if (++m_pendingFrames == m_keyframeInterval) {
+    CommitBlock();
+  }
+}
+
+void FTimeLoopRecorder::CommitBlock() {
+  const int32 size = m_pending.Num();
+  const int32 previousOffset = m_writeOffset;
+  const bool wrapped = m_writeOffset + size > m_budgetBytes;
+  if (wrapped) {
+    m_writeOffset = 0;
+  }
+
+  // the oldest blocks sit right after the write head. On a wrap the ones left at the end of the ring are
+  // older than anything at the start, they go first
+  int32 evict = 0;
+  while (evict < m_blocks.Num()) {
+    const FBlock& block = m_blocks[evict];
+    const bool inTail = wrapped && block.offset >= previousOffset;
+    const bool overlaps = block.offset < m_writeOffset + size && m_writeOffset < block.offset + block.size;
+    if (!inTail && !overlaps) break;
+    evict++;
+  }
+  m_blocks.RemoveAt(0, evict);
+  m_stats.evictedBlocks += evict;
+
+  FMemory::Memcpy(m_ring.GetData() + m_writeOffset, m_pending.GetData(), size);
+  m_blocks.Add({m_pendingFirstFrame, m_writeOffset, size});
+  m_writeOffset += size;
+  m_pending.Reset();
+  m_pendingFrames = 0;
+}
+
+int64 FTimeLoopRecorder::GetOldestFrame() const {
+  return m_blocks.Num() > 0 ? m_blocks[0].firstFrame : m_pendingFirstFrame;
+}
+
+double FTimeLoopRecorder::GetOldestTime() const {
+  return m_startTime + GetOldestFrame() / m_sampleRate;
+}
+
+double FTimeLoopRecorder::GetNewestTime() const {
+  return m_startTime + FMath::Max<int64>(m_frameCount - 1, 0) / m_sampleRate;
+}
+
+int32 FTimeLoopRecorder::GetUsedBytes() const {
+  int32 bytes = m_pending.Num();
+  for (const FBlock& block : m_blocks) {
+    bytes += block.size;
+  }
+  return bytes;
+}
+
+bool FTimeLoopRecorder::DecodeFrame(int64 frame, FQuantized& outState, FQuantized* outNext) const {
+  const uint8* data;
+  const uint8* end;
+  int64 firstFrame;
+  if (m_pendingFrames > 0 && frame >= m_pendingFirstFrame) {
+    data = m_pending.GetData();
+    end = data + m_pending.Num();
+    firstFrame = m_pendingFirstFrame;
+  }
+  else {
+    if (m_blocks.Num() == 0 || frame < m_blocks[0].firstFrame) return false;
+    const int64 index = (frame - m_blocks[0].firstFrame) / m_keyframeInterval;
+    if (index >= m_blocks.Num()) return false;
+    const FBlock& block = m_blocks[index];
+    data = m_ring.GetData() + block.offset;
+    end = data + block.size;
+    firstFrame = block.firstFrame;
+  }
+
+  auto readFrame = [&data, end](FQuantized& state) {
+    uint32 mask;
+    if (!GetVarInt(data, end, mask)) return false;
+    for (int32 i = 0; i < kFieldCount; i++) {
+      uint32 delta;
+      if (!(mask & (1u << i))) continue;
+      if (!GetVarInt(data, end, delta)) return false;
+      state.values[i] = static_cast<int32>(static_cast<uint32>(state.values[i]) + UnZigZag(delta));
+    }
+    return true;
+  };
+
+  FQuantized state;
+  for (int64 i = firstFrame; i <= frame; i++) {
+    if (!readFrame(state)) return false;
+  }
+  outState = state;
+
+  if (outNext != nullptr) {
+    *outNext = state;
+    // the next frame is either the following one in this block or the keyframe of the next block
+    if (frame + 1 < m_frameCount && !readFrame(*outNext)) {
+      return DecodeFrame(frame + 1, *outNext, nullptr);
+    }
+  }
+  return true;
+}
+
+bool FTimeLoopRecorder::Seek(double time, FTimeLoopState& outState) const {
+  if (IsEmpty()) return false;
+
+  const double position = FMath::Clamp((time - m_startTime) * m_sampleRate, static_cast<double>(GetOldestFrame()),
+                                       static_cast<double>(m_frameCount - 1));
+  const int64 frame = FMath::FloorToInt64(position);
+  const float alpha = static_cast<float>(position - frame);
+  FQuantized from;
+  FQuantized to;
+  if (!DecodeFrame(frame, from, &to)) return false;
+
+  const FTimeLoopState a = Dequantize(from);
+  const FTimeLoopState b = Dequantize(to);
+  outState = a;
+  outState.location = FMath::Lerp(a.location, b.location, alpha);
+  outState.velocity = FMath::Lerp(a.velocity, b.velocity, alpha);
+  outState.capsuleHalfHeight = Lerp(a.capsuleHalfHeight, b.capsuleHalfHeight, alpha);
+  outState.fov = Lerp(a.fov, b.fov, alpha);
+  outState.mana = Lerp(a.mana, b.mana, alpha);
+  outState.coolDownElapsed = Lerp(a.coolDownElapsed, b.coolDownElapsed, alpha);
+  return true;
+}
+
+void RunTimeLoopBenchmark(float minutes) {
+  constexpr float kFrameRate = 60.f;
+  FTimeLoopRecorder recorder;
+  const int32 frames = FMath::Max(FMath::RoundToInt32(minutes * 60.f * kFrameRate), 1);
+
+  // walk, sprint, slide into a crouch, stand still and shift in a 20 s cycle, turning every few seconds
+  struct FPhase {
+    float end;
+    uint8 movementState;
+    float speed;
+  };
+  const FPhase phases[] = {{6.f, 0, 600.f}, {10.f, 1, 900.f}, {10.3f, 3, 1400.f}, {13.f, 2, 340.f}, {20.f, 0, 0.f}};
+  FRandomStream random(1234);
+  FTimeLoopState state;
+  state.location = FVector(0, 0, 90);
+  state.capsuleHalfHeight = 88.f;
+  state.fov = 90.f;
+  state.mana = 100.f;
+  state.coolDownElapsed = kMaxCoolDown;
+  FVector direction = FVector::ForwardVector;
+  TArray<TPair<double, FVector>> truth;
+  double recordSeconds = 0;
+  for (int32 i = 0; i < frames; i++) {
+    const double time = static_cast<double>(i) / kFrameRate;
+    const float phase = FMath::Fmod(static_cast<float>(time), 20.f);
+    if (i % 180 == 0) {
+      direction = FVector(random.FRandRange(-1.f, 1.f), random.FRandRange(-1.f, 1.f), 0).GetSafeNormal();
+    }
+    const FPhase* current = &phases[0];
+    while (phase >= current->end && current != &phases[UE_ARRAY_COUNT(phases) - 1]) {
+      current++;
+    }
+    state.movementState = current->movementState;
+    state.capsuleHalfHeight = state.movementState >= 2 ? 40.f : 88.f;
+    state.velocity = direction * current->speed;
+    state.location += state.velocity / kFrameRate;
+    state.coolDownElapsed = FMath::Min(state.coolDownElapsed + 1.f / kFrameRate, kMaxCoolDown);
+    state.mana = FMath::Min(state.mana + (state.coolDownElapsed > 4.f ? 10.f / kFrameRate : 0.f), 100.f);
+    if (i % static_cast<int32>(kFrameRate * 20.f) == static_cast<int32>(kFrameRate * 18.f)) {
+      state.location += direction * 800.f;
+      state.coolDownElapsed = -.25f;
+      state.mana -= 25.f;
+    }
+    state.fov = state.coolDownElapsed < .5f ? 110.f - FMath::Max(state.coolDownElapsed, 0.f) * 40.f : 90.f;
+
+    const uint64 start = FPlatformTime::Cycles64();
+    recorder.Record(time, state);
+    recordSeconds += FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - start);
+    if (i % 2 == 0) {
+      truth.Emplace(time, state.location);
+    }
+  }
+
+  // exact sample times only, so the error is quantization and not interpolation
+  double maxError = 0;
+  for (const TPair<double, FVector>& sample : truth) {
+    FTimeLoopState decoded;
+    if (sample.Key >= recorder.GetOldestTime() && recorder.Seek(sample.Key, decoded)) {
+      maxError = FMath::Max(maxError, FVector::Dist(decoded.location, sample.Value));
+    }
+  }
+
+  constexpr int32 kSeeks = 10000;
+  double seekSeconds = 0;
+  double maxSeekSeconds = 0;
+  for (int32 i = 0; i < kSeeks; i++) {
+    const double time = random.FRandRange(recorder.GetOldestTime(), recorder.GetNewestTime());
+    FTimeLoopState decoded;
+    const uint64 start = FPlatformTime::Cycles64();
+    recorder.Seek(time, decoded);
+    const double seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - start);
+    seekSeconds += seconds;
+    maxSeekSeconds = FMath::Max(maxSeekSeconds, seconds);
+  }
+
+  const FTimeLoopStats& stats = recorder.GetStats();
+  UE_LOG(LogTimeLoop, Display,
+         TEXT("Time loop over %.1f min: %.1f bytes/s (%.0f bytes/s as raw snapshots), %d KB used, %.1f s kept, ")
+         TEXT("%llu blocks evicted. Record %.3f us/frame, seek %.2f us avg, %.2f us max, location error %.3f cm"),
+         minutes, stats.GetBytesPerSecond(recorder.GetSampleRate()),
+         sizeof(FTimeLoopState) * recorder.GetSampleRate(), recorder.GetUsedBytes() / 1024,
+         recorder.GetNewestTime() - recorder.GetOldestTime(), stats.evictedBlocks, recordSeconds * 1e6 / frames,
+         seekSeconds * 1e6 / kSeeks, maxSeekSeconds * 1e6, maxError);
+}
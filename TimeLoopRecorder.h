@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// what a rewind puts back, movementState matches EMovementState on the character
+struct FTimeLoopState {
+  FVector location = FVector::ZeroVector;
+  FVector velocity = FVector::ZeroVector;
+  float capsuleHalfHeight = 0.f;
+  float fov = 0.f;
+  float mana = 0.f;
+  float coolDownElapsed = 0.f;
+  uint8 movementState = 0;
+};
+
+struct FTimeLoopStats {
+  uint64 frames = 0;        // every sample ever recorded
+  uint64 bytes = 0;         // encoded size of those, evicted ones included
+  uint64 evictedBlocks = 0;
+
+  double GetBytesPerSecond(float sampleRate) const;
+};
+
+// Records a character's state over a whole loop in a fixed amount of memory. Samples are taken on a fixed
+// grid (sampleRate), quantized and stored as deltas against the previous sample; every keyframeInterval
+// samples a block starts over against zero so it decodes on its own. Full blocks go into a byte ring of
+// budgetBytes, the oldest blocks are dropped once it is full. Blocks all hold the same number of samples,
+// so a seek finds its block with one division and decodes at most one block.
+// Per sample: a varint mask of the fields that changed, then a zigzag varint delta for each of them. A
+// character standing still costs one byte per sample.
+// fps.Loop.Bench [minutes] reports bytes per second and seek latency on a synthetic run.
+class FPS_CONTROLLER_API FTimeLoopRecorder {
+public:
+  explicit FTimeLoopRecorder(int32 budgetBytes = 512 * 1024, float sampleRate = 30.f, int32 keyframeInterval = 30);
+
+  void Reset();
+  // takes every sample due up to time, samples missed since the last call repeat the previous state
+  void Record(double time, const FTimeLoopState& state);
+  // state at time, interpolated between samples and clamped to what is still recorded
+  bool Seek(double time, FTimeLoopState& outState) const;
+
+  bool IsEmpty() const { return m_frameCount == 0; }
+  double GetOldestTime() const;
+  double GetNewestTime() const;
+  int32 GetUsedBytes() const;
+  float GetSampleRate() const { return m_sampleRate; }
+  const FTimeLoopStats& GetStats() const { return m_stats; }
+
+private:
+  enum EField : int32 {
+    kLocationX, kLocationY, kLocationZ,
+    kVelocityX, kVelocityY, kVelocityZ,
+    kHalfHeight, kFov, kMana, kCoolDown, kMovementState,
+    kFieldCount
+  };
+
+  struct FQuantized {
+    int32 values[kFieldCount] = {};
+  };
+
+  struct FBlock {
+    int64 firstFrame = 0;
+    int32 offset = 0;
+    int32 size = 0;
+  };
+
+  int64 GetOldestFrame() const;
+  static FQuantized Quantize(const FTimeLoopState& state);
+  static FTimeLoopState Dequantize(const FQuantized& quantized);
+  // decodes its block up to frame, next gets the frame after it or the same one when frame is the newest
+  bool DecodeFrame(int64 frame, FQuantized& outState, FQuantized* outNext) const;
+  void Append(const FQuantized& state);
+  void CommitBlock();
+
+  TArray<uint8> m_ring; // allocated on the first sample
+  TArray<FBlock> m_blocks; // oldest first, consecutive frames
+  int32 m_writeOffset = 0;
+
+  TArray<uint8> m_pending; // the block being filled
+  int64 m_pendingFirstFrame = 0;
+  int32 m_pendingFrames = 0;
+  FQuantized m_last;
+  FTimeLoopState m_lastState;
+
+  int32 m_budgetBytes;
+  float m_sampleRate;
+  int32 m_keyframeInterval;
+  double m_startTime = 0;
+  int64 m_frameCount = 0; // frames since m_startTime, the newest is m_frameCount - 1
+  FTimeLoopStats m_stats;
+};
+
+// records a synthetic walk/sprint/slide/shift run of the given length and times random seeks into it
+FPS_CONTROLLER_API void RunTimeLoopBenchmark(float minutes);
@@ -0,0 +1,167 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TimerWheel.h"
+
+FTimerWheel::FTimerWheel(float tickRate) : m_tickRate(FMath::Max(tickRate, 1.f)) {
+  for (int32& head : m_heads) {
+    head = INDEX_NONE;
+  }
+}
+
+int32 FTimerWheel::AddChannel(FBatchCallback callback) {
+  m_expired.AddDefaulted();
+  return m_callbacks.Add(MoveTemp(callback));
+}
+
+FWheelTimerHandle FTimerWheel::Add(int32 channel, float delay, uint64 payload) {
+  check(m_callbacks.IsValidIndex(channel));
+  int32 node = m_freeList;
+  if (node != INDEX_NONE) {
+    m_freeList = m_nodes[node].next;
+  }
+  else {
+    node = m_nodes.AddDefaulted();
+  }
+
+  FNode& timer = m_nodes[node];
+  timer.expiry = FMath::Max(m_current + static_cast<int64>(FMath::CeilToDouble(m_fraction + delay * m_tickRate)),
+                            m_current + 1);
+  timer.payload = payload;
+  timer.channel = channel;
+  Link(node);
+  m_active++;
+  return {static_cast<uint32>(node), timer.generation};
+}
+
+bool FTimerWheel::Cancel(FWheelTimerHandle& handle) {
+  const bool active = IsActive(handle);
+  if (active) {
+    const int32 node = static_cast<int32>(handle.index);
+    Unlink(node);
+    Free(node);
+    m_active--;
+  }
+  handle.Invalidate();
+  return active;
+}
+
+bool FTimerWheel::IsActive(const FWheelTimerHandle& handle) const {
+  const int32 node = static_cast<int32>(handle.index);
+  return handle.IsValid() && m_nodes.IsValidIndex(node) && m_nodes[node].generation == handle.generation &&
+    m_nodes[node].list != INDEX_NONE;
+}
+
+float FTimerWheel::GetRemaining(const FWheelTimerHandle& handle) const {
+  if (!IsActive(handle)) return 0.f;
+  return FMath::Max(static_cast<float>((m_nodes[handle.index].expiry - m_current - m_fraction) / m_tickRate), 0.f);
+}
+
+// the level is the first one whose span still reaches the expiry, the slot comes from the expiry's
+// bits at that level so the slot cascades exactly when the ticks below it have run out
+void FTimerWheel::Link(int32 node) {
+  FNode& timer = m_nodes[node];
+  const int64 delta = FMath::Max<int64>(timer.expiry - m_current, 0);
+  int32 list = kOverflowList;
+  for (int32 level = 0; level < kLevels; level++) {
+    if (delta < (int64(1) << (kSlotBits * (level + 1)))) {
+      list = level * kSlots + static_cast<int32>((timer.expiry >> (kSlotBits * level)) & (kSlots - 1));
+      break;
+    }
+  }
+
+  timer.list = list;
+  timer.prev = INDEX_NONE;
+  timer.next = m_heads[list];
+  if (timer.next != INDEX_NONE) {
+    m_nodes[timer.next].prev = node;
+  }
+  m_heads[list] = node;
+}
+
+void FTimerWheel::Unlink(int32 node) {
+  const FNode& timer = m_nodes[node];
+  if (timer.prev != INDEX_NONE) {
+    m_nodes[timer.prev].next = timer.next;
+  }
+  else {
+    m_heads[timer.list] = timer.next;
+  }
+  if (timer.next != INDEX_NONE) {
+    m_nodes[timer.next].prev = timer.prev;
+  }
+}
+
+void FTimerWheel::Free(int32 node) {
+  FNode& timer = m_nodes[node];
+  timer.list = INDEX_NONE;
+  // stale handles must never match again, 0 is reserved for invalid ones
+  if (++timer.generation == 0) {
+    timer.generation = 1;
+  }
+  timer.next = m_freeList;
+  m_freeList = node;
+}
+
+// relinks every timer of a slot against the current tick, which puts it one or more levels lower
+void FTimerWheel::Cascade(int32 list) {
+  int32 node = m_heads[list];
+  m_heads[list] = INDEX_NONE;
+  while (node != INDEX_NONE) {
+    const int32 next = m_nodes[node].next;
+    Link(node);
+    node = next;
+  }
+}
+
+void FTimerWheel::Expire(int32 list) {
+  int32 node = m_heads[list];
+  m_heads[list] = INDEX_NONE;
+  while (node != INDEX_NONE) {
+    const FNode& timer = m_nodes[node];
+    const int32 next = timer.next;
+    m_expired[timer.channel].Add(timer.payload);
+    Free(node);
+    m_active--;
+    node = next;
+  }
+}
+
+void FTimerWheel::TickOnce() {
+  m_current++;
+  // each level cascades when every level below it wrapped around
+  for (int32 level = 1; level <= kLevels; level++) {
+    const int32 lowerBits = kSlotBits * level;
+    if ((m_current & ((int64(1) << lowerBits) - 1)) != 0) break;
+    if (level == kLevels) {
+      Cascade(kOverflowList);
+      break;
+    }
+    Cascade(level * kSlots + static_cast<int32>((m_current >> lowerBits) & (kSlots - 1)));
+  }
+  Expire(static_cast<int32>(m_current & (kSlots - 1)));
+}
+
+void FTimerWheel::Advance(float deltaTime) {
+  checkf(!m_firing, TEXT("FTimerWheel::Advance called from one of its own callbacks"));
+  m_fraction += deltaTime * m_tickRate;
+  const int64 ticks = static_cast<int64>(m_fraction);
+  m_fraction -= ticks;
+  // nothing can expire while empty, skip straight to the end
+  if (m_active == 0) {
+    m_current += ticks;
+    return;
+  }
+  for (int64 i = 0; i < ticks; i++) {
+    TickOnce();
+  }
+
+  m_firing = true;
+  for (int32 channel = 0; channel < m_callbacks.Num(); channel++) {
+    if (m_expired[channel].Num() > 0) {
+      m_callbacks[channel](m_expired[channel]);
+      m_expired[channel].Reset();
+    }
+  }
+  m_firing = false;
+}
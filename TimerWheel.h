@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FWheelTimerHandle {
+  uint32 index = 0;
+  uint32 generation = 0; // 0 is never handed out
+
+  bool IsValid() const { return generation != 0; }
+  void Invalidate() { generation = 0; }
+};
+
+// Hierarchical timing wheel. Time advances in fixed ticks, each level has 64 slots and covers 64 times
+// the span of the one below, timers further out than the top level wait in an overflow list. Add and
+// Cancel are O(1), a timer is moved down a level at most once per level on its way to expiring.
+//
+// Timers belong to a channel. Everything that expired during one Advance is handed to its channel's
+// callback in one call, so a thousand characters ending their shift in the same frame cost one call.
+// A timer that expired in an Advance still fires even if a callback earlier in the same batch cancels
+// it (Cancel returns false then).
+class FPS_CONTROLLER_API FTimerWheel {
+public:
+  using FBatchCallback = TFunction<void(TConstArrayView<uint64> payloads)>;
+
+  static constexpr int32 kSlotBits = 6;
+  static constexpr int32 kSlots = 1 << kSlotBits;
+  static constexpr int32 kLevels = 4;
+
+  explicit FTimerWheel(float tickRate = 240.f);
+
+  int32 AddChannel(FBatchCallback callback);
+
+  // fires no earlier than delay seconds of wheel time from now, rounded up to the next tick
+  FWheelTimerHandle Add(int32 channel, float delay, uint64 payload);
+  // false if the timer already fired or was cancelled, the handle is invalidated either way
+  bool Cancel(FWheelTimerHandle& handle);
+  bool IsActive(const FWheelTimerHandle& handle) const;
+  float GetRemaining(const FWheelTimerHandle& handle) const;
+
+  void Advance(float deltaTime);
+
+  int32 Num() const { return m_active; }
+  double GetTime() const { return (m_current + m_fraction) / m_tickRate; }
+
+private:
+  struct FNode {
+    int64 expiry = 0; // in ticks
+    uint64 payload = 0;
+    int32 prev = INDEX_NONE;
+    int32 next = INDEX_NONE; // also links the free list
+    int32 list = INDEX_NONE; // slot the node is linked into, INDEX_NONE while free
+    int32 channel = 0;
+    uint32 generation = 1;
+  };
+
+  static constexpr int32 kOverflowList = kLevels * kSlots;
+
+  void Link(int32 node);
+  void Unlink(int32 node);
+  void Free(int32 node);
+  void Cascade(int32 list);
+  void Expire(int32 list);
+  void TickOnce();
+
+  TArray<FNode> m_nodes;
+  int32 m_heads[kOverflowList + 1];
+  int32 m_freeList = INDEX_NONE;
+  int32 m_active = 0;
+
+  TArray<FBatchCallback> m_callbacks;
+  TArray<TArray<uint64>> m_expired; // per channel, filled by Expire and drained after each Advance
+
+  int64 m_current = 0; // last tick processed
+  double m_fraction = 0; // ticks accumulated towards the next one
+  float m_tickRate;
+  bool m_firing = false;
+};
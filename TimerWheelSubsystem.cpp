@@ -0,0 +1,172 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TimerWheelSubsystem.h"
+
+#include "Engine/World.h"
+#include "TimerManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogTimerWheel, Log, All);
+
+namespace {
+  FAutoConsoleCommandWithWorldAndArgs CmdBenchTimers(
+    TEXT("fps.Timers.Bench"),
+    TEXT("Runs N looping timers on the timer wheel, FTimerManager and per-actor accumulation side by side. ")
+    TEXT("Arguments: timer count (default 10000), frames to run (default 300)."),
+    FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& args, UWorld* world) {
+      UTimerWheelSubsystem* timers = world ? world->GetSubsystem<UTimerWheelSubsystem>() : nullptr;
+      if (timers == nullptr) return;
+      const int32 count = args.Num() > 0 ? FCString::Atoi(*args[0]) : 10000;
+      const int32 frames = args.Num() > 1 ? FCString::Atoi(*args[1]) : 300;
+      timers->StartBenchmark(FMath::Max(count, 1), FMath::Max(frames, 1));
+    }));
+
+  uint32 NextRandom(uint32& seed) {
+    seed = seed * 1664525u + 1013904223u;
+    return seed;
+  }
+
+  // what the character did before: a float per timer bumped in every actor's Tick. Allocated one by
+  // one and shuffled so they sit in memory the way spawned actors do
+  struct FAccumulatedTimer {
+    float elapsed = 0.f;
+    float duration = 0.f;
+    uint8 padding[248];
+  };
+}
+
+struct UTimerWheelSubsystem::FBenchmark {
+  int32 count = 0;
+  int32 framesLeft = 0;
+  int32 frames = 0;
+  TArray<float> durations;
+
+  FTimerWheel wheel;
+  int32 loopChannel = INDEX_NONE;
+  FTimerManager timerManager;
+  TArray<TUniquePtr<FAccumulatedTimer>> accumulated;
+
+  uint64 fired[3] = {};
+  double seconds[3] = {};
+  double wheelInsertSeconds = 0;
+  double wheelCancelSeconds = 0;
+  double managerInsertSeconds = 0;
+  double managerCancelSeconds = 0;
+};
+
+UTimerWheelSubsystem::UTimerWheelSubsystem() = default;
+UTimerWheelSubsystem::~UTimerWheelSubsystem() = default;
+
+int32 UTimerWheelSubsystem::FindOrAddChannel(FName name, FTimerWheel::FBatchCallback callback) {
+  if (const int32* channel = m_channels.Find(name)) return *channel;
+  return m_channels.Add(name, m_wheel.AddChannel(MoveTemp(callback)));
+}
+
+void UTimerWheelSubsystem::StartBenchmark(int32 count, int32 frames) {
+  m_benchmark = MakeUnique<FBenchmark>();
+  FBenchmark& bench = *m_benchmark;
+  bench.count = count;
+  bench.frames = bench.framesLeft = frames;
+
+  // cooldown/shift/FOV sized timers between .1 and 4 seconds, all looping
+  uint32 seed = 1234;
+  bench.durations.SetNum(count);
+  for (float& duration : bench.durations) {
+    duration = .1f + (NextRandom(seed) >> 8) / static_cast<float>(1 << 24) * 3.9f;
+  }
+
+  // insert and cancel on their own first, a full set in and out again
+  TArray<FWheelTimerHandle> wheelHandles;
+  TArray<FTimerHandle> managerHandles;
+  wheelHandles.SetNum(count);
+  managerHandles.SetNum(count);
+  const int32 scratch = bench.wheel.AddChannel([](TConstArrayView<uint64>) {});
+  double start = FPlatformTime::Seconds();
+  for (int32 i = 0; i < count; i++) {
+    wheelHandles[i] = bench.wheel.Add(scratch, bench.durations[i], i);
+  }
+  bench.wheelInsertSeconds = FPlatformTime::Seconds() - start;
+  start = FPlatformTime::Seconds();
+  for (FWheelTimerHandle& handle : wheelHandles) {
+    bench.wheel.Cancel(handle);
+  }
+  bench.wheelCancelSeconds = FPlatformTime::Seconds() - start;
+
+  start = FPlatformTime::Seconds();
+  for (int32 i = 0; i < count; i++) {
+    bench.timerManager.SetTimer(managerHandles[i], FTimerDelegate::CreateLambda([] {}), bench.durations[i], false);
+  }
+  bench.managerInsertSeconds = FPlatformTime::Seconds() - start;
+  start = FPlatformTime::Seconds();
+  for (FTimerHandle& handle : managerHandles) {
+    bench.timerManager.ClearTimer(handle);
+  }
+  bench.managerCancelSeconds = FPlatformTime::Seconds() - start;
+
+  // then the looping sets that Tick runs against
+  FBenchmark* benchPtr = m_benchmark.Get();
+  bench.loopChannel = bench.wheel.AddChannel([benchPtr](TConstArrayView<uint64> payloads) {
+    for (const uint64 payload : payloads) {
+      benchPtr->wheel.Add(benchPtr->loopChannel, benchPtr->durations[payload], payload);
+    }
+    benchPtr->fired[0] += payloads.Num();
+  });
+  for (int32 i = 0; i < count; i++) {
+    bench.wheel.Add(bench.loopChannel, bench.durations[i], i);
+    FTimerHandle handle;
+    bench.timerManager.SetTimer(handle, FTimerDelegate::CreateLambda([benchPtr] { benchPtr->fired[1]++; }),
+                                bench.durations[i], true);
+    bench.accumulated.Add(MakeUnique<FAccumulatedTimer>());
+    bench.accumulated.Last()->duration = bench.durations[i];
+  }
+  for (int32 i = count - 1; i > 0; i--) {
+    bench.accumulated.Swap(i, NextRandom(seed) % (i + 1));
+  }
+  UE_LOG(LogTimerWheel, Display, TEXT("Timer bench: %d timers over %d frames started"), count, frames);
+}
+
+void UTimerWheelSubsystem::Tick(float DeltaTime) {
+  Super::Tick(DeltaTime);
+  m_wheel.Advance(DeltaTime);
+
+  if (!m_benchmark) return;
+  FBenchmark& bench = *m_benchmark;
+
+  double start = FPlatformTime::Seconds();
+  bench.wheel.Advance(DeltaTime);
+  bench.seconds[0] += FPlatformTime::Seconds() - start;
+
+  start = FPlatformTime::Seconds();
+  bench.timerManager.Tick(DeltaTime);
+  bench.seconds[1] += FPlatformTime::Seconds() - start;
+
+  start = FPlatformTime::Seconds();
+  for (const TUniquePtr<FAccumulatedTimer>& timer : bench.accumulated) {
+    timer->elapsed += DeltaTime;
+    if (timer->elapsed >= timer->duration) {
+      timer->elapsed -= timer->duration;
+      bench.fired[2]++;
+    }
+  }
+  bench.seconds[2] += FPlatformTime::Seconds() - start;
+
+  if (--bench.framesLeft > 0) return;
+
+  const double perFrame = 1e6 / bench.frames;
+  const double perOp = 1e9 / bench.count;
+  UE_LOG(LogTimerWheel, Display, TEXT("Timer bench, %d timers:"), bench.count);
+  UE_LOG(LogTimerWheel, Display, TEXT("  insert: wheel %.1f ns, FTimerManager %.1f ns"),
+         bench.wheelInsertSeconds * perOp, bench.managerInsertSeconds * perOp);
+  UE_LOG(LogTimerWheel, Display, TEXT("  cancel: wheel %.1f ns, FTimerManager %.1f ns"),
+         bench.wheelCancelSeconds * perOp, bench.managerCancelSeconds * perOp);
+  const TCHAR* names[] = {TEXT("wheel"), TEXT("FTimerManager"), TEXT("accumulation")};
+  for (int32 i = 0; i < UE_ARRAY_COUNT(names); i++) {
+    UE_LOG(LogTimerWheel, Display, TEXT("  %-14s %9.1f us/frame, %llu fired"), names[i], bench.seconds[i] * perFrame,
+           bench.fired[i]);
+  }
+  m_benchmark.Reset();
+}
+
+TStatId UTimerWheelSubsystem::GetStatId() const {
+  RETURN_QUICK_DECLARE_CYCLE_STAT(UTimerWheelSubsystem, STATGROUP_Tickables);
+}
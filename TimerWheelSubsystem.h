@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TimerWheel.h"
+#include "TimerWheelSubsystem.generated.h"
+
+// One timer wheel per world, advanced once per frame with game time. Channels are looked up by name so
+// every actor of a class shares one batch callback.
+// fps.Timers.Bench N [frames] compares it against FTimerManager and per-actor accumulation.
+UCLASS()
+class FPS_CONTROLLER_API UTimerWheelSubsystem : public UTickableWorldSubsystem {
+  GENERATED_BODY()
+
+public:
+  UTimerWheelSubsystem();
+  virtual ~UTimerWheelSubsystem() override;
+
+  int32 FindOrAddChannel(FName name, FTimerWheel::FBatchCallback callback);
+  FWheelTimerHandle Add(int32 channel, float delay, uint64 payload) { return m_wheel.Add(channel, delay, payload); }
+  bool Cancel(FWheelTimerHandle& handle) { return m_wheel.Cancel(handle); }
+  bool IsActive(const FWheelTimerHandle& handle) const { return m_wheel.IsActive(handle); }
+  float GetRemaining(const FWheelTimerHandle& handle) const { return m_wheel.GetRemaining(handle); }
+
+  // runs over the next frames, the results are logged once it is done
+  void StartBenchmark(int32 count, int32 frames);
+
+  virtual void Tick(float DeltaTime) override;
+  virtual TStatId GetStatId() const override;
+  virtual bool IsTickable() const override { return m_wheel.Num() > 0 || m_benchmark.IsValid(); }
+
+private:
+  FTimerWheel m_wheel;
+  TMap<FName, int32> m_channels;
+
+  struct FBenchmark;
+  TUniquePtr<FBenchmark> m_benchmark;
+};